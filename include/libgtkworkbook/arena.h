@@ -0,0 +1,77 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_ARENA
+#define LIBGTKWORKBOOK_ARENA
+
+#include "header.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef struct _Arena Arena;
+	typedef struct _ArenaSlab ArenaSlab;
+
+	/* Default slab size of a Sheet's value arena. */
+#define ARENA_SLAB_SIZE 65536
+	/* Generations wrap inside of this mask (see Cell). */
+#define ARENA_GENERATION_MASK 0x3fffffff
+
+	/*
+	  @description: This object is a bump allocator for strings. Memory is
+	  handed out from large slabs and is never freed one piece at a time;
+	  instead reset hands the whole arena back at once. The slabs are kept and
+	  reused after a reset, so an arena that is filled and reset over and over
+	  (e.g. each time a largefile window is replaced) stops calling malloc
+	  once it has grown to the size of one window. A request that is larger
+	  than a quarter of a slab gets a slab of its own, which is freed on reset.
+
+	  Every reset bumps the generation. Anything that keeps a pointer into the
+	  arena should also keep the generation alloc returned with it, and treat
+	  the pointer as gone once the two no longer match.
+	*/
+	struct _ArenaSlab {
+		ArenaSlab * next;
+		gsize size;
+		gsize used;
+		gchar data[];
+	};
+
+	struct _Arena {
+		/* Members */
+		ArenaSlab * first;
+		ArenaSlab * current;
+		ArenaSlab * large;
+		gsize slab_size;
+		guint generation;
+		GMutex * lock;
+
+		/* Methods */
+		void (*destroy) (Arena * arena);
+		gchar * (*alloc) (Arena * arena, gsize size, guint * generation);
+		void (*reset) (Arena * arena);
+	};
+
+	/* arena.c */
+	Arena * arena_new (gsize slab_size);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_ARENA */
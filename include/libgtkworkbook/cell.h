@@ -28,9 +28,22 @@ extern "C" {
 
 	typedef struct _Cell Cell;
 	typedef struct _CellAttributes CellAttributes;
+	typedef struct _CellMethods CellMethods;
 
+#include "arena.h"
+#include "palette.h"
 #include "sheet.h"
 
+	/* Values shorter than this are kept inside of the Cell itself. */
+#define CELL_INLINE_SIZE 24
+
+	enum
+		{
+			CELL_VALUE_INLINE = 0,
+			CELL_VALUE_ARENA,
+			CELL_VALUE_HEAP
+		};
+
 	/*
 	  @description: These objects will evolve as more uses are found for it. 
 	  Right now it provides as an intermediate abstraction for the cell 
@@ -55,24 +68,31 @@ extern "C" {
 	*/
 	struct _CellAttributes
 	{
-		GString * bgcolor;
-		GString * fgcolor;
-		GtkJustification justification;
-		gboolean editable;
-		gboolean highlighted;
+		guint16 bgcolor;			/* Palette index; PALETTE_NONE if unset. */
+		guint16 fgcolor;			/* Palette index; PALETTE_NONE if unset. */
+		guint justification : 2;	/* GtkJustification */
+		guint editable : 1;
+		guint highlighted : 1;
 	};
 
-	struct _Cell
+	/*
+	  @description: Every Cell points to the same static method table, so a
+	  Cell only carries its members. The colors in CellAttributes are indexes
+	  into the Palette of the Workbook the cell belongs to (or palette_default
+	  when cell->sheet is NULL); use get_bgcolor and get_fgcolor to read them
+	  back as strings. Set cell->sheet before setting any colors, and only
+	  pass set_attributes a CellAttributes whose colors came from the same
+	  Palette.
+
+	  The value of a Cell is stored in one of three places. Short values are
+	  kept inline. Longer values of a Cell that belongs to a Sheet are
+	  allocated out of the Sheet's value arena, and longer values of any other
+	  Cell are allocated on the heap. Always read the value with get_value: a
+	  value that lived in the arena reads back as an empty string once the
+	  Sheet has reset its values (see Sheet::reset_values).
+	*/
+	struct _CellMethods
 	{
-		/* Members */
-		Sheet * sheet;
-		Cell * next;
-		GString * value;
-		CellAttributes attributes;
-		GtkSheetRange range;
-		gint row, column;
-    
-		/* Methods */
 		void (*set) (Cell * cell, gint row, gint column, const gchar * value);
 		void (*set_value) (Cell * cell, const gchar * value);  
 		void (*set_value_length) (Cell * cell, void * s, size_t length);
@@ -85,9 +105,31 @@ extern "C" {
 		void (*set_editable) (Cell * cell, gboolean editable);
 		void (*set_highlighted) (Cell * cell, gboolean highlighted);
 		void (*set_attributes) (Cell * cell, const CellAttributes * attrib);
+		const gchar * (*get_value) (const Cell * cell);
+		const gchar * (*get_fgcolor) (const Cell * cell);
+		const gchar * (*get_bgcolor) (const Cell * cell);
 		void (*destroy) (Cell * cell);
 	};
 
+	struct _Cell
+	{
+		/* Methods */
+		const CellMethods * methods;
+
+		/* Members */
+		Sheet * sheet;
+		GtkSheetRange range;
+		gint row, column;
+		CellAttributes attributes;
+		guint32 length;
+		guint generation : 30;	/* Arena generation of value.data */
+		guint storage : 2;		/* CELL_VALUE_* */
+		union {
+			gchar * data;
+			gchar buffer[CELL_INLINE_SIZE];
+		} value;
+	};
+
 	/* cell.c */
 	Cell *cell_new (void);
 
@@ -0,0 +1,95 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_COLUMNSTORE
+#define LIBGTKWORKBOOK_COLUMNSTORE
+
+#include "header.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef struct _Column Column;
+	typedef struct _ColumnStore ColumnStore;
+
+	enum
+		{
+			COLUMN_TYPE_NULL = 0,	/* Nothing seen yet. */
+			COLUMN_TYPE_INT64,
+			COLUMN_TYPE_DOUBLE,
+			COLUMN_TYPE_TIMESTAMP,	/* Milliseconds since the epoch (UTC). */
+			COLUMN_TYPE_STRING		/* Dictionary encoded. */
+		};
+
+	/*
+	  @description: This object is an optional column-major copy of the
+	  values in a Sheet. Each column infers its type from the values that are
+	  written into it and keeps them in one contiguous typed array, with a
+	  validity bitmap saying which rows hold a value. Sorting, aggregation and
+	  searching a numeric column can then walk a packed array instead of
+	  calling atof on every cell.
+
+	  Types only ever widen: an int64 column that sees a fractional value
+	  becomes a double column, and a column that sees anything it cannot hold
+	  becomes a string column (the values already stored are converted). The
+	  strings of a string column are interned in a per-column dictionary and
+	  the array holds their codes. The store is a shadow of the sheet and not
+	  a place to read display text back from; converted numbers are printed
+	  in their canonical form.
+
+	  All of the methods take the store's lock. Anyone walking the arrays in
+	  Column directly should hold store->lock while doing so.
+	*/
+	struct _Column {
+		gint type;
+		guint8 * validity;
+		union {
+			gint64 * ints;			/* COLUMN_TYPE_INT64, COLUMN_TYPE_TIMESTAMP */
+			gdouble * doubles;		/* COLUMN_TYPE_DOUBLE */
+			guint32 * codes;		/* COLUMN_TYPE_STRING */
+		} data;
+		GHashTable * dictionary;
+		GPtrArray * strings;
+	};
+
+	struct _ColumnStore {
+		/* Members */
+		Column * columns;
+		gint max_rows;
+		gint max_columns;
+		GMutex * lock;
+
+		/* Methods */
+		void (*destroy) (ColumnStore * store);
+		void (*set) (ColumnStore * store, gint row, gint column, const gchar * s, gsize length);
+		void (*reset) (ColumnStore * store);
+		gint (*get_type) (ColumnStore * store, gint column);
+		gboolean (*is_valid) (ColumnStore * store, gint row, gint column);
+		gboolean (*get_int64) (ColumnStore * store, gint row, gint column, gint64 * value);
+		gboolean (*get_double) (ColumnStore * store, gint row, gint column, gdouble * value);
+		const gchar * (*get_string) (ColumnStore * store, gint row, gint column);
+	};
+
+	/* columnstore.c */
+	ColumnStore * column_store_new (gint rows, gint columns);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_COLUMNSTORE */
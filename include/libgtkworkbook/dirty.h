@@ -0,0 +1,61 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_DIRTY
+#define LIBGTKWORKBOOK_DIRTY
+
+#include "header.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef struct _DirtySet DirtySet;
+
+	/* Called once for each dirty cell, in no particular order. */
+	typedef void (*DirtyVisitor) (gint row, gint column, gpointer data);
+
+	/*
+	  @description: This object remembers which cells of a Sheet have changed
+	  since it was last cleared. Rows are only allocated once a cell inside of
+	  them is marked, and each row is a bitmap of its columns, so marking the
+	  same cell twice costs nothing and both memory and foreach are
+	  proportional to the number of changes rather than the size of the Sheet.
+	*/
+	struct _DirtySet {
+		/* Members */
+		GHashTable * rows;
+		gint columns;
+		guint count;
+		GMutex * lock;
+
+		/* Methods */
+		void (*destroy) (DirtySet * set);
+		void (*mark) (DirtySet * set, gint row, gint column);
+		void (*mark_range) (DirtySet * set, gint row0, gint col0, gint rowi, gint coli);
+		void (*clear) (DirtySet * set);
+		void (*foreach) (DirtySet * set, DirtyVisitor visit, gpointer data);
+	};
+
+	/* dirty.c */
+	DirtySet * dirty_set_new (gint columns);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_DIRTY */
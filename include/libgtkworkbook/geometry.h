@@ -0,0 +1,184 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_GEOMETRY
+#define LIBGTKWORKBOOK_GEOMETRY
+
+#include "header.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GEOMETRY_FILE_VERSION_1 0x000001
+#define GEOMETRY_FILE_VERSION_2 0x000002
+#define GEOMETRY_FILE_MAGIC 0x32424f47	/* "GOB2" */
+#define GEOMETRY_JOURNAL_MAGIC 0x314a4f47	/* "GOJ1" */
+	/* Journals smaller than this are never worth compacting. */
+#define GEOMETRY_JOURNAL_COMPACT_SIZE 65536
+
+	typedef struct _GeometryAttributes GeometryAttributes;
+	typedef struct _GeometryCell GeometryCell;
+	typedef struct _GeometryRun GeometryRun;
+	typedef struct _GeometryColumn GeometryColumn;
+	typedef struct _GeometryHeader GeometryHeader;
+	typedef struct _GeometryFooter GeometryFooter;
+	typedef struct _GeometryJournalHeader GeometryJournalHeader;
+	typedef struct _GeometryJournalBlock GeometryJournalBlock;
+	typedef struct _GeometryJournalRecord GeometryJournalRecord;
+
+	/*
+	  @description: These functions read and write the geometry files that
+	  Sheet::save and Sheet::load use. Files are always written in version 2;
+	  version 1 files can still be read.
+
+	  A version 2 file is laid out as:
+
+	  GeometryHeader
+	  string table (every distinct cell text once, NUL terminated)
+	  string index (guint32 offset of each string in the table)
+	  attribute table (every distinct GeometryAttributes once)
+	  for each non-empty column:
+	    guint32 rows[count]
+	    guint32 strings[count] (index into the string index)
+	    GeometryRun runs[n_runs] (attributes, run-length encoded)
+	  column directory (GeometryColumn for each non-empty column)
+	  GeometryFooter (at the very end of the file)
+
+	  Every section starts on an 8 byte boundary and is stored in host byte
+	  order, so the reader maps the file and walks the arrays in place; the
+	  only thing allocated while loading is whatever the visitor allocates.
+	  The reader checks every offset and index against the size of the file
+	  before using it, so a truncated or corrupt file is rejected instead of
+	  being read out of bounds.
+
+	  Changes made after a file was written can be appended to its journal,
+	  "<filepath>.journal", instead of writing the whole file again:
+
+	  GeometryJournalHeader (names the file the journal belongs to)
+	  for each append:
+	    GeometryJournalBlock
+	    for each cell: GeometryJournalRecord, then length + 1 bytes of text
+
+	  geometry_file_read replays the journal on top of the file. A journal
+	  whose header does not match the file (because the file has since been
+	  written again) is ignored, as is a block that was cut short by a crash
+	  in the middle of an append. A record with empty text clears the cell.
+	  Writing the file with geometry_file_write removes its journal, which
+	  is how the journal is compacted.
+	*/
+	struct _GeometryAttributes {
+		guint8 is_visible;
+		guint8 is_editable;
+		guint8 justification;
+		guint8 reserved;
+		guint32 fg_pixel;
+		guint32 bg_pixel;
+		guint16 fg_red, fg_green, fg_blue;
+		guint16 bg_red, bg_green, bg_blue;
+	};
+
+	struct _GeometryCell {
+		gint row;
+		gint column;
+		const gchar * text;
+		GeometryAttributes attributes;
+		gint attributes_index;		/* Same index, same attributes; -1 if unknown. */
+	};
+
+	struct _GeometryRun {
+		guint32 first;		/* Index into the column's rows/strings. */
+		guint32 length;
+		guint32 attributes;	/* Index into the attribute table. */
+	};
+
+	struct _GeometryColumn {
+		guint32 column;
+		guint32 count;
+		guint32 n_runs;
+		guint32 reserved;
+		guint64 rows_offset;
+		guint64 strings_offset;
+		guint64 runs_offset;
+	};
+
+	struct _GeometryHeader {
+		gint32 version;		/* Where version 1 kept its fileVersion. */
+		guint32 magic;
+		gint32 max_row;
+		gint32 max_column;
+	};
+
+	struct _GeometryFooter {
+		guint64 strings_offset;
+		guint64 strings_size;
+		guint64 index_offset;
+		guint64 attributes_offset;
+		guint64 columns_offset;
+		guint32 n_strings;
+		guint32 n_attributes;
+		guint32 n_columns;
+		guint32 magic;
+	};
+
+	struct _GeometryJournalHeader {
+		guint32 magic;
+		guint32 reserved;
+		guint64 file_size;	/* Size, inode and mtime of the file. */
+		guint64 file_inode;
+		gint64 file_mtime;
+	};
+
+	struct _GeometryJournalBlock {
+		guint32 magic;
+		guint32 count;		/* Number of records. */
+		guint64 size;		/* Bytes of records that follow. */
+	};
+
+	struct _GeometryJournalRecord {
+		gint32 row;
+		gint32 column;
+		guint32 length;		/* Text length, not counting the NUL. */
+		guint32 reserved;
+		GeometryAttributes attributes;
+	};
+
+	/* Called once for each cell that is read. The text is only valid for the
+		duration of the call. */
+	typedef void (*GeometryVisitor) (const GeometryCell * cell, gpointer data);
+
+	/* geometry.c */
+	gboolean geometry_file_write (const gchar * filepath,
+											gint max_row,
+											gint max_column,
+											const GeometryCell * cells,
+											gint count);
+	gboolean geometry_file_read (const gchar * filepath,
+										  gint * max_row,
+										  gint * max_column,
+										  GeometryVisitor visit,
+										  gpointer data);
+	gboolean geometry_journal_append (const gchar * filepath,
+												 guint64 * size,
+												 const GeometryCell * cells,
+												 gint count);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_GEOMETRY */
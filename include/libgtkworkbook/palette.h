@@ -0,0 +1,90 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_PALETTE
+#define LIBGTKWORKBOOK_PALETTE
+
+#include "header.h"
+#include <gtk/gtk.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef struct _Palette Palette;
+	typedef struct _PaletteColor PaletteColor;
+
+	/* Index zero is reserved for "no color" and is never handed out. */
+#define PALETTE_NONE 0
+#define PALETTE_MAX G_MAXUINT16
+
+	/*
+	  @description: This object interns color strings (e.g. white, #ffffcc)
+	  and hands out a small integer index for each one. Cells only store the
+	  index, so recoloring a cell never allocates once the color has been seen
+	  by the palette. Each Workbook owns a Palette; a Cell that does not belong
+	  to a Sheet uses the process-wide palette returned by palette_default.
+
+	  Strings are never removed from a Palette, so the pointer returned by
+	  lookup stays valid for as long as the Palette is alive. Both intern and
+	  lookup are safe to call from any thread.
+
+	  The Palette also caches the GdkColor of each entry. get_color parses
+	  (#rrggbb without going through gdk_color_parse) and allocates a color
+	  in the colormap the first time it is asked for, and hands back the same
+	  GdkColor from then on. Only the first colormap seen is cached; colors
+	  for any other colormap are allocated on every call. The index of
+	  "black" is interned up front because every background change also sets
+	  the border color.
+
+	  A full Palette does not drop new colors: each one is mapped to the
+	  closest color that it already holds (and remembered as an alias of
+	  it), and a warning is logged the first time that happens.
+	*/
+	struct _PaletteColor {
+		GdkColor color;
+		gboolean allocated;
+	};
+
+	struct _Palette {
+		/* Members */
+		GHashTable * index;
+		GPtrArray * names;
+		GPtrArray * aliases;
+		PaletteColor * colors;
+		guint colors_size;
+		GdkColormap * colormap;
+		guint16 black;
+		gboolean full;
+		GMutex * lock;
+
+		/* Methods */
+		void (*destroy) (Palette * palette);
+		guint16 (*intern) (Palette * palette, const gchar * color);
+		const gchar * (*lookup) (Palette * palette, guint16 index);
+		gboolean (*get_color) (Palette * palette, guint16 index, GdkColormap * colormap, GdkColor * color);
+	};
+
+	/* palette.c */
+	Palette * palette_new (void);
+	Palette * palette_default (void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_PALETTE */
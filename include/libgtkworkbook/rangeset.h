@@ -0,0 +1,73 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_RANGESET
+#define LIBGTKWORKBOOK_RANGESET
+
+#include "header.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef struct _RangeSet RangeSet;
+	typedef struct _RangeSpan RangeSpan;
+	typedef struct _RangeBand RangeBand;
+
+	/*
+	  @description: This object is a set of cells that is stored as ranges
+	  instead of one flag per cell, so adding or removing a whole selection
+	  costs the same no matter how many cells are inside of it.
+
+	  The rows are split into bands: runs of consecutive rows that all hold
+	  exactly the same columns. The bands are kept sorted and never overlap,
+	  and so are the column spans inside of each band, which makes contains
+	  two binary searches. Neighbouring bands that end up with the same
+	  columns are merged back together.
+	*/
+	struct _RangeSpan {
+		gint first;
+		gint last;
+	};
+
+	struct _RangeBand {
+		gint first;
+		gint last;
+		GArray * columns;	/* RangeSpan */
+	};
+
+	struct _RangeSet {
+		/* Members */
+		GArray * bands;		/* RangeBand */
+		GMutex * lock;
+
+		/* Methods */
+		void (*destroy) (RangeSet * set);
+		void (*add) (RangeSet * set, gint row0, gint col0, gint rowi, gint coli);
+		void (*remove) (RangeSet * set, gint row0, gint col0, gint rowi, gint coli);
+		gboolean (*contains) (RangeSet * set, gint row, gint column);
+		void (*clear) (RangeSet * set);
+	};
+
+	/* rangeset.c */
+	RangeSet * range_set_new (void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_RANGESET */
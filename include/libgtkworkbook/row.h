@@ -51,6 +51,10 @@ extern "C" {
 	  not (and should not) contain any locking procedures. All the locking for
 	  threading should be done in the Sheet object (where all gtk+ calls 
 	  should be performed).
+
+	  A Row created with row_new_sparse does not allocate any of its cells up
+	  front; get_cell allocates a cell the first time it is asked for, and
+	  find_cell returns NULL for a cell that has not been allocated yet.
 	*/
 	struct _Row {
 		/* Members */
@@ -60,10 +64,12 @@ extern "C" {
 		/* Methods */
 		void (*destroy) (Row * row);
 		Cell * (*get_cell) (Row * row, gint column);
+		Cell * (*find_cell) (Row * row, gint column);
 	};
 
 	/* row.c */
 	Row * row_new (gint columns);
+	Row * row_new_sparse (gint columns);
 	
 #ifdef __cplusplus
 }
@@ -0,0 +1,98 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_SCHEDULER
+#define LIBGTKWORKBOOK_SCHEDULER
+
+#include "header.h"
+#include <gtk/gtk.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	/* The most time, in milliseconds, that one frame of updates may take. */
+#define SCHEDULER_FRAME_BUDGET 16
+
+	/* Workers that can outrun the main loop wait before pushing once this
+		many updates are pending (see pending). */
+#define SCHEDULER_HIGH_WATER 64
+
+	typedef struct _Scheduler Scheduler;
+	typedef struct _SchedulerUpdate SchedulerUpdate;
+	typedef void (*SchedulerFunc) (Scheduler * scheduler, gpointer data);
+
+#include "sheet.h"
+
+	/*
+	  @description: This object lets worker threads change Sheets without
+	  ever taking the GDK lock themselves. A worker pushes an update (a
+	  function and its data) and goes on; pushing never blocks, since the
+	  updates are linked onto a stack with a compare and swap. The main loop
+	  takes the whole stack in one go, puts it back in the order it was
+	  pushed in, and applies it in frames of at most budget milliseconds
+	  while holding the GDK lock once per frame. Whatever does not fit in a
+	  frame waits for the next one.
+
+	  An update that changes a Sheet should call hold on it first: the Sheet
+	  is then frozen until the end of the frame, so a frame of updates costs
+	  one redraw per Sheet. An update that destroys a Sheet must call
+	  release before it does so.
+
+	  The main loop source is only around while there are updates waiting.
+	  run applies a single frame right away; call it with the GDK lock held.
+
+	  pending counts the updates that have been pushed and not applied yet.
+	  Since push never blocks, a worker that produces updates faster than
+	  the main loop applies them has to throttle itself: it should wait
+	  while pending is at SCHEDULER_HIGH_WATER or above (never from the
+	  main loop itself).
+	*/
+	struct _SchedulerUpdate {
+		SchedulerUpdate * next;
+		SchedulerFunc func;
+		gpointer data;
+		GDestroyNotify destroy;
+	};
+
+	struct _Scheduler {
+		/* Members */
+		volatile gpointer incoming;	/* SchedulerUpdate, newest first */
+		SchedulerUpdate * head;
+		SchedulerUpdate * tail;
+		GSList * held;
+		GTimer * timer;
+		gint budget;
+		volatile gint armed;
+		volatile gint pending;
+
+		/* Methods */
+		void (*destroy) (Scheduler * scheduler);
+		void (*push) (Scheduler * scheduler, SchedulerFunc func, gpointer data, GDestroyNotify destroy);
+		gboolean (*run) (Scheduler * scheduler);
+		void (*hold) (Scheduler * scheduler, Sheet * sheet);
+		void (*release) (Scheduler * scheduler);
+	};
+
+	/* scheduler.c */
+	Scheduler * scheduler_new (gint budget);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_SCHEDULER */
@@ -27,13 +27,18 @@
 extern "C" {
 #endif
 
-#define GEOMETRY_FILE_VERSION 0x000001
+#define GEOMETRY_FILE_VERSION GEOMETRY_FILE_VERSION_2
 
 	typedef struct _Sheet Sheet;
 
 #include "workbook.h"
 #include "cell.h"
 #include "row.h"
+#include "columnstore.h"
+#include "geometry.h"
+#include "dirty.h"
+#include "rangeset.h"
+#include "snapshot.h"
 	
 	/*
 	  @description: This object abstracts away all of the calls to the native
@@ -46,16 +51,71 @@ extern "C" {
 	  you should always use gdk_threads_enter and gtk_threads_exit. Any calls
 	  outside of the window (main) thread will usually result in problems if
 	  you do not get a mutex. 
+	  c. The cell buffer is sparse: a Cell is only allocated the first time it
+	  is written to, or given an attribute. Use get_cell to read it; a NULL
+	  pointer means the cell has never been touched.
+	  d. Long cell values are allocated out of the values arena. Once a whole
+	  window of rows has been applied to the GtkSheet (e.g. before a largefile
+	  jump overwrites it) call reset_values to hand all of that memory back in
+	  one go; the values that lived in the arena read back as empty strings
+	  afterwards.
+	  e. set_shadow turns on a column-major, typed copy of everything that is
+	  written through set_cell_value_length (see ColumnStore). It is off by
+	  default.
+	  f. Every change that reaches the GtkSheet is marked in dirty. save
+	  writes the whole Sheet and clears it; checkpoint only appends the
+	  cells marked since the last save or checkpoint to the file's journal,
+	  and falls back to a full save (which compacts the journal) when the
+	  journal has grown larger than the file itself.
+	  g. Both are made of two halves that can be split across threads:
+	  snapshot copies the cells out of the GtkSheet (hold the GDK lock) and
+	  commit writes the copy out without touching the GtkSheet. load is
+	  Snapshot::read followed by apply_snapshot (hold the GDK lock).
+	  h. set_tail turns the Sheet into a ring of max_rows slots for streams
+	  that never end. The rows of the cell buffer are slots, written to in
+	  order and wrapping back to 0, and apply_row writes its slot into the
+	  next row of the GtkSheet, which is a ring as well: once it is full the
+	  newest row replaces the oldest one, at tail_head, in place. Rows are
+	  never moved, so appending costs one row. Row titles count every row
+	  that was ever appended (tail_sequence), starting at 0.
+	  i. Frozen and highlighted cells are kept as ranges of the GtkSheet
+	  (frozen, highlighted) rather than as attributes of each Cell, so that
+	  freezing a selection of any size costs the same. Writes into a frozen
+	  cell are dropped; use is_highlighted to ask about a single cell. Only
+	  the rows on screen are painted, as they scroll into view (painted).
+	  j. set_window makes the Sheet a window of max_rows lines over a much
+	  larger source (see sheet_method_set_window); memory stays bounded by
+	  the GtkSheet no matter how many lines the source has. window_first is
+	  the line shown in row 0.
+	  k. serial is different for every Sheet ever made, so work that was
+	  queued for a Sheet can tell it apart from a later one with the same
+	  name.
 	*/
+	typedef void (*SheetWindowRequest) (Sheet * sheet, guint64 line, gint rows, gpointer data);
+
 	struct _Sheet
 	{
 		/* Members */
 		Sheet * next;
 		Sheet * prev;
-		Cell *** cells;
+		GHashTable * cells;
+		GMutex * cells_lock;
+		Cell ** cells_cached_row;
+		gint cells_cached_index;
+		Arena * values;
+		ColumnStore * shadow;
+		DirtySet * dirty;
+		RangeSet * frozen;
+		RangeSet * highlighted;
+		RangeSet * painted;
+		gchar * checkpoint_path;
+		guint64 checkpoint_size;
+		guint64 journal_size;
+		GMutex * checkpoint_lock;
 		Row * column_titles;
 		Row * row_titles;
 		gchar * name;
+		guint serial;
 		Workbook * workbook;
 		GtkWidget * gtk_label;
 		GtkWidget * gtk_sheet;
@@ -67,20 +127,37 @@ extern "C" {
 		gint max_rows;
 		gint max_columns;
 		gboolean has_focus;
+		gboolean tail;
+		guint64 tail_sequence;
+		gint tail_count;
+		gint tail_head;
+		GtkWidget * gtk_vscrollbar;
+		guint64 window_first;
+		guint64 window_lines;
+		SheetWindowRequest window_request;
+		gpointer window_data;
 
 		/* Methods */
 		void (*destroy) (Sheet * sheet);
 		void (*set_attention) (Sheet * sheet, gint attention);
 		void (*apply_range) (Sheet * sheet, const GtkSheetRange * range, const CellAttributes * attrib);
 		void (*apply_array) (Sheet * sheet, Cell ** array, gint size);
+		void (*apply_block) (Sheet * sheet, gint row, gint rows, gint columns, const gsize * offsets, const gchar * bytes);
 		void (*apply_cell) (Sheet * sheet, const Cell * cell);
 		void (*apply_row) (Sheet * sheet, gint row);
+		void (*apply_rows) (Sheet * sheet, gint row, gint count);
 		void (*set_cell) (Sheet * sheet, gint row, gint column, const gchar * value);
 		void (*set_cell_value_length) (Sheet * sheet, gint row, gint column, void * value, size_t length);
 		void (*range_set_background) (Sheet * sheet, const GtkSheetRange * range, const gchar * desc);
 		void (*range_set_foreground) (Sheet * sheet, const GtkSheetRange * range, const gchar * desc);
+		void (*ranges_set_background) (Sheet * sheet, const GtkSheetRange * ranges, gint count, const gchar * desc);
+		void (*ranges_set_foreground) (Sheet * sheet, const GtkSheetRange * ranges, gint count, const gchar * desc);
 		gboolean (*save) (Sheet * sheet, const gchar * filepath);
 		gboolean (*load) (Sheet * sheet, const gchar * filepath);
+		gboolean (*checkpoint) (Sheet * sheet, const gchar * filepath);
+		Snapshot * (*snapshot) (Sheet * sheet, const gchar * filepath, gboolean checkpoint);
+		gboolean (*commit) (Sheet * sheet, Snapshot * snapshot, const gchar * filepath);
+		void (*apply_snapshot) (Sheet * sheet, const Snapshot * snapshot);
 		void (*get_row) (Sheet * sheet, gint row, Cell ** array, gint size);
 		void (*set_column_title) (Sheet * sheet, gint column, const char * title);
 		void (*set_row_title) (Sheet * sheet, gint row, const char * title);
@@ -88,7 +165,16 @@ extern "C" {
 		void (*thaw_selection) (Sheet * sheet);
 		void (*highlight_selection) (Sheet * sheet);
 		void (*dehighlight_selection) (Sheet * sheet);
+		gboolean (*is_highlighted) (Sheet * sheet, gint row, gint column);
 		void (*set_cell_background) (Sheet * sheet, gint row, gint column, const gchar * color);
+		Cell * (*get_cell) (Sheet * sheet, gint row, gint column);
+		const gchar * (*get_column_title) (Sheet * sheet, gint column);
+		const gchar * (*get_row_title) (Sheet * sheet, gint row);
+		void (*reset_values) (Sheet * sheet);
+		void (*set_shadow) (Sheet * sheet, gboolean enabled);
+		void (*set_tail) (Sheet * sheet, gboolean enabled);
+		void (*set_window) (Sheet * sheet, SheetWindowRequest request, gpointer data);
+		void (*set_window_lines) (Sheet * sheet, guint64 lines);
 	};
 
 	/* sheet.c */
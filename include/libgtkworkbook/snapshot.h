@@ -0,0 +1,64 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef LIBGTKWORKBOOK_SNAPSHOT
+#define LIBGTKWORKBOOK_SNAPSHOT
+
+#include "header.h"
+#include "arena.h"
+#include "geometry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+	typedef struct _Snapshot Snapshot;
+
+	/*
+	  @description: This object is a point-in-time copy of the cells of a
+	  Sheet, detached from the GtkSheet that they were copied out of. Every
+	  text lives in the snapshot's own arena, so taking one costs a single
+	  copy of the text and nothing else; the expensive part of a save (string
+	  and attribute dedup, encoding and the disk I/O) is done by write, which
+	  can safely run on any thread while the Sheet keeps changing.
+
+	  A delta snapshot only holds the cells that changed since the Sheet's
+	  last checkpoint, and write appends it to the file's journal.
+	*/
+	struct _Snapshot {
+		/* Members */
+		GArray * cells;
+		Arena * values;
+		gint max_row;
+		gint max_column;
+		gboolean delta;
+
+		/* Methods */
+		void (*destroy) (Snapshot * snapshot);
+		void (*add) (Snapshot * snapshot, const GeometryCell * cell);
+		gboolean (*write) (Snapshot * snapshot, const gchar * filepath, guint64 * journal_size);
+		gboolean (*read) (Snapshot * snapshot, const gchar * filepath);
+	};
+
+	/* snapshot.c */
+	Snapshot * snapshot_new (gint max_row, gint max_column, gboolean delta);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* H_SNAPSHOT */
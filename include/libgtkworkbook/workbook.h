@@ -35,6 +35,19 @@ extern "C" {
 
 	typedef struct _Workbook Workbook;
 
+	/*
+	  @description: A Workbook keeps two indexes of its Sheets, by name and by
+	  the notebook page widget (sheet->gtk_box), so that get_sheet and
+	  get_sheet_by_widget do not have to walk the list. The generation is
+	  bumped every time a Sheet is added or removed; anyone caching a Sheet
+	  pointer should drop it when the generation changes.
+
+	  Worker threads do not change Sheets directly; they push updates onto
+	  the Workbook's Scheduler, which applies them from the main loop.
+	*/
+
+#include "palette.h"
+#include "scheduler.h"
 #include "sheet.h"
 
 	struct _Workbook
@@ -50,11 +63,18 @@ extern "C" {
 		GtkWidget * gtk_window;
 		GtkWidget * gtk_box;
 		gchar * filename;
+		Palette * palette;
+		Scheduler * scheduler;
+		GHashTable * sheets_by_name;
+		GHashTable * sheets_by_widget;
+		GMutex * sheets_lock;
+		guint generation;
 
 		/* Methods */
 		void (*destroy) (Workbook *);
 		Sheet *(*add_new_sheet) (Workbook *, const gchar *, gint, gint);
 		Sheet *(*get_sheet) (Workbook *, const gchar *);
+		Sheet *(*get_sheet_by_widget) (Workbook *, GtkWidget *);
 		void (*remove_sheet) (Workbook *, Sheet *);
 		gboolean (*move_sheet_index) (Workbook *, Sheet *, gint);
 		gboolean (*move_sheet) (Workbook *, Sheet *, const gchar *, gboolean); 
@@ -0,0 +1,177 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <libgtkworkbook/arena.h>
+#include <glib/gthread.h>
+
+/* arena.c (static) */
+static Arena * arena_object_init (gsize);
+static void arena_object_free (Arena *);
+static void arena_method_destroy (Arena *);
+static gchar * arena_method_alloc (Arena *, gsize, guint *);
+static void arena_method_reset (Arena *);
+static ArenaSlab * arena_slab_new (gsize);
+static void arena_slab_free_all (ArenaSlab *);
+
+/* @description: This function returns a pointer to a new Arena object.
+   @slab_size: The size of each slab in bytes; zero picks ARENA_SLAB_SIZE. */
+Arena *
+arena_new (gsize slab_size)
+{
+	Arena * arena = arena_object_init (slab_size);
+	return arena;
+}
+
+/* @description: This function is the Arena object's constructor. No slab is
+   allocated until the first call to alloc. */
+static Arena *
+arena_object_init (gsize slab_size)
+{
+	Arena * obj = NEW (Arena);
+
+	obj->first = obj->current = obj->large = NULL;
+	obj->slab_size = (slab_size == 0) ? ARENA_SLAB_SIZE : slab_size;
+	obj->generation = 0;
+	obj->lock = g_mutex_new ();
+
+	/* Methods */
+	obj->destroy = arena_method_destroy;
+	obj->alloc = arena_method_alloc;
+	obj->reset = arena_method_reset;
+
+	return obj;
+}
+
+/* @description: This function frees the Arena object and all of its slabs.
+   @arena: A pointer to the object to free. */
+static void
+arena_object_free (Arena * arena)
+{
+	ASSERT (arena != NULL);
+
+	arena_slab_free_all (arena->first);
+	arena_slab_free_all (arena->large);
+	g_mutex_free (arena->lock);
+	FREE (arena);
+}
+
+static void
+arena_method_destroy (Arena * arena)
+{
+	g_return_if_fail (arena != NULL);
+
+	arena_object_free (arena);
+}
+
+/* @description: This function allocates a slab with room for size bytes. */
+static ArenaSlab *
+arena_slab_new (gsize size)
+{
+	ArenaSlab * slab = (ArenaSlab *)g_malloc (sizeof (ArenaSlab) + size);
+
+	slab->next = NULL;
+	slab->size = size;
+	slab->used = 0;
+	return slab;
+}
+
+/* @description: This function frees a chain of slabs. */
+static void
+arena_slab_free_all (ArenaSlab * slab)
+{
+	while (slab) {
+		ArenaSlab * next = slab->next;
+		g_free (slab);
+		slab = next;
+	}
+}
+
+/* @description: This method hands out size bytes from the arena. The memory
+   stays valid until the next call to reset.
+   @size: The number of bytes.
+   @generation: If not NULL, set to the generation the memory belongs to. */
+static gchar *
+arena_method_alloc (Arena * arena, gsize size, guint * generation)
+{
+	ASSERT (arena != NULL);
+
+	gchar * p = NULL;
+
+	/* Keep everything pointer aligned. */
+	size = (size + sizeof (gpointer) - 1) & ~(sizeof (gpointer) - 1);
+
+	g_mutex_lock (arena->lock);
+
+	if (size > arena->slab_size / 4) {
+		ArenaSlab * slab = arena_slab_new (size);
+		slab->used = size;
+		slab->next = arena->large;
+		arena->large = slab;
+		p = slab->data;
+	}
+	else {
+		ArenaSlab * slab = arena->current;
+
+		/* Move on to the next slab, reusing the ones kept from before the last
+			reset before allocating another. */
+		while (slab == NULL || slab->used + size > slab->size) {
+			if (slab == NULL) {
+				arena->first = arena_slab_new (arena->slab_size);
+				slab = arena->first;
+			}
+			else if (slab->next) {
+				slab = slab->next;
+				slab->used = 0;
+			}
+			else {
+				slab->next = arena_slab_new (arena->slab_size);
+				slab = slab->next;
+			}
+		}
+
+		arena->current = slab;
+		p = slab->data + slab->used;
+		slab->used += size;
+	}
+
+	if (generation)
+		*generation = arena->generation;
+
+	g_mutex_unlock (arena->lock);
+	return p;
+}
+
+/* @description: This method hands all of the memory in the arena back at
+   once. Regular slabs are kept for reuse; oversized ones are freed. */
+static void
+arena_method_reset (Arena * arena)
+{
+	ASSERT (arena != NULL);
+
+	g_mutex_lock (arena->lock);
+
+	arena->generation = (arena->generation + 1) & ARENA_GENERATION_MASK;
+	arena->current = arena->first;
+	if (arena->first)
+		arena->first->used = 0;
+
+	arena_slab_free_all (arena->large);
+	arena->large = NULL;
+
+	g_mutex_unlock (arena->lock);
+}
@@ -17,9 +17,13 @@
    Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
 */
 #include <libgtkworkbook/cell.h>
+#include <string.h>
 
 /* cell.c (static) */
 static Cell *cell_object_init (void);
+static Palette *cell_palette (const Cell *);
+static gsize cell_value_capacity (gsize);
+static void cell_value_store (Cell *, const gchar *, gsize);
 static void cell_object_free (Cell *);
 static void cell_method_set_value (Cell *, const gchar *);
 static void cell_method_set_value_length (Cell *, void *, size_t);
@@ -34,6 +38,29 @@ static void cell_method_set_attributes (Cell *, const CellAttributes *);
 static void cell_method_set_range (Cell *, const GtkSheetRange *);
 static void cell_method_set_editable (Cell *, gboolean);
 static void cell_method_set_highlighted (Cell *, gboolean);
+static const gchar * cell_method_get_value (const Cell *);
+static const gchar * cell_method_get_fgcolor (const Cell *);
+static const gchar * cell_method_get_bgcolor (const Cell *);
+
+/* This table is shared by every Cell object. */
+static const CellMethods cell_methods = {
+	cell_method_set_all,
+	cell_method_set_value,
+	cell_method_set_value_length,
+	cell_method_set_column,
+	cell_method_set_row,
+	cell_method_set_range,
+	cell_method_set_justification,
+	cell_method_set_fgcolor,
+	cell_method_set_bgcolor,
+	cell_method_set_editable,
+	cell_method_set_highlighted,
+	cell_method_set_attributes,
+	cell_method_get_value,
+	cell_method_get_fgcolor,
+	cell_method_get_bgcolor,
+	cell_method_destroy
+};
 
 /* @description: The function returns a pointer to a Cell object. */
 Cell *
@@ -47,44 +74,37 @@ cell_new (void)
 static Cell *
 cell_object_init (void)
 {
-	Cell * obj = (Cell*)g_malloc(sizeof (Cell));
+	Cell * obj = (Cell*)g_malloc0(sizeof (Cell));
 
 	if (!obj) {
 		g_critical ("Failed allocating space for cell object");
 		return NULL;
 	}
 	
-	obj->value = g_string_new_len ("", 4096);
-	obj->attributes.bgcolor = g_string_new_len ("", 1024);
-	obj->attributes.fgcolor = g_string_new_len ("", 1024);
+	obj->storage = CELL_VALUE_INLINE;
+	obj->value.buffer[0] = '\0';
+	obj->attributes.bgcolor = PALETTE_NONE;
+	obj->attributes.fgcolor = PALETTE_NONE;
 	obj->attributes.editable = TRUE;
 	obj->attributes.highlighted = FALSE;
 	obj->attributes.justification = GTK_JUSTIFY_LEFT;
 	
-	if (!obj->value || !obj->attributes.bgcolor || !obj->attributes.fgcolor) {
-		g_critical ("failed allocating space for g_string structure");
-		cell_object_free (obj);
-		return NULL;
-	}
-	
 	/* Methods */
-	obj->set_fgcolor = cell_method_set_fgcolor;
-	obj->set_bgcolor = cell_method_set_bgcolor;
-	obj->set_editable = cell_method_set_editable;
-	obj->set_highlighted = cell_method_set_highlighted;
-	obj->set_attributes = cell_method_set_attributes;
-	obj->set_range = cell_method_set_range;
-	obj->set_value = cell_method_set_value;
-	obj->set_value_length = cell_method_set_value_length;
-	obj->set_column = cell_method_set_column;
-	obj->set_row = cell_method_set_row;
-	obj->set = cell_method_set_all;
-	obj->set_justification = cell_method_set_justification;
-	obj->destroy = cell_method_destroy;
+	obj->methods = &cell_methods;
 
 	return obj;
 }
 
+/* @description: This function returns the Palette that the colors of the
+   Cell object are interned in. */
+static Palette *
+cell_palette (const Cell * cell)
+{
+	if (cell->sheet && cell->sheet->workbook)
+		return cell->sheet->workbook->palette;
+	return palette_default ();
+}
+
 /* @description: This object frees the memory created by the Cell object.
    @cell: The pointer to the object to free. */
 static void
@@ -92,12 +112,75 @@ cell_object_free (Cell * cell)
 {
 	ASSERT (cell != NULL);
 
-	g_string_free (cell->value, TRUE);
-	g_string_free (cell->attributes.fgcolor, TRUE);
-	g_string_free (cell->attributes.bgcolor, TRUE);
+	if (cell->storage == CELL_VALUE_HEAP)
+		g_free (cell->value.data);
 	FREE (cell);
 }
 
+/* @description: This function returns how many bytes are reserved for a value
+   of the given length when it does not fit inline. Rounding up to a power of
+   two lets a value that is rewritten often reuse its memory. */
+static gsize
+cell_value_capacity (gsize length)
+{
+	gsize capacity = CELL_INLINE_SIZE * 2;
+
+	while (capacity < length + 1)
+		capacity <<= 1;
+	return capacity;
+}
+
+/* @description: This function copies a string into the Cell object's value,
+   choosing where to keep it (see CellMethods in cell.h).
+   @s: The string; it does not need to be NUL terminated.
+   @length: The length of the string in bytes. */
+static void
+cell_value_store (Cell * cell, const gchar * s, gsize length)
+{
+	gchar * old = (cell->storage == CELL_VALUE_HEAP) ? cell->value.data : NULL;
+	gchar * p = NULL;
+
+	if (length < CELL_INLINE_SIZE) {
+		p = cell->value.buffer;
+		cell->storage = CELL_VALUE_INLINE;
+	}
+	else if (cell->sheet == NULL) {
+		if (old && cell_value_capacity (cell->length) >= length + 1) {
+			p = old;
+			old = NULL;
+		}
+		else
+			p = (gchar *)g_malloc (cell_value_capacity (length));
+
+		cell->value.data = p;
+		cell->storage = CELL_VALUE_HEAP;
+	}
+	else {
+		Arena * arena = cell->sheet->values;
+
+		if (cell->storage == CELL_VALUE_ARENA
+			 && cell->generation == arena->generation
+			 && cell_value_capacity (cell->length) >= length + 1)
+			p = cell->value.data;
+		else {
+			guint generation = 0;
+			p = arena->alloc (arena, cell_value_capacity (length), &generation);
+			cell->generation = generation;
+		}
+
+		cell->value.data = p;
+		cell->storage = CELL_VALUE_ARENA;
+	}
+
+	if (length > 0)
+		memmove (p, s, length);
+	p[length] = '\0';
+	cell->length = (guint32)length;
+
+	if (old)
+		g_free (old);
+}
+
 /* @description: This method sets a cell in the GtkSheet with the attributes
    of a Cell object.
    @row: An integer value of the row to set.
@@ -110,7 +193,7 @@ cell_method_set_all (Cell * cell,
 {
 	ASSERT (cell != NULL);
 
-	g_string_assign (cell->value, value);
+	cell_value_store (cell, value, strlen (value));
 	cell->row = row;
 	cell->column = column;  
 }
@@ -123,7 +206,7 @@ cell_method_set_justification (Cell * cell,
 										 GtkJustification justification)
 {
 	ASSERT (cell != NULL);
-	cell->attributes.justification = justification;
+	cell->attributes.justification = justification & 0x3;
 }
 
 /* @description: The method sets the row of the Cell object.
@@ -156,7 +239,8 @@ cell_method_set_bgcolor (Cell * cell,
 {
 	ASSERT (cell != NULL);
 
-	g_string_assign (cell->attributes.bgcolor, color);
+	Palette * palette = cell_palette (cell);
+	cell->attributes.bgcolor = palette->intern (palette, color);
 }
 
 /* @description: This method sets the fgcolor of the Cell object.
@@ -167,7 +251,8 @@ cell_method_set_fgcolor (Cell * cell,
 {
 	ASSERT (cell != NULL);
   
-	g_string_assign (cell->attributes.fgcolor, color);
+	Palette * palette = cell_palette (cell);
+	cell->attributes.fgcolor = palette->intern (palette, color);
 }
 
 static void
@@ -175,7 +260,7 @@ cell_method_set_editable (Cell * cell,
 								  gboolean editable) {
 	ASSERT (cell != NULL);
 
-	cell->attributes.editable = editable;
+	cell->attributes.editable = (editable != FALSE);
 }
 
 static void
@@ -183,7 +268,7 @@ cell_method_set_highlighted (Cell * cell,
 									  gboolean highlighted) {
 	ASSERT (cell != NULL);
 
-	cell->attributes.highlighted = highlighted;
+	cell->attributes.highlighted = (highlighted != FALSE);
 }
 
 /* @description: This method sets the range of the Cell object.
@@ -208,13 +293,29 @@ cell_method_set_attributes (Cell * cell,
 {
 	ASSERT (cell != NULL); ASSERT (attrib != NULL);
 
-	cell->attributes.justification = attrib->justification;
- 
-	g_string_assign (cell->attributes.fgcolor, attrib->fgcolor->str);
-	g_string_assign (cell->attributes.bgcolor, attrib->bgcolor->str);
+	cell->attributes = *attrib;
+}
+
+/* @description: This method returns the fgcolor of the Cell object, or an
+   empty string if it has not been set. */
+static const gchar *
+cell_method_get_fgcolor (const Cell * cell)
+{
+	ASSERT (cell != NULL);
 
-	cell->attributes.editable = attrib->editable;
-	cell->attributes.highlighted = attrib->highlighted;
+	Palette * palette = cell_palette (cell);
+	return palette->lookup (palette, cell->attributes.fgcolor);
+}
+
+/* @description: This method returns the bgcolor of the Cell object, or an
+   empty string if it has not been set. */
+static const gchar *
+cell_method_get_bgcolor (const Cell * cell)
+{
+	ASSERT (cell != NULL);
+
+	Palette * palette = cell_palette (cell);
+	return palette->lookup (palette, cell->attributes.bgcolor);
 }
 
 /* @description: This method sets the text value of the Cell object.
@@ -225,15 +326,36 @@ cell_method_set_value (Cell * cell,
 {
 	ASSERT (cell != NULL);
   
-	g_string_assign (cell->value, value);
+	cell_value_store (cell, value, strlen (value));
 }
 
+/* @description: This method sets the text value of the Cell object from a
+   string that is not NUL terminated (e.g. a field handed to us by libcsv).
+   @s: A pointer to the first byte of the value.
+   @length: The length of the value in bytes. */
 static void
 cell_method_set_value_length (Cell * cell, void * s, size_t length) {
 	ASSERT (cell != NULL);
 
-	g_string_assign (cell->value, "");
-	g_string_append_len (cell->value, (const char *)s, length);
+	cell_value_store (cell, (const gchar *)s, length);
+}
+
+/* @description: This method returns the text value of the Cell object. */
+static const gchar *
+cell_method_get_value (const Cell * cell)
+{
+	ASSERT (cell != NULL);
+
+	switch (cell->storage) {
+	case CELL_VALUE_INLINE:
+		return cell->value.buffer;
+	case CELL_VALUE_HEAP:
+		return cell->value.data;
+	default:
+		if (cell->sheet && cell->generation == cell->sheet->values->generation)
+			return cell->value.data;
+		return "";
+	}
 }
 
 static void
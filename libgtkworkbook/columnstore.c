@@ -0,0 +1,520 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <libgtkworkbook/columnstore.h>
+#include <glib/gthread.h>
+#include <string.h>
+#include <errno.h>
+
+/* Numbers and timestamps are never longer than this. */
+#define COLUMN_PARSE_MAX 64
+
+#define COLUMN_VALID(c,r) ((c)->validity[(r) >> 3] & (1 << ((r) & 7)))
+#define COLUMN_SET_VALID(c,r) ((c)->validity[(r) >> 3] |= (1 << ((r) & 7)))
+#define COLUMN_CLEAR_VALID(c,r) ((c)->validity[(r) >> 3] &= ~(1 << ((r) & 7)))
+
+/* columnstore.c (static) */
+static ColumnStore * column_store_object_init (gint, gint);
+static void column_store_object_free (ColumnStore *);
+static void column_store_method_destroy (ColumnStore *);
+static void column_store_method_set (ColumnStore *, gint, gint, const gchar *, gsize);
+static void column_store_method_reset (ColumnStore *);
+static gint column_store_method_get_type (ColumnStore *, gint);
+static gboolean column_store_method_is_valid (ColumnStore *, gint, gint);
+static gboolean column_store_method_get_int64 (ColumnStore *, gint, gint, gint64 *);
+static gboolean column_store_method_get_double (ColumnStore *, gint, gint, gdouble *);
+static const gchar * column_store_method_get_string (ColumnStore *, gint, gint);
+static gint column_parse (const gchar *, gsize, gint64 *, gdouble *);
+static gboolean column_parse_timestamp (const gchar *, gint64 *);
+static gint64 column_days_from_civil (gint64, gint, gint);
+static void column_civil_from_days (gint64, gint64 *, gint *, gint *);
+static void column_convert (ColumnStore *, Column *, gint);
+static guint32 column_intern (Column *, const gchar *, gsize);
+static void column_clear_dictionary (Column *);
+
+/* @description: This function returns a pointer to a new ColumnStore object.
+   @rows: The number of rows in the Sheet.
+   @columns: The number of columns in the Sheet. */
+ColumnStore *
+column_store_new (gint rows, gint columns)
+{
+	ColumnStore * store = column_store_object_init (rows, columns);
+	return store;
+}
+
+/* @description: This function is the ColumnStore object's constructor. A
+   column's typed array is only allocated once its type is known. */
+static ColumnStore *
+column_store_object_init (gint rows, gint columns)
+{
+	ColumnStore * obj = NEW (ColumnStore);
+
+	obj->max_rows = rows;
+	obj->max_columns = columns;
+	obj->columns = (Column *)g_malloc0 (sizeof (Column) * columns);
+	obj->lock = g_mutex_new ();
+
+	for (gint ii = 0; ii < columns; ii++)
+		obj->columns[ii].validity = (guint8 *)g_malloc0 ((rows + 7) / 8);
+
+	/* Methods */
+	obj->destroy = column_store_method_destroy;
+	obj->set = column_store_method_set;
+	obj->reset = column_store_method_reset;
+	obj->get_type = column_store_method_get_type;
+	obj->is_valid = column_store_method_is_valid;
+	obj->get_int64 = column_store_method_get_int64;
+	obj->get_double = column_store_method_get_double;
+	obj->get_string = column_store_method_get_string;
+
+	return obj;
+}
+
+/* @description: This function frees the ColumnStore object.
+   @store: A pointer to the object to free. */
+static void
+column_store_object_free (ColumnStore * store)
+{
+	ASSERT (store != NULL);
+
+	for (gint ii = 0; ii < store->max_columns; ii++) {
+		Column * column = &store->columns[ii];
+
+		column_clear_dictionary (column);
+		if (column->dictionary)
+			g_hash_table_destroy (column->dictionary);
+		if (column->strings)
+			g_ptr_array_free (column->strings, TRUE);
+
+		g_free (column->data.ints);
+		g_free (column->validity);
+	}
+
+	g_free (store->columns);
+	g_mutex_free (store->lock);
+	FREE (store);
+}
+
+static void
+column_store_method_destroy (ColumnStore * store)
+{
+	g_return_if_fail (store != NULL);
+
+	column_store_object_free (store);
+}
+
+/* @description: This function returns the number of days between the epoch
+   and a date in the proleptic Gregorian calendar. */
+static gint64
+column_days_from_civil (gint64 y, gint m, gint d)
+{
+	y -= (m <= 2);
+
+	gint64 era = (y >= 0 ? y : y - 399) / 400;
+	gint64 yoe = y - era * 400;
+	gint64 doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	gint64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+/* @description: This function is the inverse of column_days_from_civil. */
+static void
+column_civil_from_days (gint64 z, gint64 * y, gint * m, gint * d)
+{
+	z += 719468;
+
+	gint64 era = (z >= 0 ? z : z - 146096) / 146097;
+	gint64 doe = z - era * 146097;
+	gint64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	gint64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	gint64 mp = (5 * doy + 2) / 153;
+
+	*d = (gint)(doy - (153 * mp + 2) / 5 + 1);
+	*m = (gint)(mp < 10 ? mp + 3 : mp - 9);
+	*y = yoe + era * 400 + (*m <= 2);
+}
+
+/* @description: This function parses "YYYY-MM-DD", optionally followed by
+   a space (or T) and "HH:MM", "HH:MM:SS" or "HH:MM:SS.fff".
+   @s: A NUL terminated string.
+   @value: Set to the milliseconds since the epoch (UTC). */
+static gboolean
+column_parse_timestamp (const gchar * s, gint64 * value)
+{
+	gint field[6] = {0, 0, 0, 0, 0, 0};
+	const gint width[6] = {4, 2, 2, 2, 2, 2};
+	const gchar separator[6] = {'-', '-', ' ', ':', ':', '.'};
+	gint millis = 0;
+	gint ii = 0;
+
+	for (ii = 0; ii < 6; ii++) {
+		for (gint jj = 0; jj < width[ii]; jj++, s++) {
+			if (!g_ascii_isdigit (*s))
+				return FALSE;
+			field[ii] = field[ii] * 10 + (*s - '0');
+		}
+
+		if (*s == '\0')
+			break;
+		if (*s != separator[ii] && !(ii == 2 && *s == 'T'))
+			return FALSE;
+		s++;
+	}
+
+	/* A date must be complete, and so must the hours and minutes of a time. */
+	if (ii < 2 || ii == 3)
+		return FALSE;
+
+	if (ii == 6) {
+		gint digits = 0;
+		for (; g_ascii_isdigit (*s); s++, digits++)
+			if (digits < 3) millis = millis * 10 + (*s - '0');
+		if (*s != '\0' || digits == 0)
+			return FALSE;
+		for (; digits < 3; digits++)
+			millis *= 10;
+	}
+
+	if (field[1] < 1 || field[1] > 12 || field[2] < 1 || field[2] > 31
+		 || field[3] > 23 || field[4] > 59 || field[5] > 60)
+		return FALSE;
+
+	gint64 days = column_days_from_civil (field[0], field[1], field[2]);
+	*value = ((days * 86400) + field[3] * 3600 + field[4] * 60 + field[5]) * 1000 + millis;
+	return TRUE;
+}
+
+/* @description: This function works out the narrowest type that can hold a
+   value.
+   @s: A pointer to the value; it does not need to be NUL terminated.
+   @length: The length of the value in bytes.
+   @i: Set to the value for COLUMN_TYPE_INT64 and COLUMN_TYPE_TIMESTAMP.
+   @d: Set to the value for COLUMN_TYPE_DOUBLE. */
+static gint
+column_parse (const gchar * s, gsize length, gint64 * i, gdouble * d)
+{
+	gchar buf[COLUMN_PARSE_MAX];
+	gchar * end = NULL;
+
+	if (length == 0)
+		return COLUMN_TYPE_NULL;
+	if (length >= COLUMN_PARSE_MAX)
+		return COLUMN_TYPE_STRING;
+
+	memcpy (buf, s, length);
+	buf[length] = '\0';
+
+	/* strtoll and strtod both skip leading whitespace; we do not. */
+	if (g_ascii_isspace (buf[0]))
+		return COLUMN_TYPE_STRING;
+
+	errno = 0;
+	*i = g_ascii_strtoll (buf, &end, 10);
+	if (*end == '\0' && errno == 0)
+		return COLUMN_TYPE_INT64;
+
+	if (column_parse_timestamp (buf, i) == TRUE)
+		return COLUMN_TYPE_TIMESTAMP;
+
+	errno = 0;
+	*d = g_ascii_strtod (buf, &end);
+	if (*end == '\0' && errno == 0 && strpbrk (buf, "xX") == NULL
+		 && (g_ascii_isdigit (buf[0]) || buf[0] == '-' || buf[0] == '+' || buf[0] == '.'))
+		return COLUMN_TYPE_DOUBLE;
+
+	return COLUMN_TYPE_STRING;
+}
+
+/* @description: This function empties a string column's dictionary. */
+static void
+column_clear_dictionary (Column * column)
+{
+	if (column->strings == NULL)
+		return;
+
+	for (guint ii = 0; ii < column->strings->len; ii++)
+		g_free (g_ptr_array_index (column->strings, ii));
+
+	g_ptr_array_set_size (column->strings, 0);
+	g_hash_table_remove_all (column->dictionary);
+}
+
+/* @description: This function returns the dictionary code of a string,
+   adding it to the column's dictionary if it has not been seen before. */
+static guint32
+column_intern (Column * column, const gchar * s, gsize length)
+{
+	gchar * key = g_strndup (s, length);
+	gpointer value = g_hash_table_lookup (column->dictionary, key);
+
+	if (value != NULL) {
+		g_free (key);
+		return GPOINTER_TO_UINT (value) - 1;
+	}
+
+	guint32 code = column->strings->len;
+	g_ptr_array_add (column->strings, key);
+	g_hash_table_insert (column->dictionary, key, GUINT_TO_POINTER (code + 1));
+	return code;
+}
+
+/* @description: This function changes the type of a column, converting any
+   values that it already holds.
+   @type: The new type; it is always wider than the current one. */
+static void
+column_convert (ColumnStore * store, Column * column, gint type)
+{
+	gint rows = store->max_rows;
+
+	if (type == COLUMN_TYPE_STRING) {
+		guint32 * codes = g_new0 (guint32, rows);
+
+		column->dictionary = g_hash_table_new (g_str_hash, g_str_equal);
+		column->strings = g_ptr_array_new ();
+
+		for (gint row = 0; column->type != COLUMN_TYPE_NULL && row < rows; row++) {
+			gchar buf[COLUMN_PARSE_MAX];
+
+			if (!COLUMN_VALID (column, row))
+				continue;
+
+			if (column->type == COLUMN_TYPE_INT64)
+				g_snprintf (buf, sizeof (buf), "%" G_GINT64_FORMAT, column->data.ints[row]);
+			else if (column->type == COLUMN_TYPE_DOUBLE)
+				g_ascii_dtostr (buf, sizeof (buf), column->data.doubles[row]);
+			else {
+				gint64 ms = column->data.ints[row], days = ms / 86400000, year = 0;
+				gint month = 0, day = 0;
+
+				if (ms % 86400000 < 0) days--;
+				gint64 secs = (ms - days * 86400000) / 1000;
+				gint millis = (gint)((ms - days * 86400000) % 1000);
+
+				column_civil_from_days (days, &year, &month, &day);
+				g_snprintf (buf, sizeof (buf), "%04d-%02d-%02d %02d:%02d:%02d",
+								(gint)year, month, day, (gint)(secs / 3600),
+								(gint)(secs / 60 % 60), (gint)(secs % 60));
+
+				/* The fractional seconds are only printed when there are any. */
+				if (millis != 0)
+					g_snprintf (buf + strlen (buf), sizeof (buf) - strlen (buf), ".%03d", millis);
+			}
+
+			codes[row] = column_intern (column, buf, strlen (buf));
+		}
+
+		g_free (column->data.ints);
+		column->data.codes = codes;
+	}
+	else if (type == COLUMN_TYPE_DOUBLE && column->type == COLUMN_TYPE_INT64) {
+		gdouble * doubles = g_new0 (gdouble, rows);
+
+		for (gint row = 0; row < rows; row++)
+			if (COLUMN_VALID (column, row))
+				doubles[row] = (gdouble)column->data.ints[row];
+
+		g_free (column->data.ints);
+		column->data.doubles = doubles;
+	}
+	else if (type == COLUMN_TYPE_DOUBLE)
+		column->data.doubles = g_new0 (gdouble, rows);
+	else
+		column->data.ints = g_new0 (gint64, rows);
+
+	column->type = type;
+}
+
+/* @description: This method writes a value into the store, widening the
+   column's type first if it cannot hold the value. An empty value clears the
+   row's validity bit.
+   @s: A pointer to the value; it does not need to be NUL terminated.
+   @length: The length of the value in bytes. */
+static void
+column_store_method_set (ColumnStore * store,
+								 gint row,
+								 gint column,
+								 const gchar * s,
+								 gsize length)
+{
+	ASSERT (store != NULL);
+
+	if (row < 0 || row >= store->max_rows || column < 0 || column >= store->max_columns)
+		return;
+
+	gint64 i = 0;
+	gdouble d = 0.0;
+	gint type = column_parse (s, length, &i, &d);
+	Column * c = &store->columns[column];
+
+	g_mutex_lock (store->lock);
+
+	if (type == COLUMN_TYPE_NULL) {
+		COLUMN_CLEAR_VALID (c, row);
+		g_mutex_unlock (store->lock);
+		return;
+	}
+
+	if (c->type != type) {
+		gint wider = COLUMN_TYPE_STRING;
+
+		if (c->type == COLUMN_TYPE_NULL)
+			wider = type;
+		else if (c->type == COLUMN_TYPE_DOUBLE && type == COLUMN_TYPE_INT64)
+			wider = COLUMN_TYPE_DOUBLE;
+		else if (c->type == COLUMN_TYPE_INT64 && type == COLUMN_TYPE_DOUBLE)
+			wider = COLUMN_TYPE_DOUBLE;
+
+		if (wider != c->type)
+			column_convert (store, c, wider);
+	}
+
+	switch (c->type) {
+	case COLUMN_TYPE_INT64:
+	case COLUMN_TYPE_TIMESTAMP:
+		c->data.ints[row] = i;
+		break;
+	case COLUMN_TYPE_DOUBLE:
+		c->data.doubles[row] = (type == COLUMN_TYPE_INT64) ? (gdouble)i : d;
+		break;
+	default:
+		c->data.codes[row] = column_intern (c, s, length);
+		break;
+	}
+
+	COLUMN_SET_VALID (c, row);
+	g_mutex_unlock (store->lock);
+}
+
+/* @description: This method forgets every value in the store (e.g. when a new
+   window of rows is about to be written). The types that were inferred for
+   the columns are kept. */
+static void
+column_store_method_reset (ColumnStore * store)
+{
+	ASSERT (store != NULL);
+
+	g_mutex_lock (store->lock);
+	for (gint ii = 0; ii < store->max_columns; ii++) {
+		memset (store->columns[ii].validity, 0, (store->max_rows + 7) / 8);
+		column_clear_dictionary (&store->columns[ii]);
+	}
+	g_mutex_unlock (store->lock);
+}
+
+/* @description: This method returns the inferred type of a column. */
+static gint
+column_store_method_get_type (ColumnStore * store, gint column)
+{
+	ASSERT (store != NULL);
+	g_return_val_if_fail (column >= 0 && column < store->max_columns, COLUMN_TYPE_NULL);
+
+	g_mutex_lock (store->lock);
+	gint type = store->columns[column].type;
+	g_mutex_unlock (store->lock);
+	return type;
+}
+
+/* @description: This method returns TRUE if a cell holds a value. */
+static gboolean
+column_store_method_is_valid (ColumnStore * store, gint row, gint column)
+{
+	ASSERT (store != NULL);
+
+	if (row < 0 || row >= store->max_rows || column < 0 || column >= store->max_columns)
+		return FALSE;
+
+	g_mutex_lock (store->lock);
+	gboolean valid = COLUMN_VALID (&store->columns[column], row) ? TRUE : FALSE;
+	g_mutex_unlock (store->lock);
+	return valid;
+}
+
+/* @description: This method reads a value from an int64 or timestamp column.
+   It returns FALSE if the cell does not hold such a value. */
+static gboolean
+column_store_method_get_int64 (ColumnStore * store,
+										 gint row,
+										 gint column,
+										 gint64 * value)
+{
+	ASSERT (store != NULL);
+	gboolean result = FALSE;
+
+	if (row < 0 || row >= store->max_rows || column < 0 || column >= store->max_columns)
+		return FALSE;
+
+	g_mutex_lock (store->lock);
+	Column * c = &store->columns[column];
+	if ((c->type == COLUMN_TYPE_INT64 || c->type == COLUMN_TYPE_TIMESTAMP)
+		 && COLUMN_VALID (c, row)) {
+		*value = c->data.ints[row];
+		result = TRUE;
+	}
+	g_mutex_unlock (store->lock);
+	return result;
+}
+
+/* @description: This method reads a value from any numeric column as a
+   double. It returns FALSE if the cell does not hold a number. */
+static gboolean
+column_store_method_get_double (ColumnStore * store,
+										  gint row,
+										  gint column,
+										  gdouble * value)
+{
+	ASSERT (store != NULL);
+	gboolean result = FALSE;
+
+	if (row < 0 || row >= store->max_rows || column < 0 || column >= store->max_columns)
+		return FALSE;
+
+	g_mutex_lock (store->lock);
+	Column * c = &store->columns[column];
+	if (COLUMN_VALID (c, row)) {
+		result = TRUE;
+		if (c->type == COLUMN_TYPE_DOUBLE)
+			*value = c->data.doubles[row];
+		else if (c->type == COLUMN_TYPE_INT64 || c->type == COLUMN_TYPE_TIMESTAMP)
+			*value = (gdouble)c->data.ints[row];
+		else
+			result = FALSE;
+	}
+	g_mutex_unlock (store->lock);
+	return result;
+}
+
+/* @description: This method reads a value from a string column. It returns
+   NULL if the cell does not hold a string. The pointer stays valid until the
+   next call to reset. */
+static const gchar *
+column_store_method_get_string (ColumnStore * store, gint row, gint column)
+{
+	ASSERT (store != NULL);
+	const gchar * result = NULL;
+
+	if (row < 0 || row >= store->max_rows || column < 0 || column >= store->max_columns)
+		return NULL;
+
+	g_mutex_lock (store->lock);
+	Column * c = &store->columns[column];
+	if (c->type == COLUMN_TYPE_STRING && COLUMN_VALID (c, row))
+		result = (const gchar *)g_ptr_array_index (c->strings, c->data.codes[row]);
+	g_mutex_unlock (store->lock);
+	return result;
+}
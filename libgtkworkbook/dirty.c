@@ -0,0 +1,212 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <libgtkworkbook/dirty.h>
+#include <glib/gthread.h>
+
+#define DIRTY_WORD_BITS 32
+#define DIRTY_WORDS(columns) (((columns) + DIRTY_WORD_BITS - 1) / DIRTY_WORD_BITS)
+
+struct dirtyForeach {
+	DirtySet * set;
+	DirtyVisitor visit;
+	gpointer data;
+};
+
+/* dirty.c (static) */
+static DirtySet * dirty_set_object_init (gint);
+static void dirty_set_object_free (DirtySet *);
+static void dirty_set_method_destroy (DirtySet *);
+static void dirty_set_method_mark (DirtySet *, gint, gint);
+static void dirty_set_method_mark_range (DirtySet *, gint, gint, gint, gint);
+static void dirty_set_method_clear (DirtySet *);
+static void dirty_set_method_foreach (DirtySet *, DirtyVisitor, gpointer);
+static guint32 * dirty_set_row (DirtySet *, gint);
+static void dirty_set_row_visit (gpointer, gpointer, gpointer);
+
+/* @description: This function returns a pointer to a new DirtySet object.
+   @columns: The number of columns of the Sheet it keeps track of. */
+DirtySet *
+dirty_set_new (gint columns)
+{
+	DirtySet * set = dirty_set_object_init (columns);
+	return set;
+}
+
+/* @description: This function is the DirtySet object's constructor. */
+static DirtySet *
+dirty_set_object_init (gint columns)
+{
+	DirtySet * obj = NEW (DirtySet);
+
+	obj->rows = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	obj->columns = (columns < 1) ? 1 : columns;
+	obj->count = 0;
+	obj->lock = g_mutex_new ();
+
+	/* Methods */
+	obj->destroy = dirty_set_method_destroy;
+	obj->mark = dirty_set_method_mark;
+	obj->mark_range = dirty_set_method_mark_range;
+	obj->clear = dirty_set_method_clear;
+	obj->foreach = dirty_set_method_foreach;
+
+	return obj;
+}
+
+/* @description: This function frees the DirtySet object.
+   @set: A pointer to the object to free. */
+static void
+dirty_set_object_free (DirtySet * set)
+{
+	ASSERT (set != NULL);
+
+	g_hash_table_destroy (set->rows);
+	g_mutex_free (set->lock);
+	FREE (set);
+}
+
+static void
+dirty_set_method_destroy (DirtySet * set)
+{
+	g_return_if_fail (set != NULL);
+
+	dirty_set_object_free (set);
+}
+
+/* @description: This function returns the column bitmap of a row, and
+   allocates it the first time that the row is marked. The lock must be
+   held. */
+static guint32 *
+dirty_set_row (DirtySet * set, gint row)
+{
+	guint32 * bits = g_hash_table_lookup (set->rows, GINT_TO_POINTER (row));
+
+	if (bits == NULL) {
+		bits = g_new0 (guint32, DIRTY_WORDS (set->columns));
+		g_hash_table_insert (set->rows, GINT_TO_POINTER (row), bits);
+	}
+	return bits;
+}
+
+/* @description: This method marks a single cell as changed.
+   @set: A pointer to the DirtySet object.
+   @row: The row of the cell.
+   @column: The column of the cell. */
+static void
+dirty_set_method_mark (DirtySet * set, gint row, gint column)
+{
+	ASSERT (set != NULL);
+
+	if (row < 0 || column < 0 || column >= set->columns)
+		return;
+
+	g_mutex_lock (set->lock);
+	guint32 * bits = dirty_set_row (set, row);
+	guint32 mask = 1U << (column % DIRTY_WORD_BITS);
+
+	if ((bits[column / DIRTY_WORD_BITS] & mask) == 0) {
+		bits[column / DIRTY_WORD_BITS] |= mask;
+		set->count++;
+	}
+	g_mutex_unlock (set->lock);
+}
+
+/* @description: This method marks every cell inside of a range as changed.
+   @set: A pointer to the DirtySet object.
+   @row0: The first row of the range.
+   @col0: The first column of the range.
+   @rowi: The last row of the range.
+   @coli: The last column of the range. */
+static void
+dirty_set_method_mark_range (DirtySet * set,
+									  gint row0,
+									  gint col0,
+									  gint rowi,
+									  gint coli)
+{
+	ASSERT (set != NULL);
+
+	if (row0 < 0) row0 = 0;
+	if (col0 < 0) col0 = 0;
+	if (coli >= set->columns) coli = set->columns - 1;
+
+	g_mutex_lock (set->lock);
+	for (gint ii = row0; ii <= rowi; ii++) {
+		guint32 * bits = dirty_set_row (set, ii);
+
+		for (gint jj = col0; jj <= coli; jj++) {
+			guint32 mask = 1U << (jj % DIRTY_WORD_BITS);
+
+			if ((bits[jj / DIRTY_WORD_BITS] & mask) == 0) {
+				bits[jj / DIRTY_WORD_BITS] |= mask;
+				set->count++;
+			}
+		}
+	}
+	g_mutex_unlock (set->lock);
+}
+
+/* @description: This method forgets about every change.
+   @set: A pointer to the DirtySet object. */
+static void
+dirty_set_method_clear (DirtySet * set)
+{
+	ASSERT (set != NULL);
+
+	g_mutex_lock (set->lock);
+	g_hash_table_remove_all (set->rows);
+	set->count = 0;
+	g_mutex_unlock (set->lock);
+}
+
+static void
+dirty_set_row_visit (gpointer key, gpointer value, gpointer data)
+{
+	struct dirtyForeach * foreach = (struct dirtyForeach *)data;
+	const guint32 * bits = (const guint32 *)value;
+	gint row = GPOINTER_TO_INT (key);
+
+	for (gint ww = 0; ww < DIRTY_WORDS (foreach->set->columns); ww++) {
+		for (guint32 word = bits[ww]; word != 0; word &= word - 1) {
+			gint bit = 0;
+
+			while (((word >> bit) & 1) == 0)
+				bit++;
+			foreach->visit (row, ww * DIRTY_WORD_BITS + bit, foreach->data);
+		}
+	}
+}
+
+/* @description: This method calls visit for each cell that has changed. The
+   set must not be changed from inside of visit.
+   @set: A pointer to the DirtySet object.
+   @visit: The function to call.
+   @data: Passed on to visit. */
+static void
+dirty_set_method_foreach (DirtySet * set, DirtyVisitor visit, gpointer data)
+{
+	ASSERT (set != NULL);
+	g_return_if_fail (visit != NULL);
+
+	struct dirtyForeach foreach = {set, visit, data};
+
+	g_mutex_lock (set->lock);
+	g_hash_table_foreach (set->rows, dirty_set_row_visit, &foreach);
+	g_mutex_unlock (set->lock);
+}
@@ -0,0 +1,653 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+/* mmap, open and fstat are POSIX; libgtkworkbook is built with -std=c99. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <libgtkworkbook/geometry.h>
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define GEOMETRY_ALIGN(n) (((n) + 7) & ~((guint64)7))
+
+/* The version 1 file format; only ever read now. */
+struct geometryFileHeader {
+	gint fileVersion;
+	gint maxRow;
+	gint maxColumn;
+};
+
+struct geometryFileEntry {
+	gint cellRow;
+	gint cellCol;
+	gint cellTextLength;
+	gboolean cellIsVisible;
+	gboolean cellIsEditable;
+	GtkJustification cellJustification;
+	GdkColor cellForeground;
+	GdkColor cellBackground;
+};
+
+/* geometry.c (static) */
+static guint geometry_attributes_hash (gconstpointer);
+static gboolean geometry_attributes_equal (gconstpointer, gconstpointer);
+static gboolean geometry_write (FILE *, guint64 *, gconstpointer, gsize);
+static gboolean geometry_pad (FILE *, guint64 *);
+static gboolean geometry_section_ok (guint64, guint64, guint64, guint64);
+static gboolean geometry_file_read_v1 (FILE *, gint *, gint *, GeometryVisitor, gpointer);
+static gboolean geometry_file_read_v2 (const gchar *, gint *, gint *, GeometryVisitor, gpointer);
+static gchar * geometry_journal_path (const gchar *);
+static gboolean geometry_journal_read (const gchar *, GeometryVisitor, gpointer);
+
+/* @description: This function hashes a GeometryAttributes structure. */
+static guint
+geometry_attributes_hash (gconstpointer key)
+{
+	const guint8 * p = (const guint8 *)key;
+	guint hash = 2166136261U;
+
+	for (gsize ii = 0; ii < sizeof (GeometryAttributes); ii++)
+		hash = (hash ^ p[ii]) * 16777619U;
+	return hash;
+}
+
+static gboolean
+geometry_attributes_equal (gconstpointer a, gconstpointer b)
+{
+	return memcmp (a, b, sizeof (GeometryAttributes)) == 0;
+}
+
+/* @description: This function writes a block of bytes and keeps track of the
+   offset into the file. */
+static gboolean
+geometry_write (FILE * fp, guint64 * offset, gconstpointer data, gsize size)
+{
+	if (size == 0)
+		return TRUE;
+	*offset += size;
+	return fwrite (data, 1, size, fp) == size;
+}
+
+/* @description: This function pads the file out to the next 8 byte
+   boundary. */
+static gboolean
+geometry_pad (FILE * fp, guint64 * offset)
+{
+	static const gchar zero[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	return geometry_write (fp, offset, zero, GEOMETRY_ALIGN (*offset) - *offset);
+}
+
+/* @description: This function writes a version 2 geometry file. The file is
+   written next to filepath and renamed over it once it is complete, so a
+   failed save never leaves a half written file behind.
+   @filepath: The file to write.
+   @max_row: The highest row index of the sheet.
+   @max_column: The highest column index of the sheet.
+   @cells: The cells to save, ordered by column and then by row.
+   @count: The number of cells. */
+gboolean
+geometry_file_write (const gchar * filepath,
+							gint max_row,
+							gint max_column,
+							const GeometryCell * cells,
+							gint count)
+{
+	g_return_val_if_fail (!IS_NULLSTR (filepath), FALSE);
+	g_return_val_if_fail (count == 0 || cells != NULL, FALSE);
+
+	GHashTable * strings = g_hash_table_new (g_str_hash, g_str_equal);
+	GHashTable * attributes = g_hash_table_new (geometry_attributes_hash,
+															  geometry_attributes_equal);
+	const gchar ** string_table = g_new (const gchar *, count + 1);
+	guint32 * string_index = g_new (guint32, count + 1);
+	const GeometryAttributes ** attribute_table = g_new (const GeometryAttributes *, count + 1);
+	guint32 * cell_strings = g_new (guint32, count + 1);
+	guint32 * cell_attributes = g_new (guint32, count + 1);
+	GeometryColumn * columns = g_new0 (GeometryColumn, count + 1);
+	GeometryHeader header = {GEOMETRY_FILE_VERSION_2, GEOMETRY_FILE_MAGIC, max_row, max_column};
+	GeometryFooter footer;
+	guint32 n_strings = 0, n_attributes = 0, n_columns = 0;
+	guint64 strings_size = 0, offset = 0;
+	gboolean ok = TRUE;
+
+	memset (&footer, 0, sizeof (footer));
+
+	/* Give every distinct string and set of attributes an index. */
+	for (gint ii = 0; ii < count; ii++) {
+		const gchar * text = (cells[ii].text == NULL) ? "" : cells[ii].text;
+		gpointer value = g_hash_table_lookup (strings, text);
+
+		if (value == NULL) {
+			string_table[n_strings] = text;
+			string_index[n_strings] = (guint32)strings_size;
+			strings_size += strlen (text) + 1;
+			value = GUINT_TO_POINTER (++n_strings);
+			g_hash_table_insert (strings, (gpointer)text, value);
+		}
+		cell_strings[ii] = GPOINTER_TO_UINT (value) - 1;
+
+		value = g_hash_table_lookup (attributes, &cells[ii].attributes);
+		if (value == NULL) {
+			attribute_table[n_attributes] = &cells[ii].attributes;
+			value = GUINT_TO_POINTER (++n_attributes);
+			g_hash_table_insert (attributes, (gpointer)&cells[ii].attributes, value);
+		}
+		cell_attributes[ii] = GPOINTER_TO_UINT (value) - 1;
+	}
+
+	gchar * temppath = g_strdup_printf ("%s.tmp", filepath);
+	FILE * fp = fopen (temppath, "wb");
+
+	if (fp == NULL) {
+		g_warning ("%s: failed opening file '%s' for writing", __FUNCTION__, temppath);
+		ok = FALSE;
+		goto cleanup;
+	}
+
+	ok = ok && geometry_write (fp, &offset, &header, sizeof (header));
+	ok = ok && geometry_pad (fp, &offset);
+
+	footer.strings_offset = offset;
+	footer.strings_size = strings_size;
+	for (guint32 ii = 0; ok && ii < n_strings; ii++)
+		ok = geometry_write (fp, &offset, string_table[ii], strlen (string_table[ii]) + 1);
+	ok = ok && geometry_pad (fp, &offset);
+
+	footer.index_offset = offset;
+	ok = ok && geometry_write (fp, &offset, string_index, sizeof (guint32) * n_strings);
+	ok = ok && geometry_pad (fp, &offset);
+
+	footer.attributes_offset = offset;
+	for (guint32 ii = 0; ok && ii < n_attributes; ii++)
+		ok = geometry_write (fp, &offset, attribute_table[ii], sizeof (GeometryAttributes));
+	ok = ok && geometry_pad (fp, &offset);
+
+	/* One block for each column that has anything in it. */
+	for (gint start = 0, end = 0; ok && start < count; start = end) {
+		GeometryColumn * column = &columns[n_columns++];
+
+		for (end = start; end < count && cells[end].column == cells[start].column; end++);
+
+		column->column = cells[start].column;
+		column->count = end - start;
+
+		column->rows_offset = offset;
+		for (gint ii = start; ok && ii < end; ii++) {
+			guint32 row = cells[ii].row;
+			ok = geometry_write (fp, &offset, &row, sizeof (row));
+		}
+		ok = ok && geometry_pad (fp, &offset);
+
+		column->strings_offset = offset;
+		ok = ok && geometry_write (fp, &offset, &cell_strings[start], sizeof (guint32) * (end - start));
+		ok = ok && geometry_pad (fp, &offset);
+
+		column->runs_offset = offset;
+		for (gint ii = start; ok && ii < end; ) {
+			GeometryRun run = {ii - start, 0, cell_attributes[ii]};
+
+			for (; ii < end && cell_attributes[ii] == run.attributes; ii++)
+				run.length++;
+
+			ok = geometry_write (fp, &offset, &run, sizeof (run));
+			column->n_runs++;
+		}
+		ok = ok && geometry_pad (fp, &offset);
+	}
+
+	footer.columns_offset = offset;
+	ok = ok && geometry_write (fp, &offset, columns, sizeof (GeometryColumn) * n_columns);
+	ok = ok && geometry_pad (fp, &offset);
+
+	footer.n_strings = n_strings;
+	footer.n_attributes = n_attributes;
+	footer.n_columns = n_columns;
+	footer.magic = GEOMETRY_FILE_MAGIC;
+	ok = ok && geometry_write (fp, &offset, &footer, sizeof (footer));
+
+	if (fflush (fp) != 0)
+		ok = FALSE;
+	FCLOSE (fp);
+
+	if (ok == FALSE || g_rename (temppath, filepath) != 0) {
+		g_warning ("%s: failed writing file '%s'", __FUNCTION__, filepath);
+		g_unlink (temppath);
+		ok = FALSE;
+	}
+	else {
+		/* Everything in the journal is in the new file now. */
+		gchar * journalpath = geometry_journal_path (filepath);
+		g_unlink (journalpath);
+		g_free (journalpath);
+	}
+
+ cleanup:
+	g_hash_table_destroy (strings);
+	g_hash_table_destroy (attributes);
+	g_free (string_table);
+	g_free (string_index);
+	g_free (attribute_table);
+	g_free (cell_strings);
+	g_free (cell_attributes);
+	g_free (columns);
+	g_free (temppath);
+	return ok;
+}
+
+/* @description: This function reads a version 1 geometry file. The header's
+   version has already been read from fp. */
+static gboolean
+geometry_file_read_v1 (FILE * fp,
+							  gint * max_row,
+							  gint * max_column,
+							  GeometryVisitor visit,
+							  gpointer data)
+{
+	struct geometryFileHeader header = {GEOMETRY_FILE_VERSION_1, -1, -1};
+	struct geometryFileEntry entry;
+
+	if (fread ((void *)&header.maxRow, sizeof (gint), 2, fp) != 2)
+		return FALSE;
+
+	if (max_row) *max_row = header.maxRow;
+	if (max_column) *max_column = header.maxColumn;
+
+	while (fread ((void *)&entry, sizeof (struct geometryFileEntry), 1, fp) > 0)
+	{
+		if (entry.cellTextLength < 0)
+			return FALSE;
+
+		gchar * text = g_strndup ("", entry.cellTextLength);
+		if (fread ((void *)text, sizeof (gchar), entry.cellTextLength, fp) 
+			 != (size_t)entry.cellTextLength) {
+			FREE (text);
+			return FALSE;
+		}
+
+		GeometryCell cell;
+		cell.row = entry.cellRow;
+		cell.column = entry.cellCol;
+		cell.text = text;
+		cell.attributes_index = -1;
+		cell.attributes.is_visible = entry.cellIsVisible;
+		cell.attributes.is_editable = entry.cellIsEditable;
+		cell.attributes.justification = entry.cellJustification;
+		cell.attributes.reserved = 0;
+		cell.attributes.fg_pixel = entry.cellForeground.pixel;
+		cell.attributes.fg_red = entry.cellForeground.red;
+		cell.attributes.fg_green = entry.cellForeground.green;
+		cell.attributes.fg_blue = entry.cellForeground.blue;
+		cell.attributes.bg_pixel = entry.cellBackground.pixel;
+		cell.attributes.bg_red = entry.cellBackground.red;
+		cell.attributes.bg_green = entry.cellBackground.green;
+		cell.attributes.bg_blue = entry.cellBackground.blue;
+
+		visit (&cell, data);
+		FREE (text);
+	}
+	return TRUE;
+}
+
+/* @description: This function returns TRUE if count elements of size bytes
+   starting at offset lie inside of a file of the given size. */
+static gboolean
+geometry_section_ok (guint64 file_size, guint64 offset, guint64 count, guint64 size)
+{
+	if (offset > file_size || (offset & 7) != 0)
+		return FALSE;
+	if (size != 0 && count > (file_size - offset) / size)
+		return FALSE;
+	return TRUE;
+}
+
+/* @description: This function reads a version 2 geometry file by mapping it
+   into memory. */
+static gboolean
+geometry_file_read_v2 (const gchar * filepath,
+							  gint * max_row,
+							  gint * max_column,
+							  GeometryVisitor visit,
+							  gpointer data)
+{
+	struct stat st;
+	int fd = open (filepath, O_RDONLY);
+
+	if (fd < 0)
+		return FALSE;
+
+	if (fstat (fd, &st) != 0 || st.st_size < (off_t)(sizeof (GeometryHeader) + sizeof (GeometryFooter))) {
+		close (fd);
+		return FALSE;
+	}
+
+	guint64 size = (guint64)st.st_size;
+	void * map = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close (fd);
+
+	if (map == MAP_FAILED) {
+		g_warning ("%s: failed mapping file '%s'", __FUNCTION__, filepath);
+		return FALSE;
+	}
+	posix_madvise (map, size, POSIX_MADV_SEQUENTIAL);
+
+	const guint8 * base = (const guint8 *)map;
+	const GeometryHeader * header = (const GeometryHeader *)base;
+	const GeometryFooter * footer = (const GeometryFooter *)(base + size - sizeof (GeometryFooter));
+	gboolean ok = FALSE;
+
+	if ((size & 7) != 0 || header->magic != GEOMETRY_FILE_MAGIC || footer->magic != GEOMETRY_FILE_MAGIC)
+		goto done;
+
+	if (!geometry_section_ok (size, footer->strings_offset, footer->strings_size, 1)
+		 || !geometry_section_ok (size, footer->index_offset, footer->n_strings, sizeof (guint32))
+		 || !geometry_section_ok (size, footer->attributes_offset, footer->n_attributes,
+										  sizeof (GeometryAttributes))
+		 || !geometry_section_ok (size, footer->columns_offset, footer->n_columns,
+										  sizeof (GeometryColumn)))
+		goto done;
+
+	/* Every string is terminated, so the last byte of the table must be too. */
+	if (footer->strings_size > 0 && base[footer->strings_offset + footer->strings_size - 1] != '\0')
+		goto done;
+
+	if (max_row) *max_row = header->max_row;
+	if (max_column) *max_column = header->max_column;
+
+	const gchar * table = (const gchar *)(base + footer->strings_offset);
+	const guint32 * index = (const guint32 *)(base + footer->index_offset);
+	const GeometryAttributes * attributes =
+		(const GeometryAttributes *)(base + footer->attributes_offset);
+	const GeometryColumn * columns = (const GeometryColumn *)(base + footer->columns_offset);
+
+	for (guint32 cc = 0; cc < footer->n_columns; cc++) {
+		const GeometryColumn * column = &columns[cc];
+
+		if (!geometry_section_ok (size, column->rows_offset, column->count, sizeof (guint32))
+			 || !geometry_section_ok (size, column->strings_offset, column->count, sizeof (guint32))
+			 || !geometry_section_ok (size, column->runs_offset, column->n_runs, sizeof (GeometryRun)))
+			goto done;
+
+		const guint32 * rows = (const guint32 *)(base + column->rows_offset);
+		const guint32 * strings = (const guint32 *)(base + column->strings_offset);
+		const GeometryRun * runs = (const GeometryRun *)(base + column->runs_offset);
+
+		for (guint32 rr = 0; rr < column->n_runs; rr++) {
+			const GeometryRun * run = &runs[rr];
+			GeometryCell cell;
+
+			if ((guint64)run->first + run->length > column->count
+				 || run->attributes >= footer->n_attributes)
+				goto done;
+
+			cell.column = column->column;
+			cell.attributes = attributes[run->attributes];
+			cell.attributes_index = run->attributes;
+
+			for (guint32 ii = run->first; ii < run->first + run->length; ii++) {
+				if (strings[ii] >= footer->n_strings || index[strings[ii]] >= footer->strings_size)
+					goto done;
+
+				cell.row = rows[ii];
+				cell.text = table + index[strings[ii]];
+				visit (&cell, data);
+			}
+		}
+	}
+	ok = TRUE;
+
+ done:
+	if (ok == FALSE)
+		g_warning ("%s: '%s' is not a valid geometry file", __FUNCTION__, filepath);
+	munmap (map, size);
+	return ok;
+}
+
+/* @description: This function reads a geometry file of any version and calls
+   visit for each cell in it, and then for each cell in its journal.
+   @filepath: The file to read.
+   @max_row: If not NULL, set to the highest row index that was saved.
+   @max_column: If not NULL, set to the highest column index that was saved.
+   @visit: The function to call for each cell.
+   @data: Passed on to visit. */
+gboolean
+geometry_file_read (const gchar * filepath,
+						  gint * max_row,
+						  gint * max_column,
+						  GeometryVisitor visit,
+						  gpointer data)
+{
+	g_return_val_if_fail (visit != NULL, FALSE);
+
+	if (IS_NULLSTR (filepath)) {
+		g_warning ("%s: filepath cannot be a NULL string", __FUNCTION__);
+		return FALSE;
+	}
+
+	FILE * fp = NULL;
+	if ((fp = fopen (filepath, "rb")) == NULL) {
+		g_warning ("%s: failed opening file '%s' for reading", 
+					  __FUNCTION__,
+					  filepath);
+		return FALSE;
+	}
+
+	gint version = -1;
+	gboolean result = FALSE;
+
+	if (fread ((void *)&version, sizeof (gint), 1, fp) != 1)
+		version = -1;
+
+	switch (version) {
+	case GEOMETRY_FILE_VERSION_1:
+		result = geometry_file_read_v1 (fp, max_row, max_column, visit, data);
+		FCLOSE (fp);
+		break;
+	case GEOMETRY_FILE_VERSION_2:
+		FCLOSE (fp);
+		result = geometry_file_read_v2 (filepath, max_row, max_column, visit, data);
+		break;
+	default:
+		g_warning ("Geometry file version %d is not accepted. (%d)",
+					  version, GEOMETRY_FILE_VERSION_2);
+		FCLOSE (fp);
+		break;
+	}
+
+	if (result == TRUE)
+		result = geometry_journal_read (filepath, visit, data);
+	return result;
+}
+
+/* @description: This function returns the path of a file's journal. The
+   caller has to free it. */
+static gchar *
+geometry_journal_path (const gchar * filepath)
+{
+	return g_strdup_printf ("%s.journal", filepath);
+}
+
+/* @description: This function appends cells that have changed since the
+   file was written to the file's journal. Only the cells passed in are
+   written, so the cost does not depend on the size of the file.
+   @filepath: The geometry file (not the journal).
+   @size: The size of the journal as returned by the previous append; zero
+   starts a new journal. Anything past it (e.g. half of a block that was
+   being written when the process died) is thrown away first. Set to the
+   new size on success.
+   @cells: The cells to append, in any order.
+   @count: The number of cells. */
+gboolean
+geometry_journal_append (const gchar * filepath,
+								 guint64 * size,
+								 const GeometryCell * cells,
+								 gint count)
+{
+	g_return_val_if_fail (!IS_NULLSTR (filepath), FALSE);
+	g_return_val_if_fail (size != NULL, FALSE);
+	g_return_val_if_fail (count == 0 || cells != NULL, FALSE);
+
+	gchar * journalpath = geometry_journal_path (filepath);
+	guint64 offset = *size;
+	gboolean ok = TRUE;
+	FILE * fp = NULL;
+
+	if (offset == 0) {
+		GeometryJournalHeader header;
+		struct stat st;
+
+		if (stat (filepath, &st) != 0) {
+			g_warning ("%s: '%s' has to be written before its journal", __FUNCTION__, filepath);
+			g_free (journalpath);
+			return FALSE;
+		}
+
+		memset (&header, 0, sizeof (header));
+		header.magic = GEOMETRY_JOURNAL_MAGIC;
+		header.file_size = st.st_size;
+		header.file_inode = st.st_ino;
+		header.file_mtime = st.st_mtime;
+
+		if ((fp = fopen (journalpath, "wb")) != NULL)
+			ok = geometry_write (fp, &offset, &header, sizeof (header));
+	}
+	else if ((fp = fopen (journalpath, "r+b")) != NULL) {
+		ok = (ftruncate (fileno (fp), (off_t)offset) == 0)
+			&& (fseeko (fp, (off_t)offset, SEEK_SET) == 0);
+	}
+
+	if (fp == NULL) {
+		g_warning ("%s: failed opening file '%s' for writing", __FUNCTION__, journalpath);
+		g_free (journalpath);
+		return FALSE;
+	}
+
+	GeometryJournalBlock block = {GEOMETRY_JOURNAL_MAGIC, count, 0};
+
+	for (gint ii = 0; ii < count; ii++) {
+		const gchar * text = (cells[ii].text == NULL) ? "" : cells[ii].text;
+		block.size += sizeof (GeometryJournalRecord) + strlen (text) + 1;
+	}
+	block.size = GEOMETRY_ALIGN (block.size);
+
+	guint64 end = offset + sizeof (block) + block.size;
+
+	ok = ok && geometry_write (fp, &offset, &block, sizeof (block));
+	for (gint ii = 0; ok && ii < count; ii++) {
+		const gchar * text = (cells[ii].text == NULL) ? "" : cells[ii].text;
+		GeometryJournalRecord record;
+
+		memset (&record, 0, sizeof (record));
+		record.row = cells[ii].row;
+		record.column = cells[ii].column;
+		record.length = strlen (text);
+		record.attributes = cells[ii].attributes;
+
+		ok = geometry_write (fp, &offset, &record, sizeof (record))
+			&& geometry_write (fp, &offset, text, record.length + 1);
+	}
+	ok = ok && geometry_pad (fp, &offset) && offset == end;
+
+	if (fflush (fp) != 0)
+		ok = FALSE;
+	FCLOSE (fp);
+
+	if (ok == TRUE)
+		*size = offset;
+	else
+		g_warning ("%s: failed writing file '%s'", __FUNCTION__, journalpath);
+
+	g_free (journalpath);
+	return ok;
+}
+
+/* @description: This function replays a file's journal, if it has one that
+   belongs to it. */
+static gboolean
+geometry_journal_read (const gchar * filepath, GeometryVisitor visit, gpointer data)
+{
+	gchar * journalpath = geometry_journal_path (filepath);
+	FILE * fp = fopen (journalpath, "rb");
+	GeometryJournalHeader header;
+	struct stat st, jst;
+
+	g_free (journalpath);
+	if (fp == NULL)
+		return TRUE;
+
+	if (fread (&header, sizeof (header), 1, fp) != 1
+		 || header.magic != GEOMETRY_JOURNAL_MAGIC
+		 || stat (filepath, &st) != 0
+		 || fstat (fileno (fp), &jst) != 0
+		 || header.file_size != (guint64)st.st_size
+		 || header.file_inode != (guint64)st.st_ino
+		 || header.file_mtime != (gint64)st.st_mtime) {
+		/* A journal that was left behind by an older file. */
+		FCLOSE (fp);
+		return TRUE;
+	}
+
+	guint64 remaining = (guint64)jst.st_size - sizeof (header);
+	GeometryJournalBlock block;
+
+	while (remaining >= sizeof (block) && fread (&block, sizeof (block), 1, fp) == 1) {
+		remaining -= sizeof (block);
+
+		if (block.magic != GEOMETRY_JOURNAL_MAGIC || block.size > remaining)
+			break;
+
+		gchar * payload = g_malloc (block.size + 1);
+		if (fread (payload, 1, block.size, fp) != block.size) {
+			g_free (payload);
+			break;
+		}
+		remaining -= block.size;
+
+		guint64 pos = 0;
+		for (guint32 ii = 0; ii < block.count; ii++) {
+			GeometryJournalRecord record;
+			GeometryCell cell;
+
+			if (block.size - pos < sizeof (record))
+				break;
+			memcpy (&record, payload + pos, sizeof (record));
+			pos += sizeof (record);
+
+			if (block.size - pos < (guint64)record.length + 1 || payload[pos + record.length] != '\0')
+				break;
+
+			cell.row = record.row;
+			cell.column = record.column;
+			cell.text = payload + pos;
+			cell.attributes = record.attributes;
+			cell.attributes_index = -1;
+			pos += record.length + 1;
+
+			visit (&cell, data);
+		}
+		g_free (payload);
+	}
+
+	FCLOSE (fp);
+	return TRUE;
+}
@@ -0,0 +1,302 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <libgtkworkbook/palette.h>
+#include <glib/gthread.h>
+#include <string.h>
+
+/* palette.c (static) */
+static Palette * palette_object_init (void);
+static void palette_object_free (Palette *);
+static void palette_method_destroy (Palette *);
+static guint16 palette_method_intern (Palette *, const gchar *);
+static const gchar * palette_method_lookup (Palette *, guint16);
+static gboolean palette_method_get_color (Palette *, guint16, GdkColormap *, GdkColor *);
+static gboolean palette_parse_color (const gchar *, GdkColor *);
+static guint16 palette_closest (Palette *, const gchar *);
+
+/* @description: This function returns a pointer to a new Palette object. */
+Palette *
+palette_new (void)
+{
+	Palette * palette = palette_object_init ();
+	return palette;
+}
+
+/* @description: This function returns the palette that is used by Cell
+   objects that do not belong to any Sheet. It is created the first time it is
+   asked for and lives for the rest of the process. */
+Palette *
+palette_default (void)
+{
+	static gsize initialized = 0;
+	static Palette * palette = NULL;
+
+	if (g_once_init_enter (&initialized)) {
+		palette = palette_object_init ();
+		g_once_init_leave (&initialized, 1);
+	}
+	return palette;
+}
+
+/* @description: This function is the Palette object's constructor. */
+static Palette *
+palette_object_init (void)
+{
+	Palette * obj = NEW (Palette);
+
+	obj->index = g_hash_table_new (g_str_hash, g_str_equal);
+	obj->names = g_ptr_array_sized_new (64);
+	obj->aliases = g_ptr_array_new ();
+	obj->full = FALSE;
+	obj->colors_size = 64;
+	obj->colors = (PaletteColor *)g_malloc0 (sizeof (PaletteColor) * obj->colors_size);
+	obj->colormap = NULL;
+	obj->lock = g_mutex_new ();
+
+	/* Slot zero is PALETTE_NONE. */
+	g_ptr_array_add (obj->names, g_strdup (""));
+
+	/* Methods */
+	obj->destroy = palette_method_destroy;
+	obj->intern = palette_method_intern;
+	obj->lookup = palette_method_lookup;
+	obj->get_color = palette_method_get_color;
+
+	obj->black = obj->intern (obj, "black");
+
+	return obj;
+}
+
+/* @description: This function frees the Palette object and all of the color
+   strings that it interned.
+   @palette: A pointer to the object to free. */
+static void
+palette_object_free (Palette * palette)
+{
+	ASSERT (palette != NULL);
+
+	for (guint ii = 0; ii < palette->names->len; ii++)
+		g_free (g_ptr_array_index (palette->names, ii));
+
+	g_ptr_array_free (palette->names, TRUE);
+	for (guint ii = 0; ii < palette->aliases->len; ii++)
+		g_free (g_ptr_array_index (palette->aliases, ii));
+	g_ptr_array_free (palette->aliases, TRUE);
+	g_free (palette->colors);
+	g_hash_table_destroy (palette->index);
+	g_mutex_free (palette->lock);
+	FREE (palette);
+}
+
+static void
+palette_method_destroy (Palette * palette)
+{
+	g_return_if_fail (palette != NULL);
+	g_return_if_fail (palette != palette_default ());
+
+	palette_object_free (palette);
+}
+
+/* @description: This method returns the index of a color string, adding the
+   string to the palette if it has not been seen before. An empty string (or
+   NULL) is always PALETTE_NONE.
+   @color: The string value of the color, e.g. white, #ffffcc. */
+static guint16
+palette_method_intern (Palette * palette, const gchar * color)
+{
+	ASSERT (palette != NULL);
+
+	if (IS_NULLSTR (color))
+		return PALETTE_NONE;
+
+	g_mutex_lock (palette->lock);
+
+	gpointer value = g_hash_table_lookup (palette->index, color);
+	guint16 index = (guint16)GPOINTER_TO_UINT (value);
+
+	if (value == NULL) {
+		if (palette->names->len > PALETTE_MAX) {
+			if (palette->full == FALSE)
+				g_warning ("Palette is full; '%s' and any new colors after it "
+							  "are shown as the closest color it holds", color);
+
+			palette->full = TRUE;
+
+			/* The alias is remembered, so the search is only done once. */
+			if ((index = palette_closest (palette, color)) != PALETTE_NONE) {
+				gchar * alias = g_strdup (color);
+
+				g_ptr_array_add (palette->aliases, alias);
+				g_hash_table_insert (palette->index, alias, GUINT_TO_POINTER (index));
+			}
+			g_mutex_unlock (palette->lock);
+			return index;
+		}
+
+		gchar * name = g_strdup (color);
+		index = (guint16)palette->names->len;
+
+		g_ptr_array_add (palette->names, name);
+		g_hash_table_insert (palette->index, name, GUINT_TO_POINTER (index));
+
+		if (index >= palette->colors_size) {
+			guint size = palette->colors_size * 2;
+
+			palette->colors = (PaletteColor *)g_realloc (palette->colors, sizeof (PaletteColor) * size);
+			memset (palette->colors + palette->colors_size, 0,
+					  sizeof (PaletteColor) * (size - palette->colors_size));
+			palette->colors_size = size;
+		}
+	}
+
+	g_mutex_unlock (palette->lock);
+	return index;
+}
+
+/* @description: This method returns the color string for an index. It
+   returns an empty string for PALETTE_NONE and for an unknown index.
+   @index: An index previously returned by intern. */
+static const gchar *
+palette_method_lookup (Palette * palette, guint16 index)
+{
+	ASSERT (palette != NULL);
+
+	const gchar * name = "";
+
+	if (index == PALETTE_NONE)
+		return name;
+
+	g_mutex_lock (palette->lock);
+	if (index < palette->names->len)
+		name = (const gchar *)g_ptr_array_index (palette->names, index);
+	g_mutex_unlock (palette->lock);
+
+	return name;
+}
+
+/* @description: This function parses a color string. A "#rrggbb" string is
+   decoded directly; anything else is handed to gdk_color_parse. */
+static gboolean
+palette_parse_color (const gchar * s, GdkColor * color)
+{
+	if (s[0] == '#' && strlen (s) == 7) {
+		gint v[6];
+
+		for (gint ii = 0; ii < 6; ii++)
+			if ((v[ii] = g_ascii_xdigit_value (s[ii + 1])) < 0)
+				return gdk_color_parse (s, color);
+
+		/* Scale 0xff up to 0xffff the same way that gdk_color_parse does. */
+		color->pixel = 0;
+		color->red = ((v[0] << 4) | v[1]) * 257;
+		color->green = ((v[2] << 4) | v[3]) * 257;
+		color->blue = ((v[4] << 4) | v[5]) * 257;
+		return TRUE;
+	}
+	return gdk_color_parse (s, color);
+}
+
+/* @description: This function returns the index of the color inside of a
+   full palette that is closest to a color string, or PALETTE_NONE if the
+   string is not a color at all. Hold the palette's lock.
+   @color: The string value of the color. */
+static guint16
+palette_closest (Palette * palette, const gchar * color)
+{
+	GdkColor want, have;
+	guint16 closest = PALETTE_NONE;
+	gint64 best = G_MAXINT64;
+
+	if (palette_parse_color (color, &want) == FALSE)
+		return PALETTE_NONE;
+
+	for (guint ii = 1; ii < palette->names->len && best > 0; ii++) {
+		if (palette->colors[ii].allocated == TRUE)
+			have = palette->colors[ii].color;
+		else if (palette_parse_color ((const gchar *)g_ptr_array_index (palette->names, ii), &have) == FALSE)
+			continue;
+
+		gint64 r = (gint64)want.red - have.red;
+		gint64 g = (gint64)want.green - have.green;
+		gint64 b = (gint64)want.blue - have.blue;
+		gint64 distance = r * r + g * g + b * b;
+
+		if (distance < best) {
+			best = distance;
+			closest = (guint16)ii;
+		}
+	}
+
+	return closest;
+}
+
+/* @description: This method returns the allocated GdkColor for an index,
+   parsing and allocating it the first time it is asked for.
+   @index: An index previously returned by intern.
+   @colormap: The colormap of the widget the color is for.
+   @color: Set to the allocated color. */
+static gboolean
+palette_method_get_color (Palette * palette,
+								  guint16 index,
+								  GdkColormap * colormap,
+								  GdkColor * color)
+{
+	ASSERT (palette != NULL);
+	g_return_val_if_fail (color != NULL, FALSE);
+
+	if (index == PALETTE_NONE)
+		return FALSE;
+
+	g_mutex_lock (palette->lock);
+
+	if (index >= palette->names->len) {
+		g_mutex_unlock (palette->lock);
+		return FALSE;
+	}
+
+	const gchar * name = (const gchar *)g_ptr_array_index (palette->names, index);
+	PaletteColor * entry = &palette->colors[index];
+
+	if (palette->colormap == NULL)
+		palette->colormap = colormap;
+
+	if (palette->colormap != colormap) {
+		/* Not the colormap we cache for. */
+		g_mutex_unlock (palette->lock);
+
+		if (palette_parse_color (name, color) == FALSE)
+			return FALSE;
+		gdk_color_alloc (colormap, color);
+		return TRUE;
+	}
+
+	if (entry->allocated == FALSE) {
+		if (palette_parse_color (name, &entry->color) == FALSE) {
+			g_mutex_unlock (palette->lock);
+			g_warning ("Unable to parse color '%s'", name);
+			return FALSE;
+		}
+		gdk_color_alloc (colormap, &entry->color);
+		entry->allocated = TRUE;
+	}
+
+	*color = entry->color;
+	g_mutex_unlock (palette->lock);
+	return TRUE;
+}
@@ -0,0 +1,389 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <libgtkworkbook/rangeset.h>
+#include <glib/gthread.h>
+#include <string.h>
+
+/* rangeset.c (static) */
+static RangeSet * range_set_object_init (void);
+static void range_set_object_free (RangeSet *);
+static void range_set_method_destroy (RangeSet *);
+static void range_set_method_add (RangeSet *, gint, gint, gint, gint);
+static void range_set_method_remove (RangeSet *, gint, gint, gint, gint);
+static gboolean range_set_method_contains (RangeSet *, gint, gint);
+static void range_set_method_clear (RangeSet *);
+static void range_set_update (RangeSet *, gint, gint, gint, gint, gboolean);
+static guint range_set_lower_bound (RangeSet *, gint);
+static void range_set_split (RangeSet *, gint);
+static void range_set_coalesce (RangeSet *, guint, guint);
+static void range_band_union (RangeBand *, gint, gint);
+static void range_band_subtract (RangeBand *, gint, gint);
+static gboolean range_band_equal (const RangeBand *, const RangeBand *);
+
+/* The edges of a range are compared one past their end. */
+#define RANGE_SET_MAX (G_MAXINT - 1)
+#define RANGE_BAND(set, ii) (&g_array_index ((set)->bands, RangeBand, (ii)))
+#define RANGE_SPAN(band, ii) (&g_array_index ((band)->columns, RangeSpan, (ii)))
+
+/* @description: This function returns a pointer to a new, empty RangeSet. */
+RangeSet *
+range_set_new (void)
+{
+	RangeSet * set = range_set_object_init ();
+	return set;
+}
+
+/* @description: This function is the RangeSet object's constructor. */
+static RangeSet *
+range_set_object_init (void)
+{
+	RangeSet * obj = NEW (RangeSet);
+
+	obj->bands = g_array_new (FALSE, FALSE, sizeof (RangeBand));
+	obj->lock = g_mutex_new ();
+
+	/* Methods */
+	obj->destroy = range_set_method_destroy;
+	obj->add = range_set_method_add;
+	obj->remove = range_set_method_remove;
+	obj->contains = range_set_method_contains;
+	obj->clear = range_set_method_clear;
+
+	return obj;
+}
+
+/* @description: This function frees the RangeSet object.
+   @set: A pointer to the object to free. */
+static void
+range_set_object_free (RangeSet * set)
+{
+	ASSERT (set != NULL);
+
+	range_set_method_clear (set);
+	g_array_free (set->bands, TRUE);
+	g_mutex_free (set->lock);
+	FREE (set);
+}
+
+static void
+range_set_method_destroy (RangeSet * set)
+{
+	g_return_if_fail (set != NULL);
+
+	range_set_object_free (set);
+}
+
+/* @description: This function returns the index of the first band that ends
+   on or after row, or the number of bands if there is none. The lock must
+   be held. */
+static guint
+range_set_lower_bound (RangeSet * set, gint row)
+{
+	guint lo = 0, hi = set->bands->len;
+
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (RANGE_BAND (set, mid)->last < row)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* @description: This function makes sure that no band crosses the boundary
+   just before row, by cutting the band which holds it in two. Both halves
+   keep the same columns. The lock must be held. */
+static void
+range_set_split (RangeSet * set, gint row)
+{
+	guint index = range_set_lower_bound (set, row);
+
+	if (index >= set->bands->len)
+		return;
+
+	RangeBand * band = RANGE_BAND (set, index);
+	if (band->first >= row)
+		return;
+
+	RangeBand upper;
+	upper.first = row;
+	upper.last = band->last;
+	upper.columns = g_array_sized_new (FALSE, FALSE, sizeof (RangeSpan),
+												  band->columns->len);
+	g_array_append_vals (upper.columns, band->columns->data, band->columns->len);
+	band->last = row - 1;
+
+	g_array_insert_val (set->bands, index + 1, upper);
+}
+
+/* @description: This function adds the columns col0 through coli to a band.
+   The spans that touch or overlap the new one are folded into it. */
+static void
+range_band_union (RangeBand * band, gint col0, gint coli)
+{
+	guint lo = 0, hi = band->columns->len;
+
+	/* The first span which is not entirely left of the new one. */
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (RANGE_SPAN (band, mid)->last < col0 - 1)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	guint end = lo;
+	while (end < band->columns->len && RANGE_SPAN (band, end)->first <= coli + 1)
+		end++;
+
+	RangeSpan span = {col0, coli};
+	if (end > lo) {
+		span.first = MIN (col0, RANGE_SPAN (band, lo)->first);
+		span.last = MAX (coli, RANGE_SPAN (band, end - 1)->last);
+		g_array_remove_range (band->columns, lo, end - lo);
+	}
+	g_array_insert_val (band->columns, lo, span);
+}
+
+/* @description: This function takes the columns col0 through coli out of a
+   band. A span which is cut in the middle is left as two spans. */
+static void
+range_band_subtract (RangeBand * band, gint col0, gint coli)
+{
+	for (guint ii = 0; ii < band->columns->len; ) {
+		RangeSpan * span = RANGE_SPAN (band, ii);
+
+		if (span->last < col0 || span->first > coli) {
+			ii++;
+			continue;
+		}
+
+		RangeSpan left = {span->first, col0 - 1};
+		RangeSpan right = {coli + 1, span->last};
+		g_array_remove_index (band->columns, ii);
+
+		if (right.first <= right.last)
+			g_array_insert_val (band->columns, ii, right);
+		if (left.first <= left.last) {
+			g_array_insert_val (band->columns, ii, left);
+			ii++;
+		}
+		if (right.first <= right.last)
+			ii++;
+	}
+}
+
+static gboolean
+range_band_equal (const RangeBand * a, const RangeBand * b)
+{
+	if (a->columns->len != b->columns->len)
+		return FALSE;
+	return memcmp (a->columns->data, b->columns->data,
+						a->columns->len * sizeof (RangeSpan)) == 0;
+}
+
+/* @description: This function merges neighbouring bands between the indexes
+   first and last which hold the same columns, so that the set does not grow
+   from repeatedly adding and removing the same rows. The lock must be
+   held. */
+static void
+range_set_coalesce (RangeSet * set, guint first, guint last)
+{
+	if (first > 0)
+		first--;
+
+	for (guint ii = first; ii + 1 < set->bands->len && ii <= last; ) {
+		RangeBand * band = RANGE_BAND (set, ii);
+		RangeBand * next = RANGE_BAND (set, ii + 1);
+
+		if (band->last + 1 == next->first && range_band_equal (band, next)) {
+			band->last = next->last;
+			g_array_free (next->columns, TRUE);
+			g_array_remove_index (set->bands, ii + 1);
+			if (last > 0)
+				last--;
+		}
+		else
+			ii++;
+	}
+}
+
+/* @description: This function adds or removes the cells inside of a range.
+   The bands crossing the edges of the range are split first, so that every
+   band touched afterwards lies entirely inside of it. The lock must be
+   held. */
+static void
+range_set_update (RangeSet * set,
+						gint row0,
+						gint col0,
+						gint rowi,
+						gint coli,
+						gboolean add)
+{
+	range_set_split (set, row0);
+	range_set_split (set, rowi + 1);
+
+	guint first = range_set_lower_bound (set, row0), ii = first;
+	gint row = row0;
+
+	while (row <= rowi) {
+		RangeBand * band = (ii < set->bands->len) ? RANGE_BAND (set, ii) : NULL;
+
+		if (band == NULL || band->first > row) {
+			/* A gap with no cells in it, which only adding can fill. */
+			gint last = (band == NULL || band->first > rowi) ? rowi : band->first - 1;
+
+			if (add == TRUE) {
+				RangeBand gap;
+				RangeSpan span = {col0, coli};
+
+				gap.first = row;
+				gap.last = last;
+				gap.columns = g_array_new (FALSE, FALSE, sizeof (RangeSpan));
+				g_array_append_val (gap.columns, span);
+				g_array_insert_val (set->bands, ii, gap);
+				ii++;
+			}
+			row = last + 1;
+			continue;
+		}
+
+		gint last = band->last;
+		if (add == TRUE) {
+			range_band_union (band, col0, coli);
+			ii++;
+		}
+		else {
+			range_band_subtract (band, col0, coli);
+			if (band->columns->len == 0) {
+				g_array_free (band->columns, TRUE);
+				g_array_remove_index (set->bands, ii);
+			}
+			else
+				ii++;
+		}
+		row = last + 1;
+	}
+
+	range_set_coalesce (set, first, ii);
+}
+
+/* @description: This method adds every cell inside of a range to the set.
+   @set: A pointer to the RangeSet object.
+   @row0: The first row of the range.
+   @col0: The first column of the range.
+   @rowi: The last row of the range.
+   @coli: The last column of the range. */
+static void
+range_set_method_add (RangeSet * set,
+							 gint row0,
+							 gint col0,
+							 gint rowi,
+							 gint coli)
+{
+	ASSERT (set != NULL);
+
+	if (row0 < 0) row0 = 0;
+	if (col0 < 0) col0 = 0;
+	if (rowi > RANGE_SET_MAX) rowi = RANGE_SET_MAX;
+	if (coli > RANGE_SET_MAX) coli = RANGE_SET_MAX;
+	if (rowi < row0 || coli < col0)
+		return;
+
+	g_mutex_lock (set->lock);
+	range_set_update (set, row0, col0, rowi, coli, TRUE);
+	g_mutex_unlock (set->lock);
+}
+
+/* @description: This method takes every cell inside of a range out of the
+   set.
+   @set: A pointer to the RangeSet object.
+   @row0: The first row of the range.
+   @col0: The first column of the range.
+   @rowi: The last row of the range.
+   @coli: The last column of the range. */
+static void
+range_set_method_remove (RangeSet * set,
+								 gint row0,
+								 gint col0,
+								 gint rowi,
+								 gint coli)
+{
+	ASSERT (set != NULL);
+
+	if (row0 < 0) row0 = 0;
+	if (col0 < 0) col0 = 0;
+	if (rowi > RANGE_SET_MAX) rowi = RANGE_SET_MAX;
+	if (coli > RANGE_SET_MAX) coli = RANGE_SET_MAX;
+	if (rowi < row0 || coli < col0)
+		return;
+
+	g_mutex_lock (set->lock);
+	range_set_update (set, row0, col0, rowi, coli, FALSE);
+	g_mutex_unlock (set->lock);
+}
+
+/* @description: This method returns TRUE if a cell is inside of the set.
+   @set: A pointer to the RangeSet object.
+   @row: The row of the cell.
+   @column: The column of the cell. */
+static gboolean
+range_set_method_contains (RangeSet * set, gint row, gint column)
+{
+	ASSERT (set != NULL);
+
+	gboolean found = FALSE;
+
+	g_mutex_lock (set->lock);
+	guint index = range_set_lower_bound (set, row);
+
+	if (index < set->bands->len && RANGE_BAND (set, index)->first <= row) {
+		RangeBand * band = RANGE_BAND (set, index);
+		guint lo = 0, hi = band->columns->len;
+
+		while (lo < hi) {
+			guint mid = lo + (hi - lo) / 2;
+
+			if (RANGE_SPAN (band, mid)->last < column)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		found = (lo < band->columns->len && RANGE_SPAN (band, lo)->first <= column);
+	}
+	g_mutex_unlock (set->lock);
+	return found;
+}
+
+/* @description: This method empties the set.
+   @set: A pointer to the RangeSet object. */
+static void
+range_set_method_clear (RangeSet * set)
+{
+	ASSERT (set != NULL);
+
+	g_mutex_lock (set->lock);
+	for (guint ii = 0; ii < set->bands->len; ii++)
+		g_array_free (RANGE_BAND (set, ii)->columns, TRUE);
+	g_array_set_size (set->bands, 0);
+	g_mutex_unlock (set->lock);
+}
@@ -18,35 +18,51 @@
 */
 #include <libgtkworkbook/row.h>
 
-static Row * row_object_init (gint);
+static Row * row_object_init (gint, gboolean);
 static void row_object_free (Row *);
 static void row_method_destroy (Row *);
 static Cell * row_method_getcell (Row *, gint);
+static Cell * row_method_findcell (Row *, gint);
 
 Row *
 row_new (gint cells) {
 	if (cells <= 0)
 		return NULL;
 	
-	Row * r = row_object_init (cells);
+	Row * r = row_object_init (cells, FALSE);
+	return r;
+}
+
+/* @description: This function returns a Row whose cells are allocated on
+   demand, e.g. the row and column titles of a Sheet.
+   @cells: The number of cells the row can hold. */
+Row *
+row_new_sparse (gint cells) {
+	if (cells <= 0)
+		return NULL;
+
+	Row * r = row_object_init (cells, TRUE);
 	return r;
 }
 
 static Row *
-row_object_init (gint cells) {
+row_object_init (gint cells, gboolean sparse) {
 	Row * r = NEW (Row);
 
 	/* Members */
-	r->cells = (Cell **) g_malloc (cells * sizeof (Cell *));
+	r->cells = (Cell **) g_malloc0 (cells * sizeof (Cell *));
 	r->size = cells;
 
 	/* Methods */
 	r->destroy = row_method_destroy;
 	r->get_cell = row_method_getcell;
+	r->find_cell = row_method_findcell;
 
 	/* Initialize the cells. */
-	for (gint ii = 0; ii < r->size; ii++)
-		r->cells[ii] = cell_new();
+	if (sparse == FALSE) {
+		for (gint ii = 0; ii < r->size; ii++)
+			r->cells[ii] = cell_new();
+	}
 	
 	return r;
 }
@@ -55,9 +71,12 @@ static void
 row_object_free (Row * row) {
 	
 	/* Destroy the cell pointers. */
-	for (gint ii = 0; ii < row->size; ii++)
-		row->cells[ii]->destroy (row->cells[ii]);
+	for (gint ii = 0; ii < row->size; ii++) {
+		if (row->cells[ii] != NULL)
+			row->cells[ii]->methods->destroy (row->cells[ii]);
+	}
 
+	FREE (row->cells);
 	FREE (row);
 }
 
@@ -70,7 +89,18 @@ row_method_destroy (Row * row) {
 
 static Cell *
 row_method_getcell (Row * row, gint column) {
-	if (!row || row->size < column)
+	if (!row || column < 0 || row->size <= column)
+		return NULL;
+
+	if (row->cells[ column ] == NULL)
+		row->cells[ column ] = cell_new();
+	
+	return row->cells[ column ];
+}
+
+static Cell *
+row_method_findcell (Row * row, gint column) {
+	if (!row || column < 0 || row->size <= column)
 		return NULL;
 
 	return row->cells[ column ];
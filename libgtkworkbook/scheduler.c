@@ -0,0 +1,251 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <libgtkworkbook/scheduler.h>
+
+/* scheduler.c (static) */
+static Scheduler * scheduler_object_init (gint);
+static void scheduler_object_free (Scheduler *);
+static void scheduler_method_destroy (Scheduler *);
+static void scheduler_method_push (Scheduler *, SchedulerFunc, gpointer, GDestroyNotify);
+static gboolean scheduler_method_run (Scheduler *);
+static void scheduler_method_hold (Scheduler *, Sheet *);
+static void scheduler_method_release (Scheduler *);
+static void scheduler_take (Scheduler *);
+static gboolean scheduler_dispatch (gpointer);
+
+/* @description: This function returns a pointer to a new Scheduler object.
+   @budget: The most time, in milliseconds, that a frame may take. */
+Scheduler *
+scheduler_new (gint budget)
+{
+	Scheduler * scheduler = scheduler_object_init (budget);
+	return scheduler;
+}
+
+/* @description: This function is the Scheduler object's constructor. */
+static Scheduler *
+scheduler_object_init (gint budget)
+{
+	Scheduler * obj = NEW (Scheduler);
+
+	obj->incoming = NULL;
+	obj->head = obj->tail = NULL;
+	obj->held = NULL;
+	obj->timer = g_timer_new ();
+	obj->budget = (budget < 0) ? 0 : budget;
+	obj->armed = 0;
+	obj->pending = 0;
+
+	/* Methods */
+	obj->destroy = scheduler_method_destroy;
+	obj->push = scheduler_method_push;
+	obj->run = scheduler_method_run;
+	obj->hold = scheduler_method_hold;
+	obj->release = scheduler_method_release;
+
+	return obj;
+}
+
+/* @description: This function frees the Scheduler object. The updates that
+   are still waiting are dropped without being applied.
+   @scheduler: A pointer to the object to free. */
+static void
+scheduler_object_free (Scheduler * scheduler)
+{
+	ASSERT (scheduler != NULL);
+
+	while (g_source_remove_by_user_data (scheduler))
+		;
+
+	scheduler_take (scheduler);
+	while (scheduler->head != NULL) {
+		SchedulerUpdate * update = scheduler->head;
+
+		scheduler->head = update->next;
+		if (update->destroy)
+			update->destroy (update->data);
+		g_free (update);
+	}
+
+	g_slist_free (scheduler->held);
+	g_timer_destroy (scheduler->timer);
+	FREE (scheduler);
+}
+
+static void
+scheduler_method_destroy (Scheduler * scheduler)
+{
+	g_return_if_fail (scheduler != NULL);
+
+	scheduler_object_free (scheduler);
+}
+
+/* @description: This method queues an update for the main loop. It can be
+   called from any thread, and never waits for a lock.
+   @scheduler: A pointer to the Scheduler object.
+   @func: The function that applies the update.
+   @data: Passed on to func.
+   @destroy: Called on data once the update has been applied (or dropped),
+   or NULL. */
+static void
+scheduler_method_push (Scheduler * scheduler,
+							  SchedulerFunc func,
+							  gpointer data,
+							  GDestroyNotify destroy)
+{
+	ASSERT (scheduler != NULL);
+	g_return_if_fail (func != NULL);
+
+	SchedulerUpdate * update = g_new (SchedulerUpdate, 1);
+	update->func = func;
+	update->data = data;
+	update->destroy = destroy;
+	g_atomic_int_inc (&scheduler->pending);
+
+	do {
+		update->next = (SchedulerUpdate *)g_atomic_pointer_get (&scheduler->incoming);
+	} while (!g_atomic_pointer_compare_and_exchange (&scheduler->incoming, update->next, update));
+
+	/* Only the push that finds the source missing adds it. */
+	if (g_atomic_int_compare_and_exchange (&scheduler->armed, 0, 1))
+		g_timeout_add (SCHEDULER_FRAME_BUDGET, scheduler_dispatch, scheduler);
+}
+
+/* @description: This function moves everything that has been pushed so far
+   onto the end of the main loop's own list, in the order it was pushed. */
+static void
+scheduler_take (Scheduler * scheduler)
+{
+	SchedulerUpdate * taken, * list = NULL, * last;
+
+	do {
+		taken = (SchedulerUpdate *)g_atomic_pointer_get (&scheduler->incoming);
+	} while (taken != NULL
+				&& !g_atomic_pointer_compare_and_exchange (&scheduler->incoming, taken, NULL));
+
+	/* The stack is newest first. */
+	for (last = taken; taken != NULL; ) {
+		SchedulerUpdate * next = taken->next;
+
+		taken->next = list;
+		list = taken;
+		taken = next;
+	}
+
+	if (list == NULL)
+		return;
+
+	if (scheduler->tail == NULL)
+		scheduler->head = list;
+	else
+		scheduler->tail->next = list;
+	scheduler->tail = last;
+}
+
+/* @description: This method applies one frame of updates: as many as fit in
+   the budget, but always at least one. Hold the GDK lock.
+   @scheduler: A pointer to the Scheduler object.
+   @returns: TRUE if there are still updates waiting. */
+static gboolean
+scheduler_method_run (Scheduler * scheduler)
+{
+	ASSERT (scheduler != NULL);
+
+	scheduler_take (scheduler);
+	g_timer_start (scheduler->timer);
+
+	while (scheduler->head != NULL) {
+		SchedulerUpdate * update = scheduler->head;
+
+		scheduler->head = update->next;
+		if (scheduler->head == NULL)
+			scheduler->tail = NULL;
+
+		update->func (scheduler, update->data);
+		if (update->destroy)
+			update->destroy (update->data);
+		g_free (update);
+		g_atomic_int_add (&scheduler->pending, -1);
+
+		if (g_timer_elapsed (scheduler->timer, NULL) * 1000 >= scheduler->budget)
+			break;
+	}
+
+	scheduler_method_release (scheduler);
+	return (scheduler->head != NULL || g_atomic_pointer_get (&scheduler->incoming) != NULL);
+}
+
+/* @description: This method freezes a Sheet until the end of the frame, so
+   that all of the updates made to it in the frame are drawn at once. Only
+   call it from inside of an update.
+   @scheduler: A pointer to the Scheduler object.
+   @sheet: The Sheet that is about to change. */
+static void
+scheduler_method_hold (Scheduler * scheduler, Sheet * sheet)
+{
+	ASSERT (scheduler != NULL);
+	g_return_if_fail (sheet != NULL);
+
+	if (g_slist_find (scheduler->held, sheet) != NULL)
+		return;
+
+	gtk_sheet_freeze (GTK_SHEET (sheet->gtk_sheet));
+	scheduler->held = g_slist_prepend (scheduler->held, sheet);
+}
+
+/* @description: This method thaws (and so redraws) every Sheet that has
+   been held since the start of the frame.
+   @scheduler: A pointer to the Scheduler object. */
+static void
+scheduler_method_release (Scheduler * scheduler)
+{
+	ASSERT (scheduler != NULL);
+
+	for (GSList * it = scheduler->held; it != NULL; it = it->next) {
+		Sheet * sheet = (Sheet *)it->data;
+		gtk_sheet_thaw (GTK_SHEET (sheet->gtk_sheet));
+	}
+
+	g_slist_free (scheduler->held);
+	scheduler->held = NULL;
+}
+
+/* @description: This function is the main loop source. It applies a frame
+   and stays around for as long as there are updates waiting. */
+static gboolean
+scheduler_dispatch (gpointer data)
+{
+	Scheduler * scheduler = (Scheduler *)data;
+	gboolean waiting;
+
+	gdk_threads_enter ();
+	waiting = scheduler_method_run (scheduler);
+	gdk_threads_leave ();
+
+	if (waiting == TRUE)
+		return TRUE;
+
+	/* A push that came in after run took the stack still found armed set,
+		and so did not add a source; look again before going away. */
+	g_atomic_int_set (&scheduler->armed, 0);
+	if (g_atomic_pointer_get (&scheduler->incoming) != NULL
+		 && g_atomic_int_compare_and_exchange (&scheduler->armed, 0, 1))
+		return TRUE;
+	return FALSE;
+}
@@ -19,6 +19,7 @@
 #include <libgtkworkbook/sheet.h>
 #include <gtkextra/gtksheet.h>
 #include <string.h>
+#include <sys/stat.h>
 
 /* sheet.c (static) */
 static Sheet *sheet_object_init (Workbook *, const gchar *, gint, gint);
@@ -27,13 +28,27 @@ static void sheet_method_destroy (Sheet *);
 static void sheet_method_set_cell (Sheet *, gint, gint, const gchar *);
 static void sheet_method_apply_cell (Sheet *, const Cell *);
 static void sheet_method_apply_cellarray (Sheet *, Cell **, gint);
+static void sheet_method_apply_block (Sheet *, gint, gint, gint, const gsize *, const gchar *);
 static void sheet_method_apply_cellrange (Sheet *, const GtkSheetRange *, const CellAttributes *);
 static void sheet_method_range_set_background (Sheet *, const GtkSheetRange *, const gchar *);
 static void sheet_method_range_set_foreground (Sheet *, const GtkSheetRange *, const gchar *);
+static void sheet_method_ranges_set_background (Sheet *, const GtkSheetRange *, gint, const gchar *);
+static void sheet_method_ranges_set_foreground (Sheet *, const GtkSheetRange *, gint, const gchar *);
+static gboolean sheet_lookup_color (Sheet *, const gchar *, GdkColor *);
 static void sheet_method_set_attention (Sheet *, gint);
 static gboolean sheet_method_load (Sheet *, const gchar *);
 static gboolean sheet_method_save (Sheet *, const gchar *);
+static gboolean sheet_method_checkpoint (Sheet *, const gchar *);
+static Snapshot * sheet_method_snapshot (Sheet *, const gchar *, gboolean);
+static gboolean sheet_method_commit (Sheet *, Snapshot *, const gchar *);
+static void sheet_method_apply_snapshot (Sheet *, const Snapshot *);
+static void sheet_snapshot_visitor (gint, gint, gpointer);
+static void sheet_mark_styled (Sheet *, const GtkSheetRange *);
+static void sheet_apply_geometry_cell (const GeometryCell *, GtkSheet *);
+static void sheet_geometry_cell (GtkSheetCell *, GeometryCell *);
+static void sheet_changed (GtkSheet *, gint, gint, gpointer);
 static void sheet_method_apply_cellrow (Sheet *, gint);
+static void sheet_method_apply_cellrows (Sheet *, gint, gint);
 static void sheet_method_get_cellrow (Sheet *, gint, Cell **, gint);
 static void sheet_method_set_cell_value_length (Sheet *,gint,gint,void *,size_t);
 static void sheet_method_set_column_title (Sheet *, gint, const gchar *);
@@ -42,24 +57,23 @@ static void sheet_method_freeze_selection (Sheet *);
 static void sheet_method_thaw_selection (Sheet *);
 static void sheet_method_highlight_selection (Sheet *);
 static void sheet_method_dehighlight_selection (Sheet *);
+static gboolean sheet_method_is_highlighted (Sheet *, gint, gint);
 static void sheet_method_set_cell_background (Sheet *, gint, gint, const gchar *);
-
-struct geometryFileHeader {
-	gint fileVersion;
-	gint maxRow;
-	gint maxColumn;
-};
-
-struct geometryFileEntry {
-	gint cellRow;
-	gint cellCol;
-	gint cellTextLength;
-	gboolean cellIsVisible;
-	gboolean cellIsEditable;
-	GtkJustification cellJustification;
-	GdkColor cellForeground;
-	GdkColor cellBackground;
-};
+static Cell * sheet_method_get_cell (Sheet *, gint, gint);
+static const gchar * sheet_method_get_column_title (Sheet *, gint);
+static const gchar * sheet_method_get_row_title (Sheet *, gint);
+static void sheet_method_reset_values (Sheet *);
+static void sheet_method_set_shadow (Sheet *, gboolean);
+static void sheet_method_set_tail (Sheet *, gboolean);
+static gint sheet_tail_append (Sheet *, gboolean *);
+static void sheet_method_set_window (Sheet *, SheetWindowRequest, gpointer);
+static void sheet_method_set_window_lines (Sheet *, guint64);
+static void sheet_window_changed (GtkAdjustment *, gpointer);
+static void sheet_paint_marks (Sheet *);
+static void sheet_view_changed (GtkAdjustment *, gpointer);
+static void sheet_view_resized (GtkWidget *, GtkAllocation *, gpointer);
+static Cell * sheet_cell_lookup (Sheet *, gint, gint, gboolean);
+static gboolean sheet_cell_is_editable (Sheet *, gint, gint);
 
 /* @description: This method creates a new Sheet object and returns the
    pointer to that object. It calls the constructor function to do so.
@@ -79,6 +93,9 @@ sheet_new (Workbook * book, const gchar * label, gint rows, gint columns)
 	return sheet;
 }
 
+/* Sheets are only made from the main loop. */
+static guint sheet_serial = 0;
+
 /* @description: This function is the Sheet's constructor. 
    @book: A pointer to the Workbook that the Sheet object will be assigned.
    @label: A string label - the name of the sheet that we will use to search.
@@ -92,7 +109,7 @@ sheet_object_init (Workbook * book,
 	Sheet * sheet = NEW (Sheet);
 
 	/* Create the sheet containers and GtkSheet object. */
-	sheet->gtk_box = gtk_vbox_new (FALSE, 1);
+	sheet->gtk_box = gtk_hbox_new (FALSE, 1);
 
 	sheet->gtk_scrolledwindow = gtk_scrolled_window_new (NULL, NULL);
 	gtk_box_pack_start (GTK_BOX (sheet->gtk_box), sheet->gtk_scrolledwindow, 1,1,1);
@@ -119,26 +136,42 @@ sheet_object_init (Workbook * book,
 	/* Members */
 	sheet->workbook = book;
 	sheet->name = g_strdup (label);
+	sheet->serial = sheet_serial++;
 	sheet->attention = 0;
 	sheet->notices = 0;
 	sheet->has_focus = FALSE;
+	sheet->tail = FALSE;
+	sheet->tail_sequence = 0;
+	sheet->tail_count = 0;
+	sheet->tail_head = 0;
+	sheet->gtk_vscrollbar = NULL;
+	sheet->window_first = 0;
+	sheet->window_lines = 0;
+	sheet->window_request = NULL;
+	sheet->window_data = NULL;
 	sheet->next = sheet->prev = NULL;
 	sheet->max_rows = rows;
 	sheet->max_columns = columns;
-	sheet->column_titles = row_new ( sheet->max_columns );
-	sheet->row_titles = row_new ( sheet->max_rows );
+	sheet->column_titles = row_new_sparse ( sheet->max_columns );
+	sheet->row_titles = row_new_sparse ( sheet->max_rows );
 	
-	/* Allocation procedure for our cell buffer */
-	sheet->cells = (Cell ***) g_malloc (rows * sizeof (Cell**));
-	for (int ii = 0; ii < rows; ii++) {
-		sheet->cells[ii] = (Cell **) g_malloc (columns * sizeof (Cell*));
-
-		for (int jj = 0; jj < columns; jj++) {
-			sheet->cells[ii][jj] = cell_new();
-			sheet->cells[ii][jj]->row = ii;
-			sheet->cells[ii][jj]->column = jj;
-		}
-	}
+	/* The cell buffer is sparse: it maps a row index to an array of Cell
+		pointers, and both the array and the cells inside of it are only
+		allocated once something is written to them. */
+	sheet->cells = g_hash_table_new (g_direct_hash, g_direct_equal);
+	sheet->cells_lock = g_mutex_new ();
+	sheet->cells_cached_row = NULL;
+	sheet->cells_cached_index = -1;
+	sheet->values = arena_new (ARENA_SLAB_SIZE);
+	sheet->shadow = NULL;
+	sheet->dirty = dirty_set_new (columns);
+	sheet->frozen = range_set_new ();
+	sheet->highlighted = range_set_new ();
+	sheet->painted = range_set_new ();
+	sheet->checkpoint_path = NULL;
+	sheet->checkpoint_size = 0;
+	sheet->journal_size = 0;
+	sheet->checkpoint_lock = g_mutex_new ();
 	
 	/* Methods */
 	sheet->destroy = sheet_method_destroy;
@@ -146,13 +179,21 @@ sheet_object_init (Workbook * book,
 	sheet->set_cell_value_length = sheet_method_set_cell_value_length;
 	sheet->apply_range = sheet_method_apply_cellrange;
 	sheet->apply_array = sheet_method_apply_cellarray;
+	sheet->apply_block = sheet_method_apply_block;
 	sheet->apply_cell = sheet_method_apply_cell;
 	sheet->apply_row = sheet_method_apply_cellrow;
+	sheet->apply_rows = sheet_method_apply_cellrows;
 	sheet->range_set_foreground = sheet_method_range_set_foreground;
 	sheet->range_set_background = sheet_method_range_set_background;
+	sheet->ranges_set_foreground = sheet_method_ranges_set_foreground;
+	sheet->ranges_set_background = sheet_method_ranges_set_background;
 	sheet->set_attention = sheet_method_set_attention;
 	sheet->save = sheet_method_save;
 	sheet->load = sheet_method_load;
+	sheet->checkpoint = sheet_method_checkpoint;
+	sheet->snapshot = sheet_method_snapshot;
+	sheet->commit = sheet_method_commit;
+	sheet->apply_snapshot = sheet_method_apply_snapshot;
 	sheet->get_row = sheet_method_get_cellrow;
 	sheet->set_column_title = sheet_method_set_column_title;
 	sheet->set_row_title = sheet_method_set_row_title;
@@ -160,9 +201,27 @@ sheet_object_init (Workbook * book,
 	sheet->thaw_selection = sheet_method_thaw_selection;
 	sheet->highlight_selection = sheet_method_highlight_selection;
 	sheet->dehighlight_selection = sheet_method_dehighlight_selection;
+	sheet->is_highlighted = sheet_method_is_highlighted;
 	sheet->set_cell_background = sheet_method_set_cell_background;
+	sheet->get_cell = sheet_method_get_cell;
+	sheet->get_column_title = sheet_method_get_column_title;
+	sheet->get_row_title = sheet_method_get_row_title;
+	sheet->reset_values = sheet_method_reset_values;
+	sheet->set_shadow = sheet_method_set_shadow;
+	sheet->set_tail = sheet_method_set_tail;
+	sheet->set_window = sheet_method_set_window;
+	sheet->set_window_lines = sheet_method_set_window_lines;
 	
 	/* Connect any signals that we need to. */
+	g_signal_connect (G_OBJECT (sheet->gtk_sheet), "changed",
+							G_CALLBACK (sheet_changed), sheet);
+
+	/* Frozen and highlighted cells are only painted while they are shown. */
+	g_signal_connect_after (G_OBJECT (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (sheet->gtk_scrolledwindow))),
+									"value-changed", G_CALLBACK (sheet_view_changed), sheet);
+	g_signal_connect_after (G_OBJECT (sheet->gtk_sheet), "size-allocate",
+									G_CALLBACK (sheet_view_resized), sheet);
+
 	if (!IS_NULL (sheet->workbook->signals[SIG_WORKBOOK_CHANGED]))
 	{
 		/*
@@ -175,6 +234,66 @@ sheet_object_init (Workbook * book,
 	return sheet;
 }
 
+/* @description: This function applies a single cell of a Snapshot to the
+   GtkSheet.
+   @cell: The cell to apply.
+   @gtksheet: The GtkSheet. */
+static void
+sheet_apply_geometry_cell (const GeometryCell * cell, GtkSheet * gtksheet)
+{
+	if (cell->row < 0 || cell->row > gtksheet->maxrow
+		 || cell->column < 0 || cell->column > gtksheet->maxcol)
+		return;
+
+	/* Only the journal records empty cells, for cells that were cleared. */
+	if (IS_NULLSTR (cell->text)) {
+		gtk_sheet_cell_clear (gtksheet, cell->row, cell->column);
+		return;
+	}
+
+	gtk_sheet_set_cell_text (gtksheet, cell->row, cell->column, cell->text);
+
+	GtkSheetCell ** sheetcell = &gtksheet->data[cell->row][cell->column];
+	const GeometryAttributes * attributes = &cell->attributes;
+
+	(*sheetcell)->attributes->is_editable = attributes->is_editable;
+	(*sheetcell)->attributes->is_visible = attributes->is_visible;
+	(*sheetcell)->attributes->justification = attributes->justification;
+	(*sheetcell)->attributes->foreground.pixel = attributes->fg_pixel;
+	(*sheetcell)->attributes->foreground.red = attributes->fg_red;
+	(*sheetcell)->attributes->foreground.green = attributes->fg_green;
+	(*sheetcell)->attributes->foreground.blue = attributes->fg_blue;
+	(*sheetcell)->attributes->background.pixel = attributes->bg_pixel;
+	(*sheetcell)->attributes->background.red = attributes->bg_red;
+	(*sheetcell)->attributes->background.green = attributes->bg_green;
+	(*sheetcell)->attributes->background.blue = attributes->bg_blue;
+}
+
+/* @description: This method applies every cell of a Snapshot (e.g. one that
+   was read from a file) to the GtkSheet. Hold the GDK lock.
+   @sheet: A pointer to the Sheet object.
+   @snapshot: The Snapshot to apply. */
+static void
+sheet_method_apply_snapshot (Sheet * sheet, const Snapshot * snapshot)
+{
+	ASSERT (sheet != NULL);
+	g_return_if_fail (snapshot != NULL);
+
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+
+	for (guint ii = 0; ii < snapshot->cells->len; ii++)
+		sheet_apply_geometry_cell (&g_array_index (snapshot->cells, GeometryCell, ii), gtksheet);
+
+	/* The Sheet no longer matches the last file that it was saved to. */
+	g_mutex_lock (sheet->checkpoint_lock);
+	FREE (sheet->checkpoint_path);
+	g_mutex_unlock (sheet->checkpoint_lock);
+}
+
+/* @description: This method loads the cells and their attributes from a
+   geometry file of either version.
+   @sheet: A pointer to the Sheet object.
+   @filepath: The file to load. */
 static gboolean
 sheet_method_load (Sheet * sheet, const gchar * filepath)
 {
@@ -185,57 +304,177 @@ sheet_method_load (Sheet * sheet, const gchar * filepath)
       return FALSE;
 	}
 
-	FILE * fp = NULL;
-	if ((fp = fopen (filepath, "rb")) == NULL) {
-      g_warning ("%s: failed opening file '%s' for reading", 
-					  __FUNCTION__,
-					  filepath);
-      return FALSE;
+	Snapshot * snapshot = snapshot_new (-1, -1, FALSE);
+	gboolean result = snapshot->read (snapshot, filepath);
+
+	if (result == TRUE)
+		sheet->apply_snapshot (sheet, snapshot);
+	snapshot->destroy (snapshot);
+	return result;
+}
+
+/* @description: This function copies a GtkSheet cell into a GeometryCell.
+   The text is not copied. */
+static void
+sheet_geometry_cell (GtkSheetCell * cell, GeometryCell * entry)
+{
+	entry->text = cell->text;
+	entry->attributes_index = -1;
+	entry->attributes.is_visible = cell->attributes->is_visible;
+	entry->attributes.is_editable = cell->attributes->is_editable;
+	entry->attributes.justification = cell->attributes->justification;
+	entry->attributes.fg_pixel = cell->attributes->foreground.pixel;
+	entry->attributes.fg_red = cell->attributes->foreground.red;
+	entry->attributes.fg_green = cell->attributes->foreground.green;
+	entry->attributes.fg_blue = cell->attributes->foreground.blue;
+	entry->attributes.bg_pixel = cell->attributes->background.pixel;
+	entry->attributes.bg_red = cell->attributes->background.red;
+	entry->attributes.bg_green = cell->attributes->background.green;
+	entry->attributes.bg_blue = cell->attributes->background.blue;
+}
+
+struct sheetSnapshot {
+	GtkSheet * gtksheet;
+	Snapshot * snapshot;
+};
+
+/* @description: This function copies a single dirty cell into a delta
+   Snapshot. A cell that has no text any more is copied with empty text so
+   that loading clears it.
+   @data: A pointer to a sheetSnapshot structure. */
+static void
+sheet_snapshot_visitor (gint row, gint column, gpointer data)
+{
+	struct sheetSnapshot * delta = (struct sheetSnapshot *)data;
+	GtkSheet * gtksheet = delta->gtksheet;
+	GeometryCell entry;
+
+	memset (&entry, 0, sizeof (entry));
+	entry.row = row;
+	entry.column = column;
+	entry.text = "";
+	entry.attributes_index = -1;
+
+	if (row <= gtksheet->maxallocrow && column <= gtksheet->maxalloccol) {
+		GtkSheetCell * cell = gtksheet->data[row][column];
+
+		if (!IS_NULL (cell) && !IS_NULLSTR (cell->text))
+			sheet_geometry_cell (cell, &entry);
 	}
-	
+	delta->snapshot->add (delta->snapshot, &entry);
+}
+
+/* @description: This method takes a point-in-time Snapshot of the Sheet to
+   be written to a file by commit, which can be done on another thread. If
+   checkpoint is TRUE and the Sheet was last saved to the same file (and its
+   journal has not grown larger than the file), the Snapshot only holds the
+   cells that changed since then; otherwise it holds every cell with text.
+   Either way the Sheet is clean afterwards. Hold the GDK lock.
+   @sheet: A pointer to the Sheet object.
+   @filepath: The file that the Snapshot is going to be written to.
+   @checkpoint: TRUE if a delta Snapshot will do. */
+static Snapshot *
+sheet_method_snapshot (Sheet * sheet, const gchar * filepath, gboolean checkpoint)
+{
+	ASSERT (sheet != NULL);
+	g_return_val_if_fail (!IS_NULLSTR (filepath), NULL);
+
 	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
-	struct geometryFileHeader header = {-1,-1,-1};
-	struct geometryFileEntry entry = {-1,-1,-1};
- 
-	fread ((void *)&header, sizeof (struct geometryFileHeader), 1, fp);
+	gint max_row = gtksheet->maxallocrow;
+	gint max_column = gtksheet->maxalloccol;
+	Snapshot * snapshot = NULL;
+
+	g_mutex_lock (sheet->checkpoint_lock);
+	if (checkpoint == TRUE
+		 && sheet->checkpoint_path != NULL
+		 && strcmp (sheet->checkpoint_path, filepath) == 0
+		 && (sheet->journal_size <= GEOMETRY_JOURNAL_COMPACT_SIZE
+			  || sheet->journal_size <= sheet->checkpoint_size)) {
+		struct sheetSnapshot delta = {
+			gtksheet, snapshot_new (max_row, max_column, TRUE)
+		};
+
+		sheet->dirty->foreach (sheet->dirty, sheet_snapshot_visitor, &delta);
+		snapshot = delta.snapshot;
+	}
+	else {
+		snapshot = snapshot_new (max_row, max_column, FALSE);
+
+		/* The file is column-blocked, so walk the sheet a column at a time. */
+		for (gint jj = 0; jj <= max_column; jj++) {
+			for (gint ii = 0; ii <= max_row; ii++) {
+				GtkSheetCell * cell = gtksheet->data[ii][jj];
+				GeometryCell entry;
+
+				if (IS_NULL (cell) || IS_NULLSTR (cell->text))
+					continue;
+
+				memset (&entry, 0, sizeof (entry));
+				entry.row = ii;
+				entry.column = jj;
+				sheet_geometry_cell (cell, &entry);
+				snapshot->add (snapshot, &entry);
+			}
+		}
 
-	if (header.fileVersion != GEOMETRY_FILE_VERSION) {
-      g_warning ("Geometry file version %d is not accepted. (%d)",
-					  header.fileVersion, GEOMETRY_FILE_VERSION);
-      FCLOSE (fp);
-		return FALSE;
+		/* From here on deltas for this file go into a fresh journal. */
+		FREE (sheet->checkpoint_path);
+		sheet->checkpoint_path = g_strdup (filepath);
+		sheet->journal_size = 0;
 	}
+	sheet->dirty->clear (sheet->dirty);
+	g_mutex_unlock (sheet->checkpoint_lock);
 
-	while (fread ((void *)&entry, sizeof (struct geometryFileEntry), 1, fp) > 0)
-	{
-      gchar * text = g_strndup ("", entry.cellTextLength);
-      fread ((void *)text, sizeof (gchar), entry.cellTextLength, fp);
-      gtk_sheet_set_cell_text (gtksheet, 
-										 entry.cellRow, 
-										 entry.cellCol, 
-										 text);
-      
-      GtkSheetCell ** cell = &gtksheet->data[entry.cellRow][entry.cellCol];
-      
-      (*cell)->attributes->is_editable = entry.cellIsEditable;
-      (*cell)->attributes->is_visible = entry.cellIsVisible;
-      (*cell)->attributes->justification = entry.cellJustification;
-      (*cell)->attributes->foreground.pixel = entry.cellForeground.pixel;
-      (*cell)->attributes->foreground.red = entry.cellForeground.red;
-      (*cell)->attributes->foreground.green = entry.cellForeground.green;
-      (*cell)->attributes->foreground.blue = entry.cellForeground.blue;
-      (*cell)->attributes->background.pixel = entry.cellBackground.pixel;
-      (*cell)->attributes->background.red = entry.cellBackground.red;
-      (*cell)->attributes->background.green = entry.cellBackground.green;
-      (*cell)->attributes->background.blue = entry.cellBackground.blue;
+	return snapshot;
+}
 
-      FREE (text);
+/* @description: This method writes a Snapshot that was taken by snapshot.
+   It does not touch the GtkSheet, so it can be called from any thread;
+   Snapshots of the same Sheet have to be committed in the order in which
+   they were taken. When a commit fails the next snapshot is a full one.
+   @sheet: A pointer to the Sheet object.
+   @snapshot: The Snapshot; it is not freed.
+   @filepath: The file that it was taken for. */
+static gboolean
+sheet_method_commit (Sheet * sheet, Snapshot * snapshot, const gchar * filepath)
+{
+	ASSERT (sheet != NULL);
+	g_return_val_if_fail (snapshot != NULL, FALSE);
+	g_return_val_if_fail (!IS_NULLSTR (filepath), FALSE);
+
+	guint64 journal_size = 0;
+	gboolean result = FALSE;
+
+	/* A delta belongs to the journal of the file it was taken against. */
+	g_mutex_lock (sheet->checkpoint_lock);
+	gboolean current = (sheet->checkpoint_path != NULL
+							  && strcmp (sheet->checkpoint_path, filepath) == 0);
+	journal_size = sheet->journal_size;
+	g_mutex_unlock (sheet->checkpoint_lock);
+
+	if (snapshot->delta == FALSE || current == TRUE)
+		result = snapshot->write (snapshot, filepath, &journal_size);
+
+	g_mutex_lock (sheet->checkpoint_lock);
+	if (result == FALSE) {
+		if (current == TRUE || snapshot->delta == FALSE)
+			FREE (sheet->checkpoint_path);
 	}
+	else if (snapshot->delta == TRUE)
+		sheet->journal_size = journal_size;
+	else {
+		struct stat st;
+		sheet->checkpoint_size = (stat (filepath, &st) == 0) ? (guint64)st.st_size : 0;
+	}
+	g_mutex_unlock (sheet->checkpoint_lock);
 
-	FCLOSE (fp);
-	return TRUE;
+	return result;
 }
 
+/* @description: This method saves the cells of the Sheet that have text in
+   them, along with their attributes, to a version 2 geometry file.
+   @sheet: A pointer to the Sheet object.
+   @filepath: The file to save to. */
 static gboolean
 sheet_method_save (Sheet * sheet, const gchar * filepath) {
 	ASSERT (sheet != NULL);
@@ -245,56 +484,46 @@ sheet_method_save (Sheet * sheet, const gchar * filepath) {
       return FALSE;
 	}
 
-	FILE * fp = NULL;
-	if ((fp = fopen (filepath, "wb")) == NULL) {
-      g_warning ("%s: failed opening file '%s' for writing", 
-					  __FUNCTION__, 
-					  filepath);
+	Snapshot * snapshot = sheet->snapshot (sheet, filepath, FALSE);
+	gboolean result = sheet->commit (sheet, snapshot, filepath);
+
+	snapshot->destroy (snapshot);
+	return result;
+}
+
+/* @description: This method saves the Sheet to a file at a cost that is
+   proportional to what has changed since it was last saved there. Only the
+   dirty cells are appended to the file's journal; if the Sheet was not last
+   saved to this file, or the journal has grown larger than the file, the
+   whole Sheet is saved instead (see save).
+   @sheet: A pointer to the Sheet object.
+   @filepath: The file to save to. */
+static gboolean
+sheet_method_checkpoint (Sheet * sheet, const gchar * filepath) {
+	ASSERT (sheet != NULL);
+
+	if (IS_NULLSTR (filepath)) {
+      g_warning ("%s: filepath cannot be a NULL string", __FUNCTION__);
       return FALSE;
 	}
 
-	GtkSheetCell *** data = GTK_SHEET (sheet->gtk_sheet)->data;
-	struct geometryFileHeader header = {
-		GEOMETRY_FILE_VERSION,
-		GTK_SHEET (sheet->gtk_sheet)->maxallocrow,
-		GTK_SHEET (sheet->gtk_sheet)->maxalloccol
-	};
-
-	fwrite ((void *)&header, sizeof(struct geometryFileHeader), 1, fp);
-
-	for (gint ii = 0; ii <= header.maxRow; ii++) {
-      for (gint jj = 0; jj <= header.maxColumn; jj++) {
-			GtkSheetCell * cell = data[ii][jj];
-
-			if (!IS_NULL (cell) && !IS_NULLSTR(cell->text)) {
-				struct geometryFileEntry entry = {
-					cell->row,
-					cell->col,
-					strlen (cell->text),
-					cell->attributes->is_visible,
-					cell->attributes->is_editable,
-					cell->attributes->justification
-				};
-
-				entry.cellForeground.pixel = cell->attributes->foreground.pixel;
-				entry.cellForeground.red = cell->attributes->foreground.red;
-				entry.cellForeground.green = cell->attributes->foreground.green;
-				entry.cellForeground.blue = cell->attributes->foreground.blue;
-				entry.cellBackground.pixel = cell->attributes->background.pixel;
-				entry.cellBackground.red = cell->attributes->background.red;
-				entry.cellBackground.green = cell->attributes->background.green;
-				entry.cellBackground.blue = cell->attributes->background.blue;
-
-				fwrite ((void *)&entry, 
-						  sizeof (struct geometryFileEntry), 1, fp);
-				fwrite ((void *)cell->text, 
-						  sizeof (gchar), entry.cellTextLength, fp);
-			}
-		}
-	}
+	Snapshot * snapshot = sheet->snapshot (sheet, filepath, TRUE);
+	gboolean result = TRUE;
+
+	if (snapshot->delta == FALSE || snapshot->cells->len > 0)
+		result = sheet->commit (sheet, snapshot, filepath);
 
-	FCLOSE (fp);
-	return TRUE;
+	snapshot->destroy (snapshot);
+	return result;
+}
+
+/* @description: This function is called when a cell is edited through the
+   GtkSheet itself, and marks it as dirty. */
+static void
+sheet_changed (GtkSheet * gtksheet, gint row, gint column, gpointer data)
+{
+	Sheet * sheet = (Sheet *)data;
+	sheet->dirty->mark (sheet->dirty, row, column);
 }
 
 /* @description: This method sets the attention level of the Sheet.
@@ -318,86 +547,161 @@ sheet_method_set_attention (Sheet * sheet, gint attention) {
 static void
 sheet_method_destroy (Sheet * sheet) {
 	ASSERT (sheet != NULL);
+	Workbook * book = sheet->workbook;
+
+	DOUBLE_UNLINK (book->sheet_first, book->sheet_last, sheet);
 
-	DOUBLE_UNLINK (sheet->workbook->sheet_first,
-						sheet->workbook->sheet_last,
-						sheet);
+	if (book->focus_sheet == sheet)
+		book->focus_sheet = NULL;
+
+	/* A Sheet that was not taken out through remove_sheet first is still
+		inside of the Workbook's indexes; get_sheet must not hand it out. */
+	g_mutex_lock (book->sheets_lock);
+	if (g_hash_table_lookup (book->sheets_by_name, sheet->name) == sheet)
+		g_hash_table_remove (book->sheets_by_name, sheet->name);
+	if (g_hash_table_lookup (book->sheets_by_widget, sheet->gtk_box) == sheet)
+		g_hash_table_remove (book->sheets_by_widget, sheet->gtk_box);
+	book->generation++;
+	g_mutex_unlock (book->sheets_lock);
 
 	sheet_object_free (sheet);
 }
 
+/* @description: This function paints the frozen and highlighted cells of
+   the rows that the GtkSheet shows, and paints the ones that were painted
+   before but are neither any more back to white. The sets themselves can
+   cover any number of rows; only what is on screen is ever painted, and
+   painted remembers which cells were so that they can be cleaned up when
+   they scroll back into view.
+   @sheet: A pointer to the Sheet object. */
 static void
-sheet_method_freeze_selection (Sheet * sheet) {
-	ASSERT (sheet != NULL);
+sheet_paint_marks (Sheet * sheet) {
+	static const gchar * colors[] = { NULL, "#eeeeee", "#ffffcc", "#ffffff" };
 	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
-	register int ii, jj;
+	gint row0 = MAX (gtksheet->view.row0, 0);
+	gint rowi = MIN (gtksheet->view.rowi, gtksheet->maxrow);
+
+	for (gint ii = row0; ii <= rowi; ii++) {
+		gint first = 0, last = -1, state = 0;
+
+		/* Columns are painted in runs of the same state; the state of the
+			column past the last one is 0, which ends the last run. */
+		for (gint jj = 0; jj <= gtksheet->maxcol + 1; jj++) {
+			gint next = 0;
+
+			if (jj <= gtksheet->maxcol) {
+				if (sheet->highlighted->contains (sheet->highlighted, ii, jj) == TRUE)
+					next = 2;
+				else if (sheet->frozen->contains (sheet->frozen, ii, jj) == TRUE)
+					next = 1;
+				else if (sheet->painted->contains (sheet->painted, ii, jj) == TRUE)
+					next = 3;
+			}
 
-	sheet->range_set_background (sheet, &gtksheet->range, "#eeeeee");
+			if (next == state) {
+				last = jj;
+				continue;
+			}
 
-	for (ii = gtksheet->range.row0; ii <= gtksheet->range.rowi; ii++) {
-		jj = gtksheet->range.col0;
+			if (state != 0) {
+				GtkSheetRange range = { ii, first, ii, last };
+				GdkColor color;
 
-		do {
-			Cell * cell = sheet->cells[ii][jj++];
-			cell->attributes.editable = FALSE;
-		} while (jj <= gtksheet->range.coli);
+				if (sheet_lookup_color (sheet, colors[state], &color) == TRUE)
+					gtk_sheet_range_set_background (gtksheet, &range, &color);
+
+				if (state == 3)
+					sheet->painted->remove (sheet->painted, ii, first, ii, last);
+				else
+					sheet->painted->add (sheet->painted, ii, first, ii, last);
+			}
+			first = last = jj;
+			state = next;
+		}
 	}
 }
 
 static void
-sheet_method_highlight_selection (Sheet * sheet) {
-  ASSERT (sheet != NULL);
-  GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
-  register int ii, jj;
-  
-  sheet->range_set_background (sheet, &gtksheet->range, "#ffffcc");
+sheet_view_changed (GtkAdjustment * adjustment, gpointer data) {
+	sheet_paint_marks ((Sheet *)data);
+}
 
-  for (ii = gtksheet->range.row0; ii <= gtksheet->range.rowi; ii++) {
-    jj = gtksheet->range.col0;
+static void
+sheet_view_resized (GtkWidget * widget, GtkAllocation * allocation, gpointer data) {
+	sheet_paint_marks ((Sheet *)data);
+}
 
-    do {
-      Cell * cell = sheet->cells[ii][jj++];
-      cell->attributes.highlighted = TRUE;
-    }
-    while (jj <= gtksheet->range.coli);
-  }
+/* @description: This method makes every cell inside of the selection
+   read-only. The selection is remembered as a single range inside of the
+   frozen set, so it does not matter how many cells it covers; only the
+   rows of it that are shown get painted.
+   @sheet: A pointer to the Sheet object. */
+static void
+sheet_method_freeze_selection (Sheet * sheet) {
+	ASSERT (sheet != NULL);
+	GtkSheetRange * range = &GTK_SHEET (sheet->gtk_sheet)->range;
+
+	sheet->frozen->add (sheet->frozen, range->row0, range->col0,
+							  range->rowi, range->coli);
+	sheet_paint_marks (sheet);
 }
 
 static void
-sheet_method_dehighlight_selection (Sheet * sheet) {
-  ASSERT (sheet != NULL);
-  GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
-  register int ii, jj;
-  
-  sheet->range_set_background (sheet, &gtksheet->range, "#ffffff");
+sheet_method_highlight_selection (Sheet * sheet) {
+	ASSERT (sheet != NULL);
+	GtkSheetRange * range = &GTK_SHEET (sheet->gtk_sheet)->range;
+
+	sheet->highlighted->add (sheet->highlighted, range->row0, range->col0,
+									 range->rowi, range->coli);
+	sheet_paint_marks (sheet);
+}
 
-  for (ii = gtksheet->range.row0; ii <= gtksheet->range.rowi; ii++) {
-    jj = gtksheet->range.col0;
+static void
+sheet_method_dehighlight_selection (Sheet * sheet) {
+	ASSERT (sheet != NULL);
+	GtkSheetRange * range = &GTK_SHEET (sheet->gtk_sheet)->range;
 
-    do {
-      Cell * cell = sheet->cells[ii][jj++];
-      cell->attributes.highlighted = FALSE;
-    }
-    while (jj <= gtksheet->range.coli);
-  }
+	sheet->highlighted->remove (sheet->highlighted, range->row0, range->col0,
+										 range->rowi, range->coli);
+	sheet_paint_marks (sheet);
 }
 
 static void
 sheet_method_thaw_selection (Sheet * sheet) {
 	ASSERT (sheet != NULL);
-	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
-	register int ii, jj;
-	
-	sheet->range_set_background (sheet, &gtksheet->range, "#ffffff");
+	GtkSheetRange * range = &GTK_SHEET (sheet->gtk_sheet)->range;
 
-	for (ii = gtksheet->range.row0; ii <= gtksheet->range.rowi; ii++) {
-		jj = gtksheet->range.col0;
+	sheet->frozen->remove (sheet->frozen, range->row0, range->col0,
+								  range->rowi, range->coli);
+	sheet_paint_marks (sheet);
+}
 
-		do {
-			Cell * cell = sheet->cells[ii][jj++];
-			cell->attributes.editable = TRUE;
-		} while (jj <= gtksheet->range.coli);
+/* @description: This method returns TRUE if a cell was highlighted and has
+   not been dehighlighted since.
+   @sheet: A pointer to the Sheet object.
+   @row: The row of the cell.
+   @column: The column of the cell. */
+static gboolean
+sheet_method_is_highlighted (Sheet * sheet, gint row, gint column) {
+	ASSERT (sheet != NULL);
+	return sheet->highlighted->contains (sheet->highlighted, row, column);
+}
+
+/* @description: This function is called for each of the rows inside of
+   the sparse cell buffer when the Sheet is being freed.
+   @key: The row index.
+   @value: The array of Cell pointers for that row.
+   @data: A pointer to the Sheet object. */
+static void
+sheet_cell_row_free (gpointer key, gpointer value, gpointer data) {
+	Sheet * sheet = (Sheet *)data;
+	Cell ** cells = (Cell **)value;
+
+	for (int jj = 0; jj < sheet->max_columns; jj++) {
+		if (cells[jj] != NULL)
+			cells[jj]->methods->destroy (cells[jj]);
 	}
+	FREE (cells);
 }
 
 /* @description: This method frees the memory that was used by the Sheet
@@ -407,21 +711,95 @@ static void
 sheet_object_free (Sheet * sheet) {
 	ASSERT (sheet != NULL);
 
-	for (int ii = 0; ii < sheet->max_rows; ii++) {
-		for (int jj = 0; jj < sheet->max_columns; jj++) {
-			sheet->cells[ii][jj]->destroy (sheet->cells[ii][jj]);
-		}
-		FREE (sheet->cells[ii]);
-	}
+	g_hash_table_foreach (sheet->cells, sheet_cell_row_free, sheet);
+	g_hash_table_destroy (sheet->cells);
+	g_mutex_free (sheet->cells_lock);
+	sheet->values->destroy (sheet->values);
+	if (sheet->shadow)
+		sheet->shadow->destroy (sheet->shadow);
+	sheet->dirty->destroy (sheet->dirty);
+	sheet->frozen->destroy (sheet->frozen);
+	sheet->highlighted->destroy (sheet->highlighted);
+	sheet->painted->destroy (sheet->painted);
+	FREE (sheet->checkpoint_path);
+	g_mutex_free (sheet->checkpoint_lock);
+
+	sheet->row_titles->destroy (sheet->row_titles);
+	sheet->column_titles->destroy (sheet->column_titles);
 	
-	FREE (sheet->cells);
 	FREE (sheet->name);
-	FREE (sheet->row_titles);
-	FREE (sheet->column_titles);
 	FREE (sheet);
 	return;
 }
 
+/* @description: This function returns the Cell object at the specified
+   position inside of the sparse cell buffer. 
+   @sheet: A pointer to the Sheet object.
+   @row: An integer value of the row.
+   @column: An integer value of the column.
+   @create: If TRUE the cell (and its row) are allocated when they do not
+   exist yet; otherwise NULL is returned for a cell never touched. */
+static Cell *
+sheet_cell_lookup (Sheet * sheet, gint row, gint column, gboolean create) {
+	Cell ** cells = NULL;
+	Cell * cell = NULL;
+	
+	if (row < 0 || column < 0 || row >= sheet->max_rows || column >= sheet->max_columns)
+		return NULL;
+
+	/* The parser threads write into the buffer without holding the GDK lock
+		so the structure of the buffer has to be protected on its own. */
+	g_mutex_lock (sheet->cells_lock);
+	
+	/* Parsers write every field of a row before moving to the next one, so
+		remembering the last row saves a hash lookup for each field. */
+	if (sheet->cells_cached_index == row) {
+		cells = sheet->cells_cached_row;
+	}
+	else if ((cells = g_hash_table_lookup (sheet->cells, GINT_TO_POINTER (row))) == NULL) {
+		if (create == FALSE) {
+			g_mutex_unlock (sheet->cells_lock);
+			return NULL;
+		}
+
+		cells = (Cell **) g_malloc0 (sheet->max_columns * sizeof (Cell *));
+		g_hash_table_insert (sheet->cells, GINT_TO_POINTER (row), cells);
+	}
+
+	sheet->cells_cached_row = cells;
+	sheet->cells_cached_index = row;
+	
+	if (cells[column] == NULL && create == TRUE) {
+		cell = cell_new();
+		cell->sheet = sheet;
+		cell->methods->set_row (cell, row);
+		cell->methods->set_column (cell, column);
+		cells[column] = cell;
+	}
+
+	cell = cells[column];
+	g_mutex_unlock (sheet->cells_lock);
+	return cell;
+}
+
+/* @description: This function returns whether or not a cell is able to
+   receive updates, i.e. it is not inside of a frozen selection. */
+static gboolean
+sheet_cell_is_editable (Sheet * sheet, gint row, gint column) {
+	return !sheet->frozen->contains (sheet->frozen, row, column);
+}
+
+/* @description: This method returns the Cell object at a position inside of
+   the Sheet, or NULL if nothing has been written to that cell yet.
+   @sheet: A pointer to the Sheet object.
+   @row: An integer value of the row.
+   @column: An integer value of the column. */
+static Cell *
+sheet_method_get_cell (Sheet * sheet, gint row, gint column) {
+	ASSERT (sheet != NULL);
+	return sheet_cell_lookup (sheet, row, column, FALSE);
+}
+
 static void
 sheet_method_apply_cellrange (Sheet * sheet, 
 										const GtkSheetRange * range,
@@ -436,8 +814,19 @@ sheet_method_set_column_title (Sheet * sheet, gint column, const gchar * title)
 	ASSERT (sheet != NULL);
 	g_return_if_fail (title != NULL);
 	
+	Cell * cell = sheet->column_titles->get_cell (sheet->column_titles, column);
+	g_return_if_fail (cell != NULL);
+	
 	gtk_sheet_column_button_add_label ( GTK_SHEET (sheet->gtk_sheet), column, title);
-	g_string_assign (sheet->column_titles->cells[column]->value, title);
+	cell->methods->set_value (cell, title);
+}
+
+static const gchar *
+sheet_method_get_column_title (Sheet * sheet, gint column) {
+	ASSERT (sheet != NULL);
+
+	Cell * cell = sheet->column_titles->find_cell (sheet->column_titles, column);
+	return (cell == NULL) ? "" : cell->methods->get_value (cell);
 }
 
 static void
@@ -445,21 +834,253 @@ sheet_method_set_row_title (Sheet * sheet, gint row, const gchar * title) {
 	ASSERT (sheet != NULL);
 	g_return_if_fail (title != NULL);
 		
+	Cell * cell = sheet->row_titles->get_cell (sheet->row_titles, row);
+	g_return_if_fail (cell != NULL);
+	
 	gtk_sheet_row_button_add_label ( GTK_SHEET (sheet->gtk_sheet), row, title);
-	g_string_assign (sheet->row_titles->cells[row]->value, title);
+	cell->methods->set_value (cell, title);
+}
+
+static const gchar *
+sheet_method_get_row_title (Sheet * sheet, gint row) {
+	ASSERT (sheet != NULL);
+
+	/* The rows of a tail Sheet are counted from the oldest one. */
+	if (sheet->tail == TRUE) {
+		if (row < 0 || row >= sheet->tail_count)
+			return "";
+		row = (sheet->tail_head + row) % sheet->max_rows;
+	}
+
+	Cell * cell = sheet->row_titles->find_cell (sheet->row_titles, row);
+	return (cell == NULL) ? "" : cell->methods->get_value (cell);
 }
 
+/* @description: This method hands back all of the memory used by long cell
+   values in one go. Cell objects, their attributes and short (inline) values
+   are left alone; long values read back as empty strings.
+   @sheet: A pointer to the Sheet object. */
+static void
+sheet_method_reset_values (Sheet * sheet) {
+	ASSERT (sheet != NULL);
+
+	sheet->values->reset (sheet->values);
+	if (sheet->shadow)
+		sheet->shadow->reset (sheet->shadow);
+}
+
+/* @description: This method turns the Sheet's columnar shadow store on or
+   off. Turning it off throws away everything that it held. Do this before
+   anything starts writing to the Sheet from another thread.
+   @enabled: TRUE to keep a shadow copy of the values. */
+static void
+sheet_method_set_shadow (Sheet * sheet, gboolean enabled) {
+	ASSERT (sheet != NULL);
+
+	if (enabled == TRUE && sheet->shadow == NULL)
+		sheet->shadow = column_store_new (sheet->max_rows, sheet->max_columns);
+	else if (enabled == FALSE && sheet->shadow != NULL) {
+		sheet->shadow->destroy (sheet->shadow);
+		sheet->shadow = NULL;
+	}
+}
+
+/* @description: This method turns the Sheet's tail mode on or off. Do this
+   before anything has been written to the Sheet.
+   @sheet: A pointer to the Sheet object.
+   @enabled: TRUE to keep only the newest max_rows rows. */
+static void
+sheet_method_set_tail (Sheet * sheet, gboolean enabled) {
+	ASSERT (sheet != NULL);
+
+	sheet->tail = enabled;
+	sheet->tail_sequence = 0;
+	sheet->tail_count = 0;
+	sheet->tail_head = 0;
+}
+
+/* @description: This method turns the Sheet into a window over a source
+   that has far more lines than the GtkSheet has rows, e.g. a largefile. A
+   second scrollbar next to the GtkSheet spans every line of the source;
+   letting go of it calls request for the max_rows lines that start at its
+   position, which are expected to be written back over rows 0 and up. The
+   GtkSheet itself never grows past max_rows.
+   @sheet: A pointer to the Sheet object.
+   @request: The function that fills the window, or NULL to turn it off.
+   @data: Passed on to request. */
+static void
+sheet_method_set_window (Sheet * sheet, SheetWindowRequest request, gpointer data) {
+	ASSERT (sheet != NULL);
+
+	sheet->window_request = request;
+	sheet->window_data = data;
+
+	if (request != NULL && sheet->gtk_vscrollbar == NULL) {
+		gint page = sheet->max_rows;
+		GtkAdjustment * adjustment =
+			GTK_ADJUSTMENT (gtk_adjustment_new (0, 0, page, 1, page / 2, page));
+
+		sheet->window_first = 0;
+		sheet->window_lines = sheet->max_rows;
+		sheet->gtk_vscrollbar = gtk_vscrollbar_new (adjustment);
+
+		/* Dragging the slider only asks for a window once it stops moving. */
+		gtk_range_set_update_policy (GTK_RANGE (sheet->gtk_vscrollbar), GTK_UPDATE_DELAYED);
+		g_signal_connect (G_OBJECT (adjustment), "value-changed",
+								G_CALLBACK (sheet_window_changed), sheet);
+
+		gtk_box_pack_end (GTK_BOX (sheet->gtk_box), sheet->gtk_vscrollbar, FALSE, FALSE, 0);
+		gtk_widget_show (sheet->gtk_vscrollbar);
+	}
+	else if (request == NULL && sheet->gtk_vscrollbar != NULL) {
+		gtk_widget_destroy (sheet->gtk_vscrollbar);
+		sheet->gtk_vscrollbar = NULL;
+	}
+}
+
+/* @description: This method sets how many lines the source of a windowed
+   Sheet holds, e.g. as the index of a largefile grows.
+   @sheet: A pointer to the Sheet object.
+   @lines: The number of lines. */
+static void
+sheet_method_set_window_lines (Sheet * sheet, guint64 lines) {
+	ASSERT (sheet != NULL);
+	g_return_if_fail (sheet->gtk_vscrollbar != NULL);
+
+	GtkAdjustment * adjustment = gtk_range_get_adjustment (GTK_RANGE (sheet->gtk_vscrollbar));
+
+	sheet->window_lines = lines;
+	adjustment->upper = MAX (lines, (guint64)sheet->max_rows);
+	gtk_adjustment_changed (adjustment);
+}
+
+/* @description: This function is called when the scrollbar of a windowed
+   Sheet has moved. The window is kept inside of the source, the row titles
+   are renumbered to the lines that it now shows and the lines themselves
+   are requested. */
+static void
+sheet_window_changed (GtkAdjustment * adjustment, gpointer data) {
+	Sheet * sheet = (Sheet *)data;
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	guint64 line = (guint64)adjustment->value;
+	gchar title[24];
+
+	if (sheet->window_request == NULL)
+		return;
+
+	if (sheet->window_lines > (guint64)sheet->max_rows
+		 && line > sheet->window_lines - sheet->max_rows)
+		line = sheet->window_lines - sheet->max_rows;
+
+	if (line == sheet->window_first)
+		return;
+	sheet->window_first = line;
+
+	gtk_sheet_freeze (gtksheet);
+	for (gint ii = 0; ii < sheet->max_rows; ii++) {
+		g_snprintf (title, sizeof (title), "%" G_GUINT64_FORMAT, line + ii);
+		sheet->set_row_title (sheet, ii, title);
+	}
+	gtk_sheet_thaw (gtksheet);
+
+	sheet->window_request (sheet, line, sheet->max_rows, sheet->window_data);
+}
+
+/* @description: This function picks the GtkSheet row that the next row of
+   a tail Sheet goes into. The GtkSheet is used as a ring: rows are written
+   in place, and once it is full the newest row replaces the oldest one at
+   tail_head. Nothing is ever moved, so the frozen, highlighted and dirty
+   cells (which are kept by GtkSheet row) stay with their rows.
+   @sheet: A pointer to the Sheet object.
+   @reused: Set to TRUE if the row held an older row. */
+static gint
+sheet_tail_append (Sheet * sheet, gboolean * reused) {
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	gchar title[24];
+	gint row;
+
+	if (sheet->tail_count < sheet->max_rows) {
+		row = (sheet->tail_head + sheet->tail_count++) % sheet->max_rows;
+		*reused = FALSE;
+	}
+	else {
+		row = sheet->tail_head;
+		sheet->tail_head = (sheet->tail_head + 1) % sheet->max_rows;
+		*reused = TRUE;
+	}
+
+	g_snprintf (title, sizeof (title), "%" G_GUINT64_FORMAT, sheet->tail_sequence++);
+	gtk_sheet_row_button_add_label (gtksheet, row, title);
+
+	Cell * cell = sheet->row_titles->get_cell (sheet->row_titles, row);
+	if (cell != NULL)
+		cell->methods->set_value (cell, title);
+
+	return row;
+}
+
+/* @description: This method applies a row of the cell buffer to the
+   GtkSheet. In tail mode the row is a slot, and it goes into the next row
+   of the ring instead (see sheet_tail_append); what the oldest row had in
+   the columns that the new one leaves empty is cleared.
+   @sheet: A pointer to the Sheet object.
+   @row: The row (or slot) of the cell buffer. */
 static void
 sheet_method_apply_cellrow (Sheet * sheet, gint row) {
 	ASSERT (sheet != NULL);
 	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	gboolean reused = FALSE;
+	gint target = row;
+
+	if (sheet->tail == TRUE) {
+		g_return_if_fail (row >= 0 && row < sheet->max_rows);
+		target = sheet_tail_append (sheet, &reused);
+	}
 
 	for (int jj = 0; jj < sheet->max_columns; jj++) {
-		Cell * cell = sheet->cells[row][jj];
+		Cell * cell = sheet_cell_lookup (sheet, row, jj, FALSE);
 		
-		if (cell->attributes.editable == TRUE)
-			gtk_sheet_set_cell_text (gtksheet, row, jj, cell->value->str);
+		if (sheet_cell_is_editable (sheet, target, jj) == FALSE)
+			continue;
+
+		if (cell != NULL) {
+			gtk_sheet_set_cell_text (gtksheet, target, jj, cell->methods->get_value (cell));
+			sheet->dirty->mark (sheet->dirty, target, jj);
+		}
+		else if (reused == TRUE
+					&& target <= gtksheet->maxallocrow && jj <= gtksheet->maxalloccol
+					&& !IS_NULL (gtksheet->data[target][jj])) {
+			gtk_sheet_cell_clear (gtksheet, target, jj);
+			sheet->dirty->mark (sheet->dirty, target, jj);
+		}
+	}
+}
+
+/* @description: This method applies count rows of the cell buffer, starting
+   at row, to the GtkSheet with a single redraw. In tail mode the rows are
+   slots, and they wrap back around to slot 0.
+   @sheet: A pointer to the Sheet object.
+   @row: The first row (or slot) of the cell buffer.
+   @count: The number of rows. */
+static void
+sheet_method_apply_cellrows (Sheet * sheet, gint row, gint count) {
+	ASSERT (sheet != NULL);
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+
+	gtk_sheet_freeze (gtksheet);
+
+	/* apply_row marks the dirty cells itself. */
+	g_signal_handlers_block_by_func (G_OBJECT (gtksheet), G_CALLBACK (sheet_changed), sheet);
+	for (gint ii = 0; ii < count; ii++) {
+		gint slot = row + ii;
+
+		if (sheet->tail == TRUE)
+			slot %= sheet->max_rows;
+		sheet_method_apply_cellrow (sheet, slot);
 	}
+	g_signal_handlers_unblock_by_func (G_OBJECT (gtksheet), G_CALLBACK (sheet_changed), sheet);
+
+	gtk_sheet_thaw (gtksheet);
 }
 
 static void
@@ -480,9 +1101,9 @@ sheet_method_get_cellrow (Sheet * sheet,
 		const char * label = gtk_sheet_cell_get_text (gtksheet, row, ii);
 
 		if (label == NULL)
-			p->set (p, row, ii, "");
+			p->methods->set (p, row, ii, "");
 		else
-			p->set (p, row, ii, label);
+			p->methods->set (p, row, ii, label);
 	}
 }
 
@@ -500,29 +1121,111 @@ sheet_method_apply_cellarray (Sheet * sheet,
 		directly into the GtkSheet structures to get a little more performance
 		boost (mainly because we should not have to check all the bounds each
 		time we want to update). */
+	/* Runs of cells that share a color are colored with one call. */
+	GtkSheetRange * bg_ranges = g_new (GtkSheetRange, size);
+	GtkSheetRange * fg_ranges = g_new (GtkSheetRange, size);
+	const gchar * bg = NULL, * fg = NULL;
+	gint bg_count = 0, fg_count = 0;
+
 	for (gint ii = 0; ii < size; ii++) {
 		Cell * cell = array[ii];
 
-		if (sheet->cells[cell->row][cell->column]->attributes.editable == FALSE)
+		if (sheet_cell_is_editable (sheet, cell->row, cell->column) == FALSE)
 			continue;
 		
 		gtk_sheet_set_cell_text (gtksheet,
 										 cell->row,
 										 cell->column,
-										 cell->value->str);
+										 cell->methods->get_value (cell));
+		sheet->dirty->mark (sheet->dirty, cell->row, cell->column);
 
-		if (!IS_NULLSTR (cell->attributes.bgcolor->str))
-			sheet->range_set_background (sheet, 
-												  &cell->range, 
-												  cell->attributes.bgcolor->str);
+		if (cell->attributes.bgcolor != PALETTE_NONE) {
+			const gchar * color = cell->methods->get_bgcolor (cell);
 
-		if (!IS_NULLSTR (cell->attributes.fgcolor->str))
-			sheet->range_set_foreground (sheet, 
-												  &cell->range, 
-												  cell->attributes.fgcolor->str);
+			if (bg_count > 0 && strcmp (bg, color) != 0) {
+				sheet->ranges_set_background (sheet, bg_ranges, bg_count, bg);
+				bg_count = 0;
+			}
+			bg = color;
+			bg_ranges[bg_count++] = cell->range;
+		}
+
+		if (cell->attributes.fgcolor != PALETTE_NONE) {
+			const gchar * color = cell->methods->get_fgcolor (cell);
 
-		cell->value->str[0] = cell->attributes.bgcolor->str[0] = cell->attributes.fgcolor->str[0] = 0;
+			if (fg_count > 0 && strcmp (fg, color) != 0) {
+				sheet->ranges_set_foreground (sheet, fg_ranges, fg_count, fg);
+				fg_count = 0;
+			}
+			fg = color;
+			fg_ranges[fg_count++] = cell->range;
+		}
+
+		cell->methods->set_value (cell, "");
+		cell->attributes.bgcolor = cell->attributes.fgcolor = PALETTE_NONE;
 	}
+
+	if (bg_count > 0)
+		sheet->ranges_set_background (sheet, bg_ranges, bg_count, bg);
+	if (fg_count > 0)
+		sheet->ranges_set_foreground (sheet, fg_ranges, fg_count, fg);
+
+	g_free (bg_ranges);
+	g_free (fg_ranges);
+}
+
+/* @description: This method installs a whole block of parsed rows into the
+   GtkSheet at once, e.g. the window of lines that a largefile jump has just
+   read. The block is clipped against the GtkSheet once rather than per cell,
+   and it is written with the GtkSheet frozen and without a "changed" signal
+   for each cell, so there is a single redraw and a single dirty range.
+   @sheet: A pointer to the Sheet object.
+   @row: The row of the GtkSheet where the block starts.
+   @rows: The number of rows inside of the block.
+   @columns: The number of columns inside of the block.
+   @offsets: rows * columns offsets (row-major) into bytes, each of them the
+   start of a cell's NUL terminated value.
+   @bytes: The values. */
+static void
+sheet_method_apply_block (Sheet * sheet,
+								  gint row,
+								  gint rows,
+								  gint columns,
+								  const gsize * offsets,
+								  const gchar * bytes)
+{
+	ASSERT (sheet != NULL);
+	g_return_if_fail (offsets != NULL);
+	g_return_if_fail (bytes != NULL);
+
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	gint height = MIN (rows, gtksheet->maxrow + 1 - row);
+	gint width = MIN (columns, gtksheet->maxcol + 1);
+
+	if (row < 0 || height <= 0 || width <= 0)
+		return;
+
+	gtk_sheet_freeze (gtksheet);
+	g_signal_handlers_block_by_func (G_OBJECT (gtksheet), G_CALLBACK (sheet_changed), sheet);
+
+	for (gint ii = 0; ii < height; ii++) {
+		const gsize * offset = offsets + ii * columns;
+
+		for (gint jj = 0; jj < width; jj++) {
+			const gchar * value = bytes + offset[jj];
+
+			if (sheet_cell_is_editable (sheet, row + ii, jj) == FALSE)
+				continue;
+
+			gtk_sheet_set_cell_text (gtksheet, row + ii, jj, value);
+			if (sheet->shadow)
+				sheet->shadow->set (sheet->shadow, row + ii, jj, value, strlen (value));
+		}
+	}
+
+	g_signal_handlers_unblock_by_func (G_OBJECT (gtksheet), G_CALLBACK (sheet_changed), sheet);
+	sheet->dirty->mark_range (sheet->dirty, row, 0, row + height - 1, width - 1);
+	gtk_sheet_thaw (gtksheet);
 }
 
 /* @description: This method applies the settings from a Cell object into the
@@ -535,7 +1238,7 @@ sheet_method_apply_cell (Sheet * sheet, const Cell * cell)
 {
 	ASSERT (sheet != NULL);
 	g_return_if_fail (cell != NULL);
-	g_return_if_fail (sheet->cells[cell->row][cell->column]->attributes.editable == TRUE);
+	g_return_if_fail (sheet_cell_is_editable (sheet, cell->row, cell->column) == TRUE);
 		
 	if (sheet->has_focus == FALSE)
 		sheet->notices++;
@@ -543,23 +1246,63 @@ sheet_method_apply_cell (Sheet * sheet, const Cell * cell)
 	gtk_sheet_set_cell (GTK_SHEET (sheet->gtk_sheet),
 							  cell->row,
 							  cell->column,
-							  cell->attributes.justification,
-							  cell->value->str);
+							  (GtkJustification)cell->attributes.justification,
+							  cell->methods->get_value (cell));
+	sheet->dirty->mark (sheet->dirty, cell->row, cell->column);
 
-	if (!IS_NULLSTR (cell->attributes.bgcolor->str))
+	if (cell->attributes.bgcolor != PALETTE_NONE)
 		sheet->range_set_background (sheet, 
 											  &cell->range, 
-											  cell->attributes.bgcolor->str);
+											  cell->methods->get_bgcolor (cell));
 
-	if (!IS_NULLSTR (cell->attributes.fgcolor->str))
+	if (cell->attributes.fgcolor != PALETTE_NONE)
 		sheet->range_set_foreground (sheet, 
 											  &cell->range, 
-											  cell->attributes.fgcolor->str);
+											  cell->methods->get_fgcolor (cell));
 
 	/* Clear all of the strings */
-	/*g_string_assign (cell->value, "");
-	g_string_assign (cell->attributes.bgcolor, "");
-	g_string_assign (cell->attributes.fgcolor, "");*/
+	/*cell->methods->set_value (cell, "");
+	cell->attributes.bgcolor = cell->attributes.fgcolor = PALETTE_NONE;*/
+}
+
+/* @description: This function looks a color up in the Workbook's Palette,
+   which parses and allocates it only the first time it is used.
+   @sheet: A pointer to the Sheet object that contains GtkSheet.
+   @desc: The string representation of the color.
+   @color: Set to the allocated color. */
+static gboolean
+sheet_lookup_color (Sheet * sheet, const gchar * desc, GdkColor * color)
+{
+	Palette * palette = sheet->workbook->palette;
+	guint16 index = palette->intern (palette, desc);
+
+	return palette->get_color (palette,
+										index,
+										gtk_widget_get_colormap (sheet->gtk_sheet),
+										color);
+}
+
+/* @description: This function marks the cells of a range whose colors
+   have changed. Only cells with text are saved, so the rest of the range
+   (typically most of a selection) is left out of the DirtySet; otherwise
+   the delta would hold a clear for every one of them.
+   @sheet: A pointer to the Sheet object.
+   @range: The range that was recolored. */
+static void
+sheet_mark_styled (Sheet * sheet, const GtkSheetRange * range)
+{
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	gint rowi = MIN (range->rowi, gtksheet->maxallocrow);
+	gint coli = MIN (range->coli, gtksheet->maxalloccol);
+
+	for (gint ii = MAX (range->row0, 0); ii <= rowi; ii++) {
+		for (gint jj = MAX (range->col0, 0); jj <= coli; jj++) {
+			GtkSheetCell * cell = gtksheet->data[ii][jj];
+
+			if (!IS_NULL (cell) && !IS_NULLSTR (cell->text))
+				sheet->dirty->mark (sheet->dirty, ii, jj);
+		}
+	}
 }
 
 /* @description: This method changes the background of a range of cells. 
@@ -574,18 +1317,37 @@ sheet_method_range_set_background (Sheet * sheet,
 											  const gchar * desc)
 {
 	ASSERT (sheet != NULL); ASSERT (range != NULL);
+
+	sheet->ranges_set_background (sheet, range, 1, desc);
+}
+
+/* @description: This method changes the background of a batch of ranges
+   that all share the same color; the color is only looked up once.
+   @sheet: A pointer to the Sheet object that contains GtkSheet.
+   @ranges: An array of GtkSheetRange objects.
+   @count: The number of ranges in the array.
+   @desc: A string that contains the color's string value. */
+static void
+sheet_method_ranges_set_background (Sheet * sheet,
+												const GtkSheetRange * ranges,
+												gint count,
+												const gchar * desc)
+{
+	ASSERT (sheet != NULL); ASSERT (ranges != NULL);
+	Palette * palette = sheet->workbook->palette;
 	GdkColor color;
 	GdkColor black;
 
-	/* The color needs to be taken from the colormap; there is an alternative
-		way to do this if we use #rgb or #rrggbb formats. */
-	gdk_color_parse (desc, &color);
-	gdk_color_parse ("black", &black);
-	gdk_color_alloc (gtk_widget_get_colormap (sheet->gtk_sheet), &color);
-	gdk_color_alloc (gtk_widget_get_colormap (sheet->gtk_sheet), &black);
-  
-	gtk_sheet_range_set_background (GTK_SHEET (sheet->gtk_sheet), range, &color);
-	gtk_sheet_range_set_border_color (GTK_SHEET (sheet->gtk_sheet), range, &black);
+	if (sheet_lookup_color (sheet, desc, &color) == FALSE)
+		return;
+	palette->get_color (palette, palette->black,
+							  gtk_widget_get_colormap (sheet->gtk_sheet), &black);
+
+	for (gint ii = 0; ii < count; ii++) {
+		gtk_sheet_range_set_background (GTK_SHEET (sheet->gtk_sheet), &ranges[ii], &color);
+		gtk_sheet_range_set_border_color (GTK_SHEET (sheet->gtk_sheet), &ranges[ii], &black);
+		sheet_mark_styled (sheet, &ranges[ii]);
+	}
 }
 
 /* @description: This method changes the foreground color over a range of
@@ -600,16 +1362,32 @@ sheet_method_range_set_foreground (Sheet * sheet,
 											  const gchar * desc)
 {
 	ASSERT (sheet != NULL); ASSERT (range != NULL);
+
+	sheet->ranges_set_foreground (sheet, range, 1, desc);
+}
+
+/* @description: This method changes the foreground color of a batch of
+   ranges that all share the same color.
+   @sheet: A pointer to the Sheet object that contains GtkSheet.
+   @ranges: An array of GtkSheetRange objects.
+   @count: The number of ranges in the array.
+   @desc: The string representation of the color. */
+static void
+sheet_method_ranges_set_foreground (Sheet * sheet,
+												const GtkSheetRange * ranges,
+												gint count,
+												const gchar * desc)
+{
+	ASSERT (sheet != NULL); ASSERT (ranges != NULL);
 	GdkColor color;
-  
-   /* The color needs to be taken from the colormap; there is an alternative
-		way to do this if we use #rgb or #rrggbb formats. */
-	gdk_color_parse (desc, &color);
-	gdk_color_alloc (gtk_widget_get_colormap (sheet->gtk_sheet),
-						  &color);
-      
-	gtk_sheet_range_set_foreground (GTK_SHEET (sheet->gtk_sheet),
-											  range, &color);
+
+	if (sheet_lookup_color (sheet, desc, &color) == FALSE)
+		return;
+
+	for (gint ii = 0; ii < count; ii++) {
+		gtk_sheet_range_set_foreground (GTK_SHEET (sheet->gtk_sheet), &ranges[ii], &color);
+		sheet_mark_styled (sheet, &ranges[ii]);
+	}
 }
 
 static void
@@ -619,9 +1397,12 @@ sheet_method_set_cell_value_length (Sheet * sheet,
 												void * value,
 												size_t length) {
 	ASSERT (sheet != NULL);
-	if (row < 0 || column < 0 || row > sheet->max_rows || column > sheet->max_columns) return;
-	Cell * cell = sheet->cells[row][column];
-	cell->set_value_length (cell, value, length);
+	Cell * cell = sheet_cell_lookup (sheet, row, column, TRUE);
+	if (cell == NULL) return;
+	cell->methods->set_value_length (cell, value, length);
+
+	if (sheet->shadow)
+		sheet->shadow->set (sheet->shadow, row, column, (const gchar *)value, length);
 }
 
 /* @description: This method manually sets a GtkSheet cell's value. It does
@@ -637,16 +1418,17 @@ sheet_method_set_cell (Sheet * sheet,
 							  const gchar * value)
 {
 	ASSERT (sheet != NULL);
-	if (sheet->cells[row][column]->attributes.editable == FALSE) return;
+	if (sheet_cell_is_editable (sheet, row, column) == FALSE) return;
 	
 	if (sheet->has_focus == FALSE)
 		sheet->notices++;
 
 	gtk_sheet_set_cell (GTK_SHEET (sheet->gtk_sheet), 
-							  sheet->cells[row][column]->row, 
-							  sheet->cells[row][column]->column, 
+							  row, 
+							  column, 
 							  GTK_JUSTIFY_LEFT, 
 							  value);
+	sheet->dirty->mark (sheet->dirty, row, column);
 }
 
 static void
@@ -655,7 +1437,7 @@ sheet_method_set_cell_background (Sheet * sheet,
 											 gint column,
 											 const gchar * color) {
 	ASSERT (sheet != NULL);
-	g_return_if_fail (sheet->cells[row][column]->attributes.editable == TRUE);
+	g_return_if_fail (sheet_cell_is_editable (sheet, row, column) == TRUE);
 
 	GtkSheetRange range = {row,column,row,column};
 	sheet->range_set_background (sheet, &range, color);
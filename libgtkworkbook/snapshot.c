@@ -0,0 +1,151 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <libgtkworkbook/snapshot.h>
+#include <string.h>
+
+/* snapshot.c (static) */
+static Snapshot * snapshot_object_init (gint, gint, gboolean);
+static void snapshot_object_free (Snapshot *);
+static void snapshot_method_destroy (Snapshot *);
+static void snapshot_method_add (Snapshot *, const GeometryCell *);
+static gboolean snapshot_method_write (Snapshot *, const gchar *, guint64 *);
+static gboolean snapshot_method_read (Snapshot *, const gchar *);
+static void snapshot_read_visitor (const GeometryCell *, gpointer);
+
+/* @description: This function returns a pointer to a new, empty Snapshot.
+   @max_row: The highest row index of the Sheet.
+   @max_column: The highest column index of the Sheet.
+   @delta: TRUE if the snapshot only holds the cells that have changed. */
+Snapshot *
+snapshot_new (gint max_row, gint max_column, gboolean delta)
+{
+	Snapshot * snapshot = snapshot_object_init (max_row, max_column, delta);
+	return snapshot;
+}
+
+/* @description: This function is the Snapshot object's constructor. */
+static Snapshot *
+snapshot_object_init (gint max_row, gint max_column, gboolean delta)
+{
+	Snapshot * obj = NEW (Snapshot);
+
+	obj->cells = g_array_new (FALSE, FALSE, sizeof (GeometryCell));
+	obj->values = arena_new (ARENA_SLAB_SIZE);
+	obj->max_row = max_row;
+	obj->max_column = max_column;
+	obj->delta = delta;
+
+	/* Methods */
+	obj->destroy = snapshot_method_destroy;
+	obj->add = snapshot_method_add;
+	obj->write = snapshot_method_write;
+	obj->read = snapshot_method_read;
+
+	return obj;
+}
+
+/* @description: This function frees the Snapshot and every text in it.
+   @snapshot: A pointer to the object to free. */
+static void
+snapshot_object_free (Snapshot * snapshot)
+{
+	ASSERT (snapshot != NULL);
+
+	g_array_free (snapshot->cells, TRUE);
+	snapshot->values->destroy (snapshot->values);
+	FREE (snapshot);
+}
+
+static void
+snapshot_method_destroy (Snapshot * snapshot)
+{
+	g_return_if_fail (snapshot != NULL);
+
+	snapshot_object_free (snapshot);
+}
+
+/* @description: This method copies a cell into the Snapshot.
+   @snapshot: A pointer to the Snapshot object.
+   @cell: The cell to copy; its text is copied too. */
+static void
+snapshot_method_add (Snapshot * snapshot, const GeometryCell * cell)
+{
+	ASSERT (snapshot != NULL);
+	g_return_if_fail (cell != NULL);
+
+	GeometryCell copy = *cell;
+	gsize length = (cell->text == NULL) ? 0 : strlen (cell->text);
+	guint generation = 0;
+
+	if (length == 0)
+		copy.text = "";
+	else {
+		gchar * text = snapshot->values->alloc (snapshot->values, length + 1, &generation);
+		memcpy (text, cell->text, length + 1);
+		copy.text = text;
+	}
+	g_array_append_val (snapshot->cells, copy);
+}
+
+/* @description: This method writes the Snapshot out. A full snapshot
+   replaces the file; a delta snapshot is appended to the file's journal.
+   @snapshot: A pointer to the Snapshot object.
+   @filepath: The file to write.
+   @journal_size: The size of the journal (see geometry_journal_append);
+   only used by a delta snapshot. */
+static gboolean
+snapshot_method_write (Snapshot * snapshot, const gchar * filepath, guint64 * journal_size)
+{
+	ASSERT (snapshot != NULL);
+
+	if (snapshot->delta == TRUE)
+		return geometry_journal_append (filepath,
+												  journal_size,
+												  (const GeometryCell *)snapshot->cells->data,
+												  snapshot->cells->len);
+
+	return geometry_file_write (filepath,
+										 snapshot->max_row,
+										 snapshot->max_column,
+										 (const GeometryCell *)snapshot->cells->data,
+										 snapshot->cells->len);
+}
+
+static void
+snapshot_read_visitor (const GeometryCell * cell, gpointer data)
+{
+	Snapshot * snapshot = (Snapshot *)data;
+	snapshot->add (snapshot, cell);
+}
+
+/* @description: This method reads a geometry file, and its journal, into the
+   Snapshot. Cells from the journal come after the ones they replace.
+   @snapshot: A pointer to the Snapshot object.
+   @filepath: The file to read. */
+static gboolean
+snapshot_method_read (Snapshot * snapshot, const gchar * filepath)
+{
+	ASSERT (snapshot != NULL);
+
+	return geometry_file_read (filepath,
+										&snapshot->max_row,
+										&snapshot->max_column,
+										snapshot_read_visitor,
+										snapshot);
+}
@@ -28,6 +28,7 @@ static Sheet *workbook_method_addnewsheet (Workbook *,
 														 const gchar *, 
 														 gint, gint);
 static Sheet *workbook_method_get_sheet (Workbook *, const gchar *);
+static Sheet *workbook_method_get_sheet_by_widget (Workbook *, GtkWidget *);
 static void workbook_method_remove_sheet (Workbook *, Sheet *);
 static gboolean workbook_method_move_sheet_index (Workbook *, Sheet *, gint);
 static gboolean workbook_method_move_sheet (Workbook *, 
@@ -82,6 +83,12 @@ workbook_method_addnewsheet (Workbook * book,
 
 	LINK_OBJECT (book->sheet_first, book->sheet_last, sheet);
 
+	g_mutex_lock (book->sheets_lock);
+	g_hash_table_insert (book->sheets_by_name, sheet->name, sheet);
+	g_hash_table_insert (book->sheets_by_widget, sheet->gtk_box, sheet);
+	book->generation++;
+	g_mutex_unlock (book->sheets_lock);
+
 	if (IS_NULL (book->focus_sheet)) {
 		sheet->has_focus = TRUE;
 		book->focus_sheet = sheet;
@@ -90,8 +97,8 @@ workbook_method_addnewsheet (Workbook * book,
 	return sheet;
 }
 
-/* @description: This method performs a search of all the Workbooks and
-   returns a pointer to the Sheet object if it matches the provided label.
+/* @description: This method returns a pointer to the Sheet object of the
+   Workbook that matches the provided label.
    @wb: Pointer to the workbook we're searching.
    @sheet: String label of the sheet we are searching for. */
 static Sheet *
@@ -99,18 +106,33 @@ workbook_method_get_sheet (Workbook * wb, const gchar * sheet)
 {
 	ASSERT (wb != NULL);
 
-	if (!IS_NULLSTR (sheet))
-	{
-      ITERATE_BEGIN (Sheet, wb->sheet_first);
-      {
-			if (!sheet) return NULL;
-			if (!strcmp (sheet, it->name))
-				return it;
-      }
-      ITERATE_END ();
-	}
+	if (IS_NULLSTR (sheet))
+		return NULL;
 
-	return NULL;
+	g_mutex_lock (wb->sheets_lock);
+	Sheet * result = (Sheet *)g_hash_table_lookup (wb->sheets_by_name, sheet);
+	g_mutex_unlock (wb->sheets_lock);
+
+	return result;
+}
+
+/* @description: This method returns a pointer to the Sheet object whose
+   page in the GtkNotebook is the provided widget.
+   @wb: Pointer to the workbook we're searching.
+   @widget: The notebook page (sheet->gtk_box). */
+static Sheet *
+workbook_method_get_sheet_by_widget (Workbook * wb, GtkWidget * widget)
+{
+	ASSERT (wb != NULL);
+
+	if (IS_NULL (widget))
+		return NULL;
+
+	g_mutex_lock (wb->sheets_lock);
+	Sheet * result = (Sheet *)g_hash_table_lookup (wb->sheets_by_widget, widget);
+	g_mutex_unlock (wb->sheets_lock);
+
+	return result;
 }
 
 /* @description: This method removes a Sheet object from the Workbook. It also
@@ -129,24 +151,26 @@ workbook_method_remove_sheet (Workbook * wb, Sheet * sheet)
       return;
 	}
   
-	ITERATE_BEGIN (Sheet, wb->sheet_first);
-	{
+	if (wb->get_sheet_by_widget (wb, sheet->gtk_box) == sheet) {
+		if (wb->focus_sheet == sheet) {
+			wb->focus_sheet = sheet->prev;
+		}
+
+		DOUBLE_UNLINK (wb->sheet_first, wb->sheet_last, sheet);
+
+		g_mutex_lock (wb->sheets_lock);
+		g_hash_table_remove (wb->sheets_by_name, sheet->name);
+		g_hash_table_remove (wb->sheets_by_widget, sheet->gtk_box);
+		wb->generation++;
+		g_mutex_unlock (wb->sheets_lock);
+
 		/* Remove the sheet from the GtkNotebook */
-		if (it == sheet) {
-			if (wb->focus_sheet == sheet) {
-				wb->focus_sheet = sheet->prev;
-			}
-
-			DOUBLE_UNLINK (wb->sheet_first, wb->sheet_last, sheet);
-			
-			gint page = gtk_notebook_page_num (GTK_NOTEBOOK (wb->gtk_notebook),
-														  sheet->gtk_box);
-			gtk_notebook_remove_page (GTK_NOTEBOOK (wb->gtk_notebook), page); 
-			gtk_widget_queue_draw (wb->gtk_notebook);
-			return;
-      }
+		gint page = gtk_notebook_page_num (GTK_NOTEBOOK (wb->gtk_notebook),
+													  sheet->gtk_box);
+		gtk_notebook_remove_page (GTK_NOTEBOOK (wb->gtk_notebook), page); 
+		gtk_widget_queue_draw (wb->gtk_notebook);
+		return;
 	}
-	ITERATE_END ();
 
 	g_warning ("Sheet '%s' was not found inside of workbook '%s'", 
 				  sheet->name, wb->filename);
@@ -235,11 +259,18 @@ workbook_object_init (GtkWidget * window, const gchar * filename)
 	book->focus_sheet = NULL;
 	book->gtk_window = window;
 	book->filename = g_strdup (filename);
+	book->palette = palette_new ();
+	book->scheduler = scheduler_new (SCHEDULER_FRAME_BUDGET);
+	book->sheets_by_name = g_hash_table_new (g_str_hash, g_str_equal);
+	book->sheets_by_widget = g_hash_table_new (g_direct_hash, g_direct_equal);
+	book->sheets_lock = g_mutex_new ();
+	book->generation = 0;
     
 	/* Methods */
 	book->destroy = workbook_method_destroy;
 	book->add_new_sheet = workbook_method_addnewsheet;
 	book->get_sheet = workbook_method_get_sheet;
+	book->get_sheet_by_widget = workbook_method_get_sheet_by_widget;
 	book->remove_sheet = workbook_method_remove_sheet;
 	book->move_sheet_index = workbook_method_move_sheet_index;
 	book->move_sheet = workbook_method_move_sheet;
@@ -284,6 +315,11 @@ workbook_object_free (Workbook * book) {
 	book->sheet_first = book->sheet_last = NULL;
 
 	FREE (book->filename);
+	book->palette->destroy (book->palette);
+	book->scheduler->destroy (book->scheduler);
+	g_hash_table_destroy (book->sheets_by_name);
+	g_hash_table_destroy (book->sheets_by_widget);
+	g_mutex_free (book->sheets_lock);
 	FREE (book);
 	return book;
 }
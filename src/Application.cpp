@@ -127,24 +127,20 @@ GtkNotebookSwitchPageCallback (GtkNotebook * notebook, GtkNotebookPage * page, g
 	}
 
 	GtkWidget * widget = gtk_notebook_get_nth_page (notebook, page_num);
+	Sheet * sheet = book->get_sheet_by_widget (book, widget);
 
-	ITERATE_BEGIN (Sheet, book->sheet_first);
+	// Once we find the right Sheet object we can perform what we need
+	//	to in order to change the "focus." Finally, set book pointer.
+	if (!IS_NULL (sheet))
 	{
-		// Once we find the right Sheet object we can perform what we need
-		//	to in order to change the "focus." Finally, set book pointer.
-		if (it->gtk_box == widget)
-      {
-			it->page = page_num;
-			it->has_focus = TRUE;
-			it->notices = 0;
+		sheet->page = page_num;
+		sheet->has_focus = TRUE;
+		sheet->notices = 0;
 	
-			// Reset the label on the notebook tab to the object's name.
-			gtk_notebook_set_tab_label_text (notebook, it->gtk_box, it->name);
-			book->focus_sheet = it;
-			break;
-      }
+		// Reset the label on the notebook tab to the object's name.
+		gtk_notebook_set_tab_label_text (notebook, sheet->gtk_box, sheet->name);
+		book->focus_sheet = sheet;
 	}
-	ITERATE_END ();
 	return TRUE;
 }
 
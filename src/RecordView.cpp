@@ -79,23 +79,23 @@ RecordView::AddSheetRecord (Sheet * sheet) {
 		// row titles have been explicitly set somewhere inside of the plugin.
 		record_sheet->set_column_title (record_sheet,
 												  row,
-												  sheet->row_titles->cells[range.row0]->value->str);
+												  sheet->get_row_title (sheet, range.row0));
 		
 		for (int ii = 0; ii < tuple->size; ii++) {
 			// We only need to change the row titles once. This can happen on our last iteration.
 			if (range.row0 == range.rowi) {
 				record_sheet->set_row_title (record_sheet,
 													  ii,
-													  sheet->column_titles->cells[ii]->value->str);
+													  sheet->get_column_title (sheet, ii));
 
 			}
 			
 			record_sheet->set_cell (record_sheet,
 											ii,
 											column,
-											tuple->cells[ii]->value->str);
+											tuple->cells[ii]->methods->get_value (tuple->cells[ii]));
 
-			if (sheet->cells[range.row0][ii]->attributes.highlighted == TRUE) {
+			if (sheet->is_highlighted (sheet, range.row0, ii) == TRUE) {
 				record_sheet->set_cell_background (record_sheet, ii, column, "#ffffcc");
 			}
 			else if (((ii + 1) % 2) == 0) {
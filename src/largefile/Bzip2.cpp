@@ -0,0 +1,831 @@
+/*
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include "Bzip2.hpp"
+#include "Newline.hpp"
+#include <sys/time.h>
+#include <unistd.h>
+#include <proactor/Proactor.hpp>
+
+using namespace largefile;
+
+/* For each value of a byte, the shifts at which it is the second byte of the block magic
+	number (the low eight bits) or of the end of stream one (the high eight bits); a shift
+	is how far into the byte before it the magic number starts. */
+struct Bzip2Magic {
+	uint16_t second[256];
+
+	Bzip2Magic (void) {
+		memset (this->second, 0, sizeof (this->second));
+		for (int shift = 0; shift < 8; shift++) {
+			this->second[(BZIP2_BLOCK_MAGIC >> (32 + shift)) & 0xff] |= (1 << shift);
+			this->second[(BZIP2_EOS_MAGIC >> (32 + shift)) & 0xff] |= (0x100 << shift);
+		}
+	}
+};
+
+static const Bzip2Magic bzip2_magic;
+
+/* The 48 bits of a bzip2 stream from bit at on, which go from the high bit of each byte
+	to its low one. */
+static uint64_t
+bzip2_bits48 (const unsigned char * p, int at) {
+	uint64_t value = 0;
+
+	for (int ii = 0; ii < 7; ii++)
+		value = (value << 8) | p[ii];
+	return (value >> (8 - at)) & 0xffffffffffffULL;
+}
+
+/* Finds the first magic number (of a block, or of the end of a stream) that starts at or
+	after bit from. Only the bytes whose value could be the second one of either number
+	are looked at any closer. Input has room for BZIP2_CHUNK bytes and eight more. */
+static off64_t
+bzip2_marker (FILE * fp, off64_t from, unsigned char * input, bool * eos) {
+	off64_t byte = from >> 3;
+
+	while (0 == fseeko64 (fp, byte, SEEK_SET)) {
+		size_t length = fread (input, 1, BZIP2_CHUNK, fp);
+		bool last = (length < BZIP2_CHUNK);
+
+		// Every magic number is followed by at least 32 bits (a CRC), so the padding is
+		// never part of one that is found.
+		memset (input + length, 0, 8);
+
+		for (size_t k = 0; k < (last ? length : length - 6); k++) {
+			uint16_t shifts = bzip2_magic.second[input[k + 1]];
+
+			if (0 == shifts)
+				continue;
+
+			for (int shift = 0; shift < 8; shift++) {
+				if (0 == (shifts & (0x101 << shift)) || ((byte + (off64_t)k) << 3) + shift < from)
+					continue;
+
+				uint64_t value = bzip2_bits48 (input + k, shift);
+				if (BZIP2_BLOCK_MAGIC == value || BZIP2_EOS_MAGIC == value) {
+					*eos = (BZIP2_EOS_MAGIC == value);
+					return ((byte + (off64_t)k) << 3) + shift;
+				}
+			}
+		}
+
+		if (true == last)
+			break;
+		byte += length - 6;
+	}
+
+	return -1;
+}
+
+/* The first block of the stream whose header is at byte, or -1 if there is none; a stream
+	may be empty, in which case the one after it is tried. */
+static off64_t
+bzip2_stream (FILE * fp, off64_t byte) {
+	unsigned char header[4 + 8];
+
+	while (0 == fseeko64 (fp, byte, SEEK_SET)) {
+		memset (header, 0, sizeof (header));
+
+		if (4 + 6 > fread (header, 1, sizeof (header), fp)
+			 || 'B' != header[0] || 'Z' != header[1] || 'h' != header[2]
+			 || header[3] < '1' || header[3] > '9')
+			break;
+
+		uint64_t value = bzip2_bits48 (header + 4, 0);
+		if (BZIP2_BLOCK_MAGIC == value)
+			return (byte + 4) << 3;
+		if (BZIP2_EOS_MAGIC != value)
+			break;
+
+		// The magic number and the CRC of the stream, which is padded out to a byte.
+		byte += 4 + 10;
+	}
+
+	return -1;
+}
+
+/* The block that comes after the one that ended at bit end: the next block of the same
+	stream, or the first block of the stream after it. */
+static off64_t
+bzip2_follow (FILE * fp, off64_t end) {
+	unsigned char bits[8];
+
+	memset (bits, 0, sizeof (bits));
+	if (0 != fseeko64 (fp, end >> 3, SEEK_SET) || 7 != fread (bits, 1, 7, fp))
+		return -1;
+
+	uint64_t value = bzip2_bits48 (bits, end & 7);
+	if (BZIP2_BLOCK_MAGIC == value)
+		return end;
+	if (BZIP2_EOS_MAGIC == value)
+		return bzip2_stream (fp, (end + 48 + 32 + 7) >> 3);
+	return -1;
+}
+
+/* Appends bits (at most 32 of them) to a stream that is being put together, high bit first;
+	acc holds the n bits that do not make up a byte yet. */
+static void
+bzip2_put (std::string & stream, uint64_t & acc, int & n, uint32_t value, int bits) {
+	acc = (acc << bits) | (value & (0xffffffffULL >> (32 - bits)));
+	for (n += bits; n >= 8; n -= 8)
+		stream.push_back ((char)(acc >> (n - 8)));
+	acc &= (1ULL << n) - 1;
+}
+
+/* Decompresses the block in between the start and end bits into out. It is made into a
+	stream of its own (the way bzip2recover does it), whose CRC is that of its one block;
+	the block size in the header is the largest there is, which fits any block. */
+static bool
+bzip2_block (FILE * fp, off64_t start, off64_t end, std::string & out) {
+	off64_t bits = end - start;
+	int shift = start & 7;
+
+	if (bits < 48 + 32 || 0 != fseeko64 (fp, start >> 3, SEEK_SET))
+		return false;
+
+	size_t length = ((end + 7) >> 3) - (start >> 3);
+	std::string raw (length + 1, '\0');
+
+	if (length != fread (&raw[0], 1, length, fp))
+		return false;
+
+	const unsigned char * p = (const unsigned char *)raw.data();
+	std::string stream ("BZh9");
+	uint64_t acc = 0;
+	int n = 0;
+
+	stream.reserve (4 + length + 12);
+	for (off64_t ii = 0; ii < (bits >> 3); ii++)
+		stream.push_back ((char)((p[ii] << shift) | (p[ii + 1] >> (8 - shift))));
+	if (bits & 7)
+		bzip2_put (stream, acc, n, ((p[bits >> 3] << shift) | (p[(bits >> 3) + 1] >> (8 - shift))) >> (8 - (bits & 7)), bits & 7);
+
+	// The block CRC comes right after its magic number.
+	const unsigned char * q = (const unsigned char *)stream.data() + 4 + 6;
+	uint32_t crc = (q[0] << 24) | (q[1] << 16) | (q[2] << 8) | q[3];
+
+	bzip2_put (stream, acc, n, (uint32_t)(BZIP2_EOS_MAGIC >> 24), 24);
+	bzip2_put (stream, acc, n, (uint32_t)(BZIP2_EOS_MAGIC & 0xffffff), 24);
+	bzip2_put (stream, acc, n, crc, 32);
+	if (n > 0)
+		bzip2_put (stream, acc, n, 0, 8 - n);
+
+	bz_stream bzstrm;
+	int ret;
+
+	memset (&bzstrm, 0, sizeof (bzstrm));
+	if (BZ_OK != BZ2_bzDecompressInit (&bzstrm, 0, 0))
+		return false;
+
+	bzstrm.next_in = (char *)stream.data();
+	bzstrm.avail_in = stream.length();
+
+	out.resize (1 << 20);
+	size_t have = 0;
+
+	do {
+		if (have == out.length())
+			out.resize (out.length() << 1);
+
+		bzstrm.next_out = &out[have];
+		bzstrm.avail_out = out.length() - have;
+
+		ret = BZ2_bzDecompress (&bzstrm);
+		have = out.length() - bzstrm.avail_out;
+	} while (BZ_OK == ret && (bzstrm.avail_in > 0 || 0 == bzstrm.avail_out));
+
+	BZ2_bzDecompressEnd (&bzstrm);
+	out.resize (have);
+	return (BZ_STREAM_END == ret);
+}
+
+/* Decompresses the block that starts at bit start into out, and finds where it ends. The
+	end is the next magic number, unless the block does not decompress up to there; that
+	one is then taken to be part of the compressed data, and the one after it is tried. */
+static bool
+bzip2_decode (FILE * fp, off64_t start, off64_t * end, unsigned char * input, std::string & out) {
+	off64_t at = start;
+	bool eos = false;
+
+	for (int ii = 0; ii <= BZIP2_RETRIES; ii++) {
+		if ((at = bzip2_marker (fp, at + 1, input, &eos)) < 0)
+			return false;
+
+		if (true == bzip2_block (fp, start, at, out)) {
+			*end = at;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+Bzip2Index::Bzip2Index (void) {
+}
+
+LookupTable *
+Bzip2Index::Add (off64_t byte, off64_t line, off64_t start, off64_t end) {
+	Bzip2BlockData * block = (Bzip2BlockData *)malloc (sizeof (Bzip2BlockData));
+
+	if (NULL == block)
+		return NULL;
+
+	block->start = start;
+	block->end = end;
+
+	this->lock();
+
+	if (NULL == FileIndex::Add (byte, line)) {
+		this->unlock();
+		free (block);
+		return NULL;
+	}
+
+	(this->table->list + this->table->have - 1)->extra = block;
+	this->unlock();
+
+	return this->table;
+}
+
+/* Every mark is saved with the bits that its block starts and ends at; the first mark,
+	at the start of the file, has none. */
+bool
+Bzip2Index::SaveExtra (FILE * fp, const LineOffset * mark) {
+	Bzip2BlockData * block = (Bzip2BlockData *)mark->extra;
+	unsigned char point = (NULL != block);
+
+	if (1 != fwrite (&point, sizeof (point), 1, fp))
+		return false;
+	if (NULL == block)
+		return true;
+
+	return (1 == fwrite (&block->start, sizeof (block->start), 1, fp))
+		&& (1 == fwrite (&block->end, sizeof (block->end), 1, fp));
+}
+
+bool
+Bzip2Index::LoadExtra (FILE * fp, LineOffset * mark) {
+	unsigned char point = 0;
+	off64_t start = 0, end = 0;
+
+	if (1 != fread (&point, sizeof (point), 1, fp))
+		return false;
+	if (0 == point)
+		return true;
+
+	if (1 != fread (&start, sizeof (start), 1, fp)
+		 || 1 != fread (&end, sizeof (end), 1, fp)
+		 || start < 0 || end < start + 48 + 32)
+		return false;
+
+	Bzip2BlockData * block = (Bzip2BlockData *)malloc (sizeof (Bzip2BlockData));
+	if (NULL == (mark->extra = block))
+		return false;
+
+	block->start = start;
+	block->end = end;
+	return true;
+}
+
+/* The bytes of the marks are uncompressed; a block says where it is inside
+	of the compressed file, in bits. */
+bool
+Bzip2Index::Inside (const LineOffset * mark, const IndexStamp & stamp) const {
+	const Bzip2BlockData * block = (const Bzip2BlockData *)mark->extra;
+	return (NULL == block || block->end <= stamp.size * 8);
+}
+
+Bzip2Dispatcher::Bzip2Dispatcher (int e)
+	: AbstractFileDispatcher (e, new Bzip2Index) {
+}
+
+Bzip2Dispatcher::~Bzip2Dispatcher (void) {
+}
+
+bool
+Bzip2Dispatcher::Openfile (const std::string & filename) {
+	unsigned char bzheader[4];
+	FILE * fp = NULL;
+
+	if (NULL == (fp = FOPEN (filename.c_str(), "rb"))) {
+		std::cerr << "Failed opening "<<filename<<" for binary bzip2 reading.\n";
+		return false;
+	}
+
+	// A bzip2 stream starts with "BZh" and the block size (in 100k) that it was
+	// compressed with, from 1 to 9.
+	if (sizeof (bzheader) != fread (bzheader, 1, sizeof (bzheader), fp)
+		 || 'B' != bzheader[0] || 'Z' != bzheader[1] || 'h' != bzheader[2]
+		 || bzheader[3] < '1' || bzheader[3] > '9') {
+		std::cerr << "Input file "<<filename<<" is not bzip2 formatted.\n";
+		FCLOSE (fp);
+		return false;
+	}
+
+	FCLOSE (fp);
+	this->filename = filename;
+
+	// The blocks of a file that was indexed (and closed) before, and has not changed
+	// since, are read back instead of decompressing the whole file again.
+	if (false == this->indexpath.empty() && FileIndex::Stamp (filename, this->stamp) == true)
+		this->indexed = this->marks->Load (this->indexpath, this->stamp);
+	else
+		this->indexpath.clear();
+
+	return true;
+}
+
+bool
+Bzip2Dispatcher::Closefile (void) {
+	if (true == this->indexpath.empty() || true == this->indexed || false == this->marks->isFinished())
+		return true;
+
+	if (false == this->marks->Save (this->indexpath, this->stamp)) {
+		g_warning ("Failed saving the index of %s to %s", this->filename.c_str(), this->indexpath.c_str());
+		return false;
+	}
+
+	this->indexed = true;
+	return true;
+}
+
+bool
+Bzip2Dispatcher::Readline (off64_t start, off64_t N) {
+	Bzip2LineReader * reader = new Bzip2LineReader (this->filename, this->marks, start, N);
+	this->addWorker (reader);
+	return true;
+}
+
+bool
+Bzip2Dispatcher::Readoffset (off64_t start, off64_t N) {
+	Bzip2OffsetReader * reader = new Bzip2OffsetReader (this->filename, this->marks, start, N);
+	this->addWorker (reader);
+	return true;
+}
+
+bool
+Bzip2Dispatcher::Readpercent (float percent, off64_t N) {
+	if (percent > 99) return false;
+
+	this->marks->lock();
+
+	// Nothing has been indexed yet (or the file is empty).
+	if (NULL == this->marks->get(0)) {
+		this->marks->unlock();
+		return false;
+	}
+
+	// The blocks are spread evenly over the uncompressed data.
+	int index = (int)(this->marks->size() * (percent / 100));
+	off64_t byte = this->marks->get(index)->byte;
+
+	this->marks->unlock();
+
+	Bzip2OffsetReader * reader = new Bzip2OffsetReader (this->filename, this->marks, byte, N);
+	this->addWorker (reader);
+	return true;
+}
+
+void
+Bzip2Dispatcher::Index (void) {
+	Bzip2BlockIndexer * indexer = new Bzip2BlockIndexer (this->filename, this->marks);
+	this->addWorker (indexer);
+}
+
+void *
+Bzip2Dispatcher::run (void * null) {
+	if (false == this->indexed)
+		this->Index();
+
+	while (true == this->isRunning()) {
+		while (0 == this->inputQueue.size()) {
+			if (false == this->isRunning())
+				return NULL;
+			concurrent::Thread::sleep(1);
+		}
+
+		this->pro->onReadComplete (this->inputQueue.pop());
+	}
+
+	return NULL;
+}
+
+Bzip2FileWorker::Bzip2FileWorker (const std::string & filename, FileIndexPtr marks)
+	: AbstractFileWorker (filename, marks) {
+	this->fp = NULL;
+}
+
+Bzip2FileWorker::Bzip2FileWorker (const std::string & filename)
+	: AbstractFileWorker (filename) {
+	this->fp = NULL;
+}
+
+Bzip2FileWorker::~Bzip2FileWorker (void) {
+}
+
+bool
+Bzip2FileWorker::Openfile (void) {
+	if (NULL != this->fp)
+		return false;
+
+	// The dispatcher already made sure that this is a bzip2 file.
+	return (NULL != (this->fp = FOPEN (this->filename.c_str(), "rb")));
+}
+
+bool
+Bzip2FileWorker::Closefile (void) {
+	if (NULL == this->fp)
+		return false;
+
+	fclose (this->fp);
+	this->fp = NULL;
+	return true;
+}
+
+bool
+Bzip2FileWorker::FindPoint (off64_t line, off64_t byte, LineOffset & point) {
+	// The start of the file will do until the indexer has been through a block.
+	point.byte = point.line = 0;
+	point.extra = NULL;
+
+	this->marks->lock();
+
+	for (int index = 1; NULL != this->marks->get(0) && index < this->marks->size(); index++) {
+		LineOffset * mark = this->marks->get(index);
+
+		if (mark->line < 0)
+			break;
+		if ((line >= 0 && mark->line >= line) || (byte >= 0 && mark->byte > byte))
+			break;
+
+		point = *mark;
+	}
+
+	this->marks->unlock();
+	return true;
+}
+
+bool
+Bzip2FileWorker::Readlines (const LineOffset * point, off64_t skip, off64_t lines, off64_t N, std::string & window) {
+	Bzip2BlockData * block = (Bzip2BlockData *)point->extra;
+	unsigned char * input = new unsigned char[BZIP2_CHUNK + 8];
+	off64_t from = (NULL == block) ? bzip2_stream (this->fp, 0) : block->start;
+	off64_t to = (NULL == block) ? -1 : block->end;
+	std::string out;
+	bool result = true;
+
+	while (N > 0 && from >= 0) {
+		if (false == this->isRunning()
+			 || false == ((to < 0) ? bzip2_decode (this->fp, from, &to, input, out) : bzip2_block (this->fp, from, to, out))) {
+			result = false;
+			break;
+		}
+
+		const char * p = out.data(), * end = out.data() + out.length(), * q;
+
+		if (skip > 0) {
+			off64_t k = MIN (skip, (off64_t)out.length());
+			p += k;
+			skip -= k;
+		}
+
+		for (; lines > 0 && p < end; lines--) {
+			if (NULL == (q = (const char *)memchr (p, '\n', end - p))) {
+				p = end;
+				break;
+			}
+			p = q + 1;
+		}
+
+		for (; N > 0 && p < end; N--) {
+			if (NULL == (q = (const char *)memchr (p, '\n', end - p))) {
+				window.append (p, end - p);
+				break;
+			}
+			window.append (p, q + 1 - p);
+			p = q + 1;
+		}
+
+		from = bzip2_follow (this->fp, to);
+		to = -1;
+	}
+
+	delete [] input;
+	return result;
+}
+
+Bzip2LineReader::Bzip2LineReader (const std::string & filename, FileIndexPtr marks, off64_t start, off64_t N)
+	: Bzip2FileWorker (filename, marks) {
+	this->numberOfLinesToRead = N;
+	this->startLine = start;
+}
+
+Bzip2LineReader::~Bzip2LineReader (void) {
+}
+
+void *
+Bzip2LineReader::run (void * null) {
+	LineOffset point;
+	std::string window;
+
+	if (false == Bzip2FileWorker::Openfile ()) {
+		g_critical ("Failed opening");
+		return NULL;
+	}
+
+	// Only the blocks from the last mark before the line on are decompressed; before
+	// the indexer gets to the line this is the last block that it has reached.
+	if (false == this->FindPoint (this->startLine, -1, point)
+		 || false == this->Readlines (&point, 0, this->startLine - point.line, this->numberOfLinesToRead, window)) {
+		g_critical ("Failed decompressing line %lld of %s", (long long)this->startLine, this->filename.c_str());
+		goto thread_teardown;
+	}
+
+	if (window.length() > 0)
+		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (window);
+	this->dispatcher->removeWorker (this);
+
+ thread_teardown:
+	this->Closefile();
+	return NULL;
+}
+
+Bzip2OffsetReader::Bzip2OffsetReader (const std::string & filename, FileIndexPtr marks, off64_t offset, off64_t N)
+	: Bzip2FileWorker (filename, marks) {
+	this->numberOfLinesToRead = N;
+	this->startOffset = offset;
+}
+
+Bzip2OffsetReader::~Bzip2OffsetReader (void) {
+}
+
+void *
+Bzip2OffsetReader::run (void * null) {
+	LineOffset point;
+	std::string window;
+
+	if (false == Bzip2FileWorker::Openfile ()) {
+		g_critical ("Failed opening");
+		return NULL;
+	}
+
+	// The offset is into the uncompressed data; like the plaintext reader this starts
+	// with the (next) line after it.
+	if (false == this->FindPoint (-1, this->startOffset, point)
+		 || false == this->Readlines (&point, this->startOffset - point.byte, 1, this->numberOfLinesToRead, window)) {
+		g_critical ("Failed decompressing offset %lld of %s", (long long)this->startOffset, this->filename.c_str());
+		goto thread_teardown;
+	}
+
+	if (window.length() > 0)
+		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (window);
+	this->dispatcher->removeWorker (this);
+
+ thread_teardown:
+	this->Closefile();
+	return NULL;
+}
+
+Bzip2RangeScanner::Bzip2RangeScanner (const std::string & filename,
+												  Bzip2IndexPtr index,
+												  concurrent::IRunnable * owner,
+												  off64_t begin,
+												  off64_t end)
+	: filename (filename), index (index), owner (owner), begin (begin), end (end), exact (false),
+	  first (-1), last (-1), bytes (0), lines (0), partial (false), eof (false), done (false) {
+}
+
+Bzip2RangeScanner::~Bzip2RangeScanner (void) {
+	for (size_t ii = 0; ii < this->points.size(); ii++) {
+		if (NULL != this->points[ii].extra)
+			free (this->points[ii].extra);
+	}
+}
+
+void *
+Bzip2RangeScanner::run (void * null) {
+	off64_t start = -1, stop = -1;
+	bool eos = false;
+	std::string out;
+	FILE * fp = NULL;
+
+	if (NULL == (fp = FOPEN (this->filename.c_str(), "rb"))) {
+		g_critical ("Failed opening file descriptor in bzip2 range scanner");
+		return NULL;
+	}
+
+	unsigned char * input = new unsigned char[BZIP2_CHUNK + 8];
+
+	// A block magic number could just as well be compressed data; one is only taken
+	// once the block after it decompresses (and its CRC checks out). The indexer has
+	// the final word on it.
+	if (true == this->exact) {
+		start = (0 == this->begin) ? bzip2_stream (fp, 0) : this->begin;
+
+		if (start >= 0 && start < this->end && false == bzip2_decode (fp, start, &stop, input, out))
+			goto thread_teardown;
+	}
+	else {
+		for (start = this->begin; true == this->owner->isRunning(); start++) {
+			if ((start = bzip2_marker (fp, start, input, &eos)) < 0 || start >= this->end)
+				break;
+			if (false == eos && true == bzip2_decode (fp, start, &stop, input, out))
+				break;
+		}
+	}
+
+	this->first = start;
+
+	while (start >= 0 && start < this->end) {
+		if (false == this->owner->isRunning())
+			goto thread_teardown;
+
+		if (!this->index) {
+			Bzip2BlockData * block = (Bzip2BlockData *)malloc (sizeof (Bzip2BlockData));
+			LineOffset point = { this->bytes, this->lines, block };
+
+			if (NULL == block)
+				goto thread_teardown;
+
+			block->start = start;
+			block->end = stop;
+			this->points.push_back (point);
+		}
+		else {
+			if (NULL == this->index->Add (this->bytes, this->lines, start, stop))
+				goto thread_teardown;
+			this->index->setLines (this->lines);
+		}
+
+		this->bytes += out.length();
+		this->lines += CountNewlines ((const unsigned char *)out.data(), out.length());
+		if (out.length() > 0)
+			this->partial = ('\n' != out[out.length() - 1]);
+
+		if ((start = bzip2_follow (fp, stop)) >= 0 && start < this->end
+			 && false == bzip2_decode (fp, start, &stop, input, out))
+			goto thread_teardown;
+	}
+
+	this->last = start;
+	this->eof = (start < 0);
+	this->done = true;
+
+ thread_teardown:
+	delete [] input;
+	FCLOSE (fp);
+	return NULL;
+}
+
+Bzip2BlockIndexer::Bzip2BlockIndexer (const std::string & filename, FileIndexPtr marks)
+	: Bzip2FileWorker (filename, marks) {
+}
+
+Bzip2BlockIndexer::~Bzip2BlockIndexer (void) {
+}
+
+void *
+Bzip2BlockIndexer::run (void * null) {
+	Bzip2IndexPtr index = std::tr1::dynamic_pointer_cast <Bzip2Index> (this->marks);
+	std::vector<Bzip2RangeScanner *> scanners, repairs;
+	Bzip2RangeScanner * scanner = NULL;
+	struct timeval start, end;
+	off64_t size = 0, expect = -1, bytes = 0, lines = 0;
+	bool partial = false, done = false;
+	size_t next = 0, joined = 0;
+	int ranges = 1;
+	double ms;
+
+	if (false == Bzip2FileWorker::Openfile()) {
+		std::cerr << "Failed opening file descriptor in bz2 line indexer\n";
+		return NULL;
+	}
+
+	FSEEK_END (this->fp);
+	size = FTELL (this->fp);
+
+	// One range per core, as long as they stay large enough to be worth a thread.
+	ranges = MIN ((off64_t)sysconf (_SC_NPROCESSORS_ONLN), size / BZIP2_RANGE_MIN);
+	ranges = CLAMP (ranges, 1, BZIP2_THREADS_MAX);
+
+	std::cout << "index starting..." << std::flush;
+
+	gettimeofday (&start, NULL);
+
+	// Every block of a bzip2 file decompresses on its own, so each range of the file
+	// is decompressed on its own thread.
+	for (int ii = 0; ii < ranges; ii++) {
+		scanner = new Bzip2RangeScanner (this->filename,
+													(0 == ii) ? index : Bzip2IndexPtr(),
+													this,
+													((size * ii) / ranges) << 3,
+													((size * (ii + 1)) / ranges) << 3);
+		if (0 == ii)
+			scanner->setExact();
+
+		scanners.push_back (scanner);
+		scanner->start();
+	}
+
+	// The ranges are put together in order. Each one has to start at the block after
+	// the last one of the range before it; if none did (it was fooled by a magic number
+	// inside of the compressed data) the blocks in between are decompressed here.
+	while (true == this->isRunning()) {
+		scanner = NULL;
+
+		for (; next < scanners.size(); next++) {
+			for (; joined <= next; joined++)
+				scanners[joined]->join();
+
+			if (0 == next) {
+				if (true == scanners[next]->done)
+					scanner = scanners[next++];
+				break;
+			}
+			if (true == scanners[next]->done && scanners[next]->first == expect) {
+				scanner = scanners[next++];
+				break;
+			}
+			if (scanners[next]->first > expect)
+				break;
+		}
+
+		if (NULL == scanner) {
+			if (0 == next)
+				break;
+
+			scanner = new Bzip2RangeScanner (this->filename, Bzip2IndexPtr(), this, expect,
+														(next < scanners.size()) ? scanners[next]->first : (size << 3));
+			scanner->setExact();
+
+			repairs.push_back (scanner);
+			scanner->run (NULL);
+
+			if (false == scanner->done)
+				break;
+		}
+
+		size_t added = 0;
+		for (; added < scanner->points.size(); added++) {
+			LineOffset * point = &scanner->points[added];
+			Bzip2BlockData * block = (Bzip2BlockData *)point->extra;
+
+			if (NULL == index->Add (bytes + point->byte, lines + point->line, block->start, block->end))
+				break;
+		}
+		if (added < scanner->points.size())
+			break;
+
+		bytes += scanner->bytes;
+		lines += scanner->lines;
+		if (scanner->bytes > 0)
+			partial = scanner->partial;
+		index->setLines (lines);
+
+		expect = scanner->last;
+		if (true == (done = scanner->eof))
+			break;
+	}
+
+	// Whatever was not put together is waited for (and thrown away).
+	for (size_t ii = 0; ii < scanners.size(); ii++) {
+		if (ii >= joined)
+			scanners[ii]->join();
+		delete scanners[ii];
+	}
+	for (size_t ii = 0; ii < repairs.size(); ii++)
+		delete repairs[ii];
+
+	if (false == done) {
+		std::cerr << "Failed indexing!\n";
+		goto thread_teardown;
+	}
+
+	gettimeofday (&end, NULL);
+
+	ms = ((((end.tv_sec-start.tv_sec) * 1000) + ((end.tv_usec-start.tv_usec)/1000.0)) + 0.5);
+	std::cout<<"ready (ms:"<<ms<<", ranges:"<<ranges<<")!\n"<<std::flush;
+
+	index->setLines (partial ? lines + 1 : lines);
+	index->setFinished (true);
+
+ thread_teardown:
+	this->Closefile();
+	return NULL;
+}
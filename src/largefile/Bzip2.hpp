@@ -0,0 +1,240 @@
+/*
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef BZIP2_HPP
+#define BZIP2_HPP
+
+#include "FileIndex.hpp"
+#include "FileWorker.hpp"
+#include "FileDispatcher.hpp"
+#include <concurrent/Thread.hpp>
+#include <tr1/memory>
+#include <vector>
+#include <bzlib.h>
+
+namespace largefile {
+
+	/// The 48 bit magic numbers that start each block of a bzip2 stream, and that end
+	/// the stream; neither of them has to start on a byte.
+#define BZIP2_BLOCK_MAGIC 0x314159265359ULL
+#define BZIP2_EOS_MAGIC 0x177245385090ULL
+
+	/// How much compressed data is read at a time while looking for magic numbers.
+#define BZIP2_CHUNK (1L << 20)
+
+	/// A magic number may turn up inside of compressed data too. A block that does not
+	/// decompress up to the next one is tried up to the one after that, this many times.
+#define BZIP2_RETRIES 4
+
+	/// The bzip2 indexer splits a file into at most this many ranges of compressed
+	/// bytes, one thread apiece, and never into ranges smaller than the minimum.
+#define BZIP2_THREADS_MAX 16
+#define BZIP2_RANGE_MIN (4L << 20)
+
+	/// A block of a bzip2 stream; it goes from the bit where its magic number starts up
+	/// to the bit where the next magic number does. Every block decompresses on its own.
+	struct Bzip2BlockData : public OffsetData {
+		off64_t start;
+		off64_t end;
+	};
+
+	/***
+	 * \class Bzip2Index
+	 * \ingroup Largefile
+	 * \author jb (jvb4@njit.edu)
+	 * \brief Index of a bzip2 file with a mark for each of its blocks. The first mark has no
+	 * block, and starts at the header of the file instead.
+	 */
+	class Bzip2Index : public FileIndex {
+	protected:
+		uint32_t Kind (void) const { return 2; }
+		bool SaveExtra (FILE * fp, const LineOffset * mark);
+		bool LoadExtra (FILE * fp, LineOffset * mark);
+		bool Inside (const LineOffset * mark, const IndexStamp & stamp) const;
+	public:
+		Bzip2Index (void);
+
+		/// Adds a mark for the block in between the start and end bits.
+		LookupTable * Add (off64_t byte, off64_t line, off64_t start, off64_t end);
+	};
+
+	typedef std::tr1::shared_ptr<Bzip2Index> Bzip2IndexPtr;
+
+	/***
+	 * \class Bzip2Dispatcher
+	 * \ingroup Largefile
+	 * \author jb (jvb4@njit.edu)
+	 * \brief
+	 */
+	class Bzip2Dispatcher : public AbstractFileDispatcher {
+	public:
+		/// Constructor.
+		Bzip2Dispatcher (int e);
+
+		/// Destructor.
+		virtual ~Bzip2Dispatcher (void);
+
+		bool Openfile (const std::string & filename);
+		bool Closefile (void);
+
+		bool Readline (off64_t start, off64_t N);
+		bool Readoffset (off64_t start, off64_t N);
+		bool Readpercent (float percent, off64_t N);
+		void Index (void);
+
+		void * run (void * null);
+	};
+
+	/***
+	 * \class Bzip2FileWorker
+	 * \ingroup Largefile
+	 * \author jb (jvb4@njit.edu)
+	 * \brief
+	 */
+	class Bzip2FileWorker : public AbstractFileWorker {
+	protected:
+		FILE * fp;
+
+		/// Passes over skip bytes and then lines newlines of the file from a mark on, and
+		/// collects the N lines after that into window. Blocks are decompressed one after
+		/// the other, for as long as there are lines left to collect.
+		bool Readlines (const LineOffset * point, off64_t skip, off64_t lines, off64_t N, std::string & window);
+
+		/// Copies the last mark before (or at) a line or an uncompressed byte.
+		bool FindPoint (off64_t line, off64_t byte, LineOffset & point);
+	public:
+		Bzip2FileWorker (const std::string & filename, FileIndexPtr marks);
+		Bzip2FileWorker (const std::string & filename);
+		virtual ~Bzip2FileWorker (void);
+
+		bool Openfile (void);
+		bool Closefile (void);
+	};
+
+	/***
+	 * \class Bzip2LineReader
+	 * \ingroup Largefile
+	 * \author jb (jvb4@njit.edu)
+	 * \brief
+	 */
+	class Bzip2LineReader : public Bzip2FileWorker {
+	private:
+		off64_t numberOfLinesToRead;
+		off64_t startLine;
+	public:
+		Bzip2LineReader (const std::string & filename, FileIndexPtr marks, off64_t start, off64_t N);
+
+		virtual ~Bzip2LineReader (void);
+
+		void * run (void * null);
+	};
+
+	/***
+	 * \class Bzip2OffsetReader
+	 * \ingroup Largefile
+	 * \author jb (jvb4@njit.edu)
+	 * \brief
+	 */
+	class Bzip2OffsetReader : public Bzip2FileWorker {
+	private:
+		off64_t numberOfLinesToRead;
+		off64_t startOffset;
+	public:
+		Bzip2OffsetReader (const std::string & filename, FileIndexPtr marks, off64_t offset, off64_t N);
+
+		virtual ~Bzip2OffsetReader (void);
+
+		void * run (void * null);
+	};
+
+	/***
+	 * \class Bzip2RangeScanner
+	 * \ingroup Largefile
+	 * \brief Decompresses the blocks that start inside of one range of a bzip2 file for the
+	 * Bzip2BlockIndexer, counting their bytes and lines. A range that does not start the
+	 * file begins at the first block magic number inside of it that decompresses, and
+	 * its marks are relative to there until the indexer adds in the ranges before it.
+	 * The range at the start of the file adds its marks to the index as it goes. All
+	 * positions are in bits.
+	 */
+	class Bzip2RangeScanner : public concurrent::Thread {
+	private:
+		std::string filename;
+		Bzip2IndexPtr index;
+		concurrent::IRunnable * owner;
+		off64_t begin;
+		off64_t end;
+		bool exact;
+	public:
+		/// The marks of the blocks, relative to the start (unless they went into the index).
+		std::vector<LineOffset> points;
+
+		/// Where the first block of the range starts (-1 if none does), and where the block
+		/// after its last one starts.
+		off64_t first;
+		off64_t last;
+
+		/// Uncompressed bytes and newlines, and whether the last line was left without a
+		/// newline.
+		off64_t bytes;
+		off64_t lines;
+		bool partial;
+
+		/// Whether there are no blocks after the last one.
+		bool eof;
+
+		/// Whether the whole range was read.
+		bool done;
+
+		/// Constructor; the range is [begin, end). The index is given to the range at the
+		/// start of the file only.
+		Bzip2RangeScanner (const std::string & filename, Bzip2IndexPtr index, concurrent::IRunnable * owner,
+								 off64_t begin, off64_t end);
+
+		/// Destructor.
+		virtual ~Bzip2RangeScanner (void);
+
+		/// Starts right at begin, which is known to be a block; or at the header of the
+		/// file, when begin is 0.
+		inline void setExact (void) { this->exact = true; }
+
+		/// Method that acts as "main" for thread of execution.
+		void * run (void * null);
+	};
+
+	/***
+	 * \class Bzip2BlockIndexer
+	 * \ingroup Largefile
+	 * \author jb (jvb4@njit.edu)
+	 * \brief
+	 */
+	class Bzip2BlockIndexer : public Bzip2FileWorker {
+	public:
+		/// Constructor.
+		Bzip2BlockIndexer (const std::string & filename, FileIndexPtr marks);
+
+		/// Destructor.
+		virtual ~Bzip2BlockIndexer (void);
+
+		/// Method that acts as "main" for thread of execution.
+		void * run (void * null);
+	};
+
+}
+
+#endif
@@ -19,6 +19,7 @@
 #include "FileDispatcher.hpp"
 #include "Plaintext.hpp"
 #include "Gzip.hpp"
+#include "Bzip2.hpp"
 #include <proactor/Proactor.hpp>
 #include <cstdio>
 #include <iostream>
@@ -30,25 +31,30 @@ AbstractFileDispatcher::CreateFromExtension (const std::string & filename, int e
 	std::string ext = filename.substr (filename.find_last_of ('.'), filename.length());
 
 	// Return the proper worker depending on the file's extension. This is so that we can
-	// support automatically opening .gz, .lz and .bz2 extensions automatically in the future.
+	// support automatically opening .gz and .bz2 (and .lz in the future) extensions automatically.
 	if (0 == ext.compare (".gz"))
 		return new GnuzipDispatcher (e);
+	if (0 == ext.compare (".bz2"))
+		return new Bzip2Dispatcher (e);
 	return new PlaintextDispatcher (e);
 }
 
-AbstractFileDispatcher::AbstractFileDispatcher (int e) {
+AbstractFileDispatcher::AbstractFileDispatcher (int e)
+	: indexed (false) {
 	setEventId (e);
 
 	this->marks = FileIndexPtr (new FileIndex);
 }
 
-AbstractFileDispatcher::AbstractFileDispatcher (int e, FileIndex * marks) {
+AbstractFileDispatcher::AbstractFileDispatcher (int e, FileIndex * marks)
+	: indexed (false) {
 	setEventId (e);
 	
 	this->marks = FileIndexPtr (marks);
 }
 
-AbstractFileDispatcher::AbstractFileDispatcher (int e, FileIndexPtr marks) {
+AbstractFileDispatcher::AbstractFileDispatcher (int e, FileIndexPtr marks)
+	: indexed (false) {
 	setEventId (e);
 
 	this->marks = marks;
@@ -57,3 +63,24 @@ AbstractFileDispatcher::AbstractFileDispatcher (int e, FileIndexPtr marks) {
 AbstractFileDispatcher::~AbstractFileDispatcher (void) {
 }
 
+std::string
+AbstractFileDispatcher::SidecarPath (const std::string & filename, const std::string & directory) {
+	if (directory.empty())
+		return filename + ".gwbidx";
+
+	std::string name = filename;
+	for (size_t ii = 0; ii < name.length(); ii++) {
+		if (name[ii] == '/')
+			name[ii] = '%';
+	}
+	return directory + "/" + name + ".gwbidx";
+}
+
+off64_t
+AbstractFileDispatcher::Lines (void) {
+	this->marks->lock();
+	off64_t lines = this->marks->lines();
+	this->marks->unlock();
+	return lines;
+}
+
@@ -37,8 +37,15 @@ namespace largefile {
 	protected:
 		FileIndexPtr marks;
 		std::string filename;
+		std::string indexpath;
+		IndexStamp stamp;
+		bool indexed;
 	public:
 		static AbstractFileDispatcher * CreateFromExtension (const std::string & filename, int e);
+
+		/// Where the sidecar index of a file goes: next to it, or inside of a cache
+		/// directory under a name made from its whole path.
+		static std::string SidecarPath (const std::string & filename, const std::string & directory);
 		
 		/// Constructor.
 		AbstractFileDispatcher (int e);
@@ -55,6 +62,13 @@ namespace largefile {
 		virtual bool Readoffset (off64_t start, off64_t N) = 0;
 		virtual bool Readpercent (float percent, off64_t N) = 0;
 		virtual void Index (void) = 0;
+
+		/// The number of lines inside of the file that the index knows about so far.
+		virtual off64_t Lines (void);
+
+		/// Keeps the finished index in a sidecar file, and uses it on the next Openfile
+		/// if the file has not changed. Call this before Openfile.
+		inline void setIndexPath (const std::string & path) { this->indexpath = path; }
 	};
 	
 }
@@ -17,11 +17,18 @@
    Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
 */
 #include "FileIndex.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <header.h>
 
 using namespace largefile;
 
 FileIndex::FileIndex (void) {
 	this->table = NULL;
+	this->total = 0;
+	this->finished = false;
 }
 
 FileIndex::~FileIndex (void) {
@@ -33,12 +40,11 @@ FileIndex::Free (void) {
 	this->lock();
 	
 	if (NULL != this->table) {
-		// Deal with the "extra" offset param field if it exists.
-		if (NULL != this->table->list->extra) {
-			for (int ii = 0; ii < this->table->have; ii++) {
-				if (NULL != (this->table->list + ii)->extra)
-					free ((this->table->list + ii)->extra);
-			}
+		// Deal with the "extra" offset param field if it exists. The first mark never
+		// has one, so every mark has to be looked at.
+		for (int ii = 0; ii < this->table->have; ii++) {
+			if (NULL != (this->table->list + ii)->extra)
+				free ((this->table->list + ii)->extra);
 		}
 		
 		free (this->table->list);
@@ -100,3 +106,175 @@ LineOffset *
 FileIndex::get (int ii) {
 	return (NULL == table) ? NULL : table->list + ii;
 }
+
+bool
+FileIndex::Stamp (const std::string & filename, IndexStamp & stamp) {
+	struct stat64 st;
+	unsigned char sample[INDEX_SAMPLE_SIZE];
+	int fd;
+
+	if (-1 == (fd = open64 (filename.c_str(), O_RDONLY)))
+		return false;
+
+	if (-1 == fstat64 (fd, &st)) {
+		close (fd);
+		return false;
+	}
+
+	stamp.size = st.st_size;
+	stamp.mtime = st.st_mtime;
+
+	// FNV-1a over samples spread from the start to the end of the file, so that a
+	// file which was rewritten in place (same size, touched mtime) is still caught.
+	stamp.fingerprint = 14695981039346656037ULL;
+	for (int ii = 0; ii < INDEX_SAMPLES; ii++) {
+		off64_t offset = 0;
+
+		if (stamp.size > INDEX_SAMPLE_SIZE)
+			offset = ((stamp.size - INDEX_SAMPLE_SIZE) * ii) / (INDEX_SAMPLES - 1);
+
+		ssize_t bytes = pread64 (fd, sample, INDEX_SAMPLE_SIZE, offset);
+		for (ssize_t jj = 0; jj < bytes; jj++) {
+			stamp.fingerprint ^= sample[jj];
+			stamp.fingerprint *= 1099511628211ULL;
+		}
+	}
+
+	close (fd);
+	return true;
+}
+
+bool
+FileIndex::Save (const std::string & path, const IndexStamp & stamp) {
+	std::string temp = path + ".tmp";
+	FILE * fp = NULL;
+	bool result = true;
+
+	this->lock();
+
+	if (NULL == this->table) {
+		this->unlock();
+		return false;
+	}
+
+	if (NULL == (fp = FOPEN (temp.c_str(), "wb"))) {
+		this->unlock();
+		return false;
+	}
+
+	uint32_t kind = this->Kind();
+	int have = 0;
+
+	// A mark that was never indexed would only make the whole file fail to load.
+	for (int ii = 0; ii < this->table->have; ii++)
+		if (this->table->list[ii].line >= 0)
+			have++;
+
+	result = (1 == fwrite (INDEX_MAGIC, sizeof (INDEX_MAGIC), 1, fp))
+		&& (1 == fwrite (&INDEX_VERSION, sizeof (INDEX_VERSION), 1, fp))
+		&& (1 == fwrite (&kind, sizeof (kind), 1, fp))
+		&& (1 == fwrite (&stamp.size, sizeof (stamp.size), 1, fp))
+		&& (1 == fwrite (&stamp.mtime, sizeof (stamp.mtime), 1, fp))
+		&& (1 == fwrite (&stamp.fingerprint, sizeof (stamp.fingerprint), 1, fp))
+		&& (1 == fwrite (&this->total, sizeof (this->total), 1, fp))
+		&& (1 == fwrite (&have, sizeof (have), 1, fp));
+
+	for (int ii = 0; result && ii < this->table->have; ii++) {
+		LineOffset * mark = this->table->list + ii;
+
+		if (mark->line < 0)
+			continue;
+
+		result = (1 == fwrite (&mark->byte, sizeof (mark->byte), 1, fp))
+			&& (1 == fwrite (&mark->line, sizeof (mark->line), 1, fp))
+			&& this->SaveExtra (fp, mark);
+	}
+
+	this->unlock();
+
+	result = (0 == fclose (fp)) && result;
+	if (result)
+		result = (0 == rename (temp.c_str(), path.c_str()));
+	if (false == result)
+		unlink (temp.c_str());
+	return result;
+}
+
+bool
+FileIndex::Load (const std::string & path, const IndexStamp & stamp) {
+	char magic[sizeof (INDEX_MAGIC)];
+	uint32_t version = 0, kind = 0;
+	IndexStamp saved;
+	off64_t lines = 0;
+	int have = 0;
+	FILE * fp = NULL;
+
+	if (NULL == (fp = FOPEN (path.c_str(), "rb")))
+		return false;
+
+	bool result = (1 == fread (magic, sizeof (magic), 1, fp))
+		&& (0 == memcmp (magic, INDEX_MAGIC, sizeof (magic)))
+		&& (1 == fread (&version, sizeof (version), 1, fp))
+		&& (INDEX_VERSION == version)
+		&& (1 == fread (&kind, sizeof (kind), 1, fp))
+		&& (this->Kind() == kind)
+		&& (1 == fread (&saved.size, sizeof (saved.size), 1, fp))
+		&& (1 == fread (&saved.mtime, sizeof (saved.mtime), 1, fp))
+		&& (1 == fread (&saved.fingerprint, sizeof (saved.fingerprint), 1, fp))
+		&& (saved.size == stamp.size)
+		&& (saved.mtime == stamp.mtime)
+		&& (saved.fingerprint == stamp.fingerprint)
+		&& (1 == fread (&lines, sizeof (lines), 1, fp))
+		&& (1 == fread (&have, sizeof (have), 1, fp))
+		&& (have > 0);
+
+	if (false == result) {
+		FCLOSE (fp);
+		return false;
+	}
+
+	LineOffset * list = (LineOffset *)calloc (have, sizeof (LineOffset));
+	if (NULL == list) {
+		FCLOSE (fp);
+		return false;
+	}
+
+	// A sidecar file that was damaged (or written by something else) must not send a
+	// reader past the end of the file: the marks have to go forward, one after the
+	// other, and stay inside of it.
+	for (int ii = 0; result && ii < have; ii++) {
+		result = (1 == fread (&list[ii].byte, sizeof (list[ii].byte), 1, fp))
+			&& (1 == fread (&list[ii].line, sizeof (list[ii].line), 1, fp))
+			&& this->LoadExtra (fp, list + ii)
+			&& (0 <= list[ii].byte && 0 <= list[ii].line && list[ii].line <= lines)
+			&& (0 == ii || (list[ii - 1].byte <= list[ii].byte && list[ii - 1].line <= list[ii].line))
+			&& this->Inside (list + ii, stamp);
+	}
+	FCLOSE (fp);
+
+	if (false == result) {
+		for (int ii = 0; ii < have; ii++)
+			free (list[ii].extra);
+		free (list);
+		return false;
+	}
+
+	this->lock();
+	Free();
+
+	if (NULL == (this->table = (LookupTable *)malloc (sizeof (LookupTable)))) {
+		for (int ii = 0; ii < have; ii++)
+			free (list[ii].extra);
+		free (list);
+		this->unlock();
+		return false;
+	}
+
+	this->table->have = this->table->size = have;
+	this->table->list = list;
+	this->total = lines;
+	this->finished = true;
+
+	this->unlock();
+	return true;
+}
@@ -23,6 +23,8 @@
 #include <tr1/memory>
 #include <fcntl.h>
 #include <cstdio>
+#include <string>
+#include <stdint.h>
 
 namespace largefile {
 
@@ -40,6 +42,22 @@ namespace largefile {
 		int size;
 		LineOffset * list;
 	};
+
+	/// What a saved index was built from; it is only used again for a file that still
+	/// matches on all three.
+	struct IndexStamp {
+		off64_t size;
+		int64_t mtime;
+		uint64_t fingerprint;
+	};
+
+	/// Sidecar index files start with this, followed by the format version.
+	const char INDEX_MAGIC[] = "GWBIDX";
+	const uint32_t INDEX_VERSION = 3;
+
+	/// The fingerprint hashes this many evenly spaced samples of this many bytes.
+	const int INDEX_SAMPLES = 16;
+	const int INDEX_SAMPLE_SIZE = 4096;
 	
 	/***
 	 * \class FileIndex
@@ -52,6 +70,21 @@ namespace largefile {
 	class FileIndex : public concurrent::RecursiveMutex {
 	protected:
 		LookupTable * table;
+		off64_t total;
+		bool finished;
+
+		/// Tells the kinds of index apart inside of a sidecar file.
+		virtual uint32_t Kind (void) const { return 0; }
+
+		/// Writes (and reads back) whatever a mark keeps in extra; a plain index has none.
+		virtual bool SaveExtra (FILE * fp, const LineOffset * mark) { return (NULL == mark->extra); }
+		virtual bool LoadExtra (FILE * fp, LineOffset * mark) { return true; }
+
+		/// Whether a mark that was read back points inside of the file it was built from;
+		/// the byte of a plain index is an offset into the file itself.
+		virtual bool Inside (const LineOffset * mark, const IndexStamp & stamp) const {
+			return (mark->byte <= stamp.size);
+		}
 	public:
 		/// Default constructor (and only) constructor for the object.
 		FileIndex (void);
@@ -62,8 +95,43 @@ namespace largefile {
 		void Free (void);
 		LookupTable * Add (off64_t byte, off64_t line);
 
+		/// Takes the size, modification time and a sampled fingerprint of a file.
+		static bool Stamp (const std::string & filename, IndexStamp & stamp);
+
+		/// Writes the finished index to a sidecar file, along with the stamp of the file
+		/// that it was built from. The file is written aside and renamed into place.
+		bool Save (const std::string & path, const IndexStamp & stamp);
+
+		/// Replaces the index with the one inside of a sidecar file, as long as it is of
+		/// this version and kind and was built from a file with the same stamp.
+		bool Load (const std::string & path, const IndexStamp & stamp);
+
 		LineOffset * get (int ii);
 		inline int size (void) const { return this->table->have; }
+
+		/// The number of lines inside of the file; an estimate until it has been indexed.
+		inline off64_t lines (void) const { return *(volatile const off64_t *)&this->total; }
+		inline void setLines (off64_t lines) { *(volatile off64_t *)&this->total = lines; }
+
+		/// Whether the indexer went through the whole file; only then is it worth saving.
+		inline bool isFinished (void) const { return *(volatile const bool *)&this->finished; }
+		inline void setFinished (bool finished) { *(volatile bool *)&this->finished = finished; }
+
+		/// Stores an indexed mark: the byte goes first and the line last, behind a
+		/// barrier, so that anyone who reads the line with published() also sees the
+		/// byte. Neither side takes the lock; the table must not grow meanwhile.
+		inline void publish (LineOffset * mark, off64_t byte, off64_t line) {
+			mark->byte = byte;
+			__sync_synchronize();
+			*(volatile off64_t *)&mark->line = line;
+		}
+
+		/// Returns the line of a mark, or -1 if it has not been indexed yet.
+		inline off64_t published (const LineOffset * mark) const {
+			off64_t line = *(volatile const off64_t *)&mark->line;
+			__sync_synchronize();
+			return line;
+		}
 	};
 
 	typedef std::tr1::shared_ptr<FileIndex> FileIndexPtr;
@@ -17,6 +17,13 @@
    Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
 */
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <header.h>
 #include "FileWorker.hpp"
 #include "Plaintext.hpp"
 
@@ -37,14 +44,148 @@ AbstractFileWorker::WorkerFromExtension (const std::string & filename, FileIndex
 */
 
 AbstractFileWorker::AbstractFileWorker (const std::string & filename, FileIndexPtr marks)
-	: marks (marks), filename (filename) {
+	: marks (marks), filename (filename), map (NULL), mapOffset (0), mapLength (0),
+	  fileLength (0), mapped (false), mapfd (-1) {
 }
 
 AbstractFileWorker::AbstractFileWorker (const std::string & filename)
-	: filename (filename) {
+	: filename (filename), map (NULL), mapOffset (0), mapLength (0),
+	  fileLength (0), mapped (false), mapfd (-1) {
 }
 
 AbstractFileWorker::~AbstractFileWorker (void) {
+	this->Unmapfile();
 	this->Closefile();
 }
-	
+
+bool
+AbstractFileWorker::Mapfile (void) {
+	struct stat64 st;
+
+	if (-1 != this->mapfd)
+		return false;
+
+	if (-1 == (this->mapfd = open64 (this->filename.c_str(), O_RDONLY)))
+		return false;
+
+	if (-1 == fstat64 (this->mapfd, &st)) {
+		close (this->mapfd);
+		this->mapfd = -1;
+		return false;
+	}
+
+	this->fileLength = st.st_size;
+	return true;
+}
+
+void
+AbstractFileWorker::Unmapfile (void) {
+	if (NULL != this->map) {
+		if (true == this->mapped)
+			munmap ((void *)this->map, this->mapLength);
+		else
+			free ((void *)this->map);
+	}
+
+	if (-1 != this->mapfd)
+		close (this->mapfd);
+
+	this->map = NULL;
+	this->mapOffset = this->mapLength = this->fileLength = 0;
+	this->mapfd = -1;
+}
+
+bool
+AbstractFileWorker::Window (off64_t offset, off64_t length) {
+	long page = sysconf (_SC_PAGESIZE);
+	off64_t start = offset - (offset % page);
+	struct stat64 st;
+
+	if (NULL != this->map) {
+		if (true == this->mapped)
+			munmap ((void *)this->map, this->mapLength);
+		else
+			free ((void *)this->map);
+	}
+	this->map = NULL;
+	this->mapOffset = start;
+	this->mapLength = 0;
+
+	// Touching a mapped page past the end of a file that was truncated after it was
+	// mapped raises SIGBUS, so never map more than the file holds right now.
+	if (-1 == this->mapfd || -1 == fstat64 (this->mapfd, &st))
+		return false;
+
+	this->fileLength = st.st_size;
+	if (start >= this->fileLength)
+		return false;
+
+	length = MIN (length + (offset - start), this->fileLength - start);
+
+	void * p = mmap64 (NULL, length, PROT_READ, MAP_PRIVATE, this->mapfd, start);
+	if (MAP_FAILED != p) {
+		madvise (p, length, MADV_SEQUENTIAL);
+		this->map = (const char *)p;
+		this->mapLength = length;
+		this->mapped = true;
+		return true;
+	}
+
+	// Not every file can be mapped (e.g. on some network filesystems, or once the
+	// address space runs out); read the window with stdio instead.
+	FILE * fp = NULL;
+	char * buffer = NULL;
+
+	if (NULL == (fp = FOPEN (this->filename.c_str(), "r")))
+		return false;
+
+	if (NULL == (buffer = (char *)malloc (length))) {
+		FCLOSE (fp);
+		return false;
+	}
+
+	FSEEK (fp, start);
+	length = fread (buffer, 1, length, fp);
+	FCLOSE (fp);
+
+	this->map = buffer;
+	this->mapLength = length;
+	this->mapped = false;
+	return (length > 0);
+}
+
+bool
+AbstractFileWorker::Nextline (off64_t & cursor, LineSlice & line, off64_t keep) {
+	for (;;) {
+		off64_t end = this->mapOffset + this->mapLength;
+
+		if (cursor >= this->fileLength)
+			return false;
+
+		if (NULL != this->map && keep >= this->mapOffset && cursor >= this->mapOffset && cursor < end) {
+			const char * begin = this->Span (cursor);
+			const char * newline = (const char *)memchr (begin, '\n', end - cursor);
+
+			if (NULL != newline || end >= this->fileLength) {
+				line.data = begin;
+				line.length = (NULL == newline) ? (size_t)(end - cursor) : (size_t)(newline - begin) + 1;
+				cursor += line.length;
+				return true;
+			}
+		}
+
+		// The line runs past the window; map the file again from keep on, with at least
+		// twice as much room as there is in between keep and the end of this window.
+		off64_t length = MAX ((off64_t)FILEWORKER_WINDOW, 2 * (MAX (end, cursor) - keep));
+
+		if (false == this->Window (keep, length))
+			return false;
+
+		// A short read leaves the window where it was; the rest of it is the line.
+		if (this->mapOffset + this->mapLength <= MAX (end, cursor)) {
+			if (cursor >= this->mapOffset + this->mapLength)
+				return false;
+			this->fileLength = this->mapOffset + this->mapLength;
+		}
+	}
+}
@@ -22,10 +22,21 @@
 #include <proactor/Worker.hpp>
 #include <string>
 #include <cstdio>
+#include <sys/mman.h>
 #include "FileIndex.hpp"
 
 namespace largefile {
 
+	/// A line inside of the window; length includes the newline, if there is one.
+	struct LineSlice {
+		const char * data;
+		size_t length;
+	};
+
+	/// How much of a file is mapped at a time. A window grows past this only when a
+	/// single read needs more of the file in one piece.
+#define FILEWORKER_WINDOW (16L << 20)
+
 	/***
 	 * \class AbstractFileWorker
 	 * \ingroup Largefile
@@ -39,6 +50,32 @@ namespace largefile {
 	protected:
 		FileIndexPtr marks;
 		std::string filename;
+		const char * map;
+		off64_t mapOffset;
+		off64_t mapLength;
+		off64_t fileLength;
+		bool mapped;
+		int mapfd;
+
+		/// Opens the file for Nextline; nothing is mapped until the first line is read.
+		bool Mapfile (void);
+
+		/// Unmaps the file; nothing handed out by Nextline may be used afterwards.
+		void Unmapfile (void);
+
+		/// Maps (at least) length bytes of the file from offset on, in place of the last
+		/// window. The size of the file is checked again first, so that a file which
+		/// has shrunk is never read past its end. When the file cannot be mapped the
+		/// window is read into memory instead.
+		bool Window (off64_t offset, off64_t length);
+
+		/// Hands out the line that starts at the file offset cursor and moves cursor past
+		/// it. Everything from keep (at or before cursor) on stays in the window, so the
+		/// lines from keep up to cursor can be handed over in one piece (see Span).
+		bool Nextline (off64_t & cursor, LineSlice & line, off64_t keep);
+
+		/// The bytes of the file from offset on, inside of the window.
+		inline const char * Span (off64_t offset) const { return this->map + (offset - this->mapOffset); }
 	public:
 		/// Constructor with the required filename and fileindex parameters.
 		AbstractFileWorker (const std::string & filename, FileIndexPtr marks);
@@ -17,32 +17,116 @@
    Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
 */
 #include "Gzip.hpp"
+#include "Newline.hpp"
 #include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
 #include <proactor/Proactor.hpp>
 
 using namespace largefile;
 
-LookupTable *
-GzipIndex::Add (off64_t byte, off64_t line, off64_t zin, int bits, unsigned int left, unsigned char * window) {
-	LineOffset * x = NULL;
+/* Whether the header of another gzip member comes next. It may straddle the end of what
+	was read, so whatever is left of the input is moved up front and topped up first. */
+static bool
+gzip_member_follows (FILE * fp, z_stream * zstrm, unsigned char * input, off64_t * fpos) {
+	if (zstrm->avail_in < 2) {
+		if (zstrm->avail_in > 0)
+			memmove (input, zstrm->next_in, zstrm->avail_in);
 
-	this->lock();
+		size_t bytes = fread (input + zstrm->avail_in, 1, GZIP_CHUNK - zstrm->avail_in, fp);
 
-	if (NULL == FileIndex::Add (byte, line)) return NULL;
+		if (NULL != fpos)
+			*fpos += bytes;
+		zstrm->avail_in += bytes;
+		zstrm->next_in = input;
+	}
 
-	x = this->table->list + this->table->have - 1;
+	return (zstrm->avail_in >= 2 && 0x1f == zstrm->next_in[0] && 0x8b == zstrm->next_in[1]);
+}
+
+/* Whether the bytes look like the header of a gzip member that deflates; the members of
+	a BGZF file also carry the "BC" subfield as the first of their extra fields. */
+static bool
+gzip_member_header (const unsigned char * p, size_t length, bool bgzf) {
+	if (length < 4 || 0x8b != p[1] || 8 != p[2] || 0 != (p[3] & 0xe0))
+		return false;
+	return (false == bgzf) || (length >= 14 && (p[3] & 4) && 'B' == p[12] && 'C' == p[13]);
+}
+
+GzipBlockData *
+largefile::GzipBlockNew (unsigned int length) {
+	GzipBlockData * block = (GzipBlockData *)malloc (sizeof (GzipBlockData) - 1 + length);
+
+	if (NULL != block)
+		block->length = length;
+	return block;
+}
+
+GzipIndex::GzipIndex (void)
+	: span (GZIP_SPAN) {
+}
+
+bool
+GzipIndex::Window (const GzipBlockData * block, unsigned char * window) {
+	uLongf length = GZIP_WINSIZE;
+
+	if (GZIP_WINSIZE == block->length) {
+		memcpy (window, block->window, GZIP_WINSIZE);
+		return true;
+	}
+
+	return (Z_OK == uncompress (window, &length, block->window, block->length))
+		&& (GZIP_WINSIZE == length);
+}
+
+GzipBlockData *
+GzipIndex::Pack (off64_t zin, int bits, unsigned int left, const unsigned char * window) {
+	// The window is circular; the oldest of its bytes start at the end of the output.
+	unsigned char flat[GZIP_WINSIZE];
+	if (left)
+		memcpy (flat, window + GZIP_WINSIZE - left, left);
+	if (left < GZIP_WINSIZE)
+		memcpy (flat + left, window, GZIP_WINSIZE - left);
+
+	// The fastest level is plenty for this; text windows shrink to a fraction.
+	unsigned char packed[GZIP_WINSIZE];
+	uLongf length = sizeof (packed);
+	bool deflated = (Z_OK == compress2 (packed, &length, flat, GZIP_WINSIZE, Z_BEST_SPEED))
+		&& (length < GZIP_WINSIZE);
+
+	GzipBlockData * block = GzipBlockNew (deflated ? length : GZIP_WINSIZE);
+	if (NULL == block)
+		return NULL;
 
-	GzipBlockData * block = (GzipBlockData *) malloc (sizeof (GzipBlockData)); 
-	
-	x->extra = block;
 	block->zin   = zin;
 	block->zbits = bits;
+	memcpy (block->window, deflated ? packed : flat, block->length);
+	return block;
+}
 
-	if (left)
-		memcpy (block->window, window + GZIP_WINSIZE - left, left);
-	else
-		memcpy (block->window + left, window, GZIP_WINSIZE - left);
+LookupTable *
+GzipIndex::Add (off64_t byte, off64_t line, off64_t zin, int bits, unsigned int left, unsigned char * window) {
+	GzipBlockData * block = Pack (zin, bits, left, window);
+
+	if (NULL == block)
+		return NULL;
+	if (NULL == this->Add (byte, line, block)) {
+		free (block);
+		return NULL;
+	}
+	return this->table;
+}
 
+LookupTable *
+GzipIndex::Add (off64_t byte, off64_t line, GzipBlockData * block) {
+	this->lock();
+
+	if (NULL == FileIndex::Add (byte, line)) {
+		this->unlock();
+		return NULL;
+	}
+
+	(this->table->list + this->table->have - 1)->extra = block;
 	this->unlock();
 	
 	return this->table;
@@ -65,13 +149,71 @@ GzipIndex::Relax (void) {
 	this->unlock();
 }
 
+/* Every access point is saved with its offsets and its (deflated) window, which the
+	header of a member does not have; the first mark, at the start of the file, has none
+	of them. */
+bool
+GzipIndex::SaveExtra (FILE * fp, const LineOffset * mark) {
+	GzipBlockData * block = (GzipBlockData *)mark->extra;
+	unsigned char point = (NULL != block);
+
+	if (1 != fwrite (&point, sizeof (point), 1, fp))
+		return false;
+	if (NULL == block)
+		return true;
+
+	return (1 == fwrite (&block->zin, sizeof (block->zin), 1, fp))
+		&& (1 == fwrite (&block->zbits, sizeof (block->zbits), 1, fp))
+		&& (1 == fwrite (&block->length, sizeof (block->length), 1, fp))
+		&& (0 == block->length || 1 == fwrite (block->window, block->length, 1, fp));
+}
+
+bool
+GzipIndex::LoadExtra (FILE * fp, LineOffset * mark) {
+	unsigned char point = 0;
+	off64_t zin = 0, zbits = 0;
+	unsigned int length = 0;
+
+	if (1 != fread (&point, sizeof (point), 1, fp))
+		return false;
+	if (0 == point)
+		return true;
+
+	if (1 != fread (&zin, sizeof (zin), 1, fp)
+		 || 1 != fread (&zbits, sizeof (zbits), 1, fp)
+		 || 1 != fread (&length, sizeof (length), 1, fp)
+		 || zbits < 0 || zbits > 7 || length > GZIP_WINSIZE)
+		return false;
+
+	GzipBlockData * block = GzipBlockNew (length);
+	if (NULL == (mark->extra = block))
+		return false;
+
+	block->zin = zin;
+	block->zbits = zbits;
+	return (0 == length || 1 == fread (block->window, length, 1, fp));
+}
+
+/* The bytes of the marks are uncompressed; only an access point says where
+	it is inside of the compressed file. */
+bool
+GzipIndex::Inside (const LineOffset * mark, const IndexStamp & stamp) const {
+	const GzipBlockData * block = (const GzipBlockData *)mark->extra;
+	return (NULL == block || (0 <= block->zin && block->zin <= stamp.size));
+}
+
 GnuzipDispatcher::GnuzipDispatcher (int e)
-	: AbstractFileDispatcher (e, new GzipIndex) {
+	: AbstractFileDispatcher (e, new GzipIndex), speculative (false) {
 }
 
 GnuzipDispatcher::~GnuzipDispatcher (void) {
 }
 
+void
+GnuzipDispatcher::setSpan (off64_t span) {
+	static_cast<GzipIndex *>(this->marks.get())->setSpan (span);
+}
+
 bool
 GnuzipDispatcher::Openfile (const std::string & filename) {
 	unsigned char gzheader[10];
@@ -101,23 +243,43 @@ GnuzipDispatcher::Openfile (const std::string & filename) {
 	// From Gzip RFC: http://www.gzip.org/zlib/rfc-gzip.html
 	if (0x1f != gzheader[0] || 0x8b != gzheader[1]) {
 		std::cerr << "Input file "<<filename<<" is not gzip formatted.\n";
+		FCLOSE (fp);
 		return false;
 	}
 
 	if (8 != gzheader[2]) {
 		std::cerr << "Input file "<<filename<<" uses compression method other than deflate.\n";
+		FCLOSE (fp);
 		return false;
 	}
 
 	// At this point we know that we have a gzip file that was compressed with the DEFLATE algorithm.
-	
+	FCLOSE (fp);
 	this->filename = filename;
+
+	// The access points of a file that was indexed (and closed) before, and has not
+	// changed since, are read back instead of inflating the whole file again.
+	if (false == this->indexpath.empty() && FileIndex::Stamp (filename, this->stamp) == true)
+		this->indexed = this->marks->Load (this->indexpath, this->stamp);
+	else
+		this->indexpath.clear();
+	
 	return true;
 }
 
 bool
 GnuzipDispatcher::Closefile (void) {
-	// STUB: Write out the file index to the end of the Gzip file on disk.
+	// The index is written out once the indexer has been through the whole file, and
+	// only if it did not come from the sidecar in the first place.
+	if (true == this->indexpath.empty() || true == this->indexed || false == this->marks->isFinished())
+		return true;
+
+	if (false == this->marks->Save (this->indexpath, this->stamp)) {
+		g_warning ("Failed saving the index of %s to %s", this->filename.c_str(), this->indexpath.c_str());
+		return false;
+	}
+
+	this->indexed = true;
 	return true;
 }
 
@@ -130,6 +292,8 @@ GnuzipDispatcher::Readline (off64_t start, off64_t N) {
 
 bool
 GnuzipDispatcher::Readoffset (off64_t start, off64_t N) {
+	GnuzipOffsetReader * reader = new GnuzipOffsetReader (this->filename, this->marks, start, N);
+	this->addWorker (reader);
 	return true;
 }
 
@@ -139,39 +303,220 @@ GnuzipDispatcher::Readpercent (float percent, off64_t N) {
 
 	this->marks->lock();
 
-	int index = this->marks->size() * ((int)(percent / 100));
+	// The access points are spread evenly over the uncompressed data.
+	int index = (int)(this->marks->size() * (percent / 100));
 	off64_t byte = this->marks->get(index)->byte;
 
 	this->marks->unlock();
-	/*
-	GnuzipOffsetReader * reader = new GnuzipOffsetReader (this->filename, byte, N);	
+
+	GnuzipOffsetReader * reader = new GnuzipOffsetReader (this->filename, this->marks, byte, N);	
 	this->addWorker (reader);
-	*/
 	return true;
 }
 
 void
 GnuzipDispatcher::Index (void) {
-	GnuzipBlockIndexer * indexer = new GnuzipBlockIndexer (this->filename, this->marks);
+	GnuzipBlockIndexer * indexer = new GnuzipBlockIndexer (this->filename, this->marks, this->speculative);
 	this->addWorker (indexer);
 }
 
 GnuzipFileWorker::GnuzipFileWorker (const std::string & filename, FileIndexPtr marks)
 	: AbstractFileWorker (filename, marks) {
 	this->fp = NULL;
+	this->zinit = this->zend = this->zraw = false;
 }
 
 GnuzipFileWorker::GnuzipFileWorker (const std::string & filename)
 	: AbstractFileWorker (filename) {
 	this->fp = NULL;
+	this->zinit = this->zend = this->zraw = false;
 }
 
 GnuzipFileWorker::~GnuzipFileWorker (void) {
+	if (true == this->zinit)
+		inflateEnd (&this->zstrm);
 }
 
 bool
-GnuzipFileWorker::InflateBlockAtOffset (off64_t offset, char * buf, size_t size) {
-	return false;
+GnuzipFileWorker::InflateBlockAtOffset (const LineOffset * point) {
+	GzipBlockData * block = (GzipBlockData *)point->extra;
+	int ret;
+
+	if (true == this->zinit)
+		inflateEnd (&this->zstrm);
+	this->zinit = this->zend = this->zraw = false;
+
+	memset (&this->zstrm, 0, sizeof (this->zstrm));
+	this->zstrm.zalloc = Z_NULL;
+	this->zstrm.zfree = Z_NULL;
+	this->zstrm.opaque = Z_NULL;
+	this->zstrm.next_in = Z_NULL;
+
+	// The start of the file, or of one of its members.
+	if (NULL == block || 0 == block->length) {
+		if (Z_OK != inflateInit2 (&this->zstrm, 47))
+			return false;
+		this->zinit = true;
+		return (0 == fseeko64 (this->fp, (NULL == block) ? 0 : block->zin, SEEK_SET));
+	}
+
+	// The access point is inside of a raw deflate stream, and may start in the middle
+	// of a byte; this was taken from zran.c as well.
+	if (Z_OK != inflateInit2 (&this->zstrm, -15))
+		return false;
+	this->zinit = this->zraw = true;
+
+	if (0 != fseeko64 (this->fp, block->zin - (block->zbits ? 1 : 0), SEEK_SET))
+		return false;
+
+	if (block->zbits) {
+		if (EOF == (ret = getc (this->fp)))
+			return false;
+		inflatePrime (&this->zstrm, block->zbits, ret >> (8 - block->zbits));
+	}
+
+	unsigned char window[GZIP_WINSIZE];
+	return GzipIndex::Window (block, window)
+		&& (Z_OK == inflateSetDictionary (&this->zstrm, window, GZIP_WINSIZE));
+}
+
+ssize_t
+GnuzipFileWorker::Inflate (char * buf, size_t size) {
+	int ret;
+
+	if (false == this->zinit || true == this->zend)
+		return 0;
+
+	this->zstrm.next_out = (unsigned char *)buf;
+	this->zstrm.avail_out = size;
+
+	do {
+		if (0 == this->zstrm.avail_in) {
+			this->zstrm.avail_in = fread (this->zinput, 1, GZIP_CHUNK, this->fp);
+			if (ferror (this->fp))
+				return -1;
+			if (0 == this->zstrm.avail_in) {
+				// The file was cut short; hand out whatever came before it.
+				this->zend = true;
+				break;
+			}
+			this->zstrm.next_in = this->zinput;
+		}
+
+		ret = inflate (&this->zstrm, Z_NO_FLUSH);
+
+		if (Z_NEED_DICT == ret || Z_DATA_ERROR == ret || Z_MEM_ERROR == ret)
+			return -1;
+		if (Z_STREAM_END == ret && false == this->NextMember()) {
+			this->zend = true;
+			break;
+		}
+	} while (0 != this->zstrm.avail_out);
+
+	return size - this->zstrm.avail_out;
+}
+
+bool
+GnuzipFileWorker::NextMember (void) {
+	// Inflating from an access point stops short of the member's trailer (the CRC and
+	// the length), which a gzip stream would have read itself.
+	for (int trailer = (this->zraw ? 8 : 0); trailer > 0; ) {
+		if (0 == this->zstrm.avail_in) {
+			if (0 == (this->zstrm.avail_in = fread (this->zinput, 1, GZIP_CHUNK, this->fp)))
+				return false;
+			this->zstrm.next_in = this->zinput;
+		}
+
+		uInt skip = MIN ((uInt)trailer, this->zstrm.avail_in);
+		this->zstrm.next_in += skip;
+		this->zstrm.avail_in -= skip;
+		trailer -= skip;
+	}
+
+	if (false == gzip_member_follows (this->fp, &this->zstrm, this->zinput, NULL))
+		return false;
+
+	if (false == this->zraw)
+		return (Z_OK == inflateReset (&this->zstrm));
+
+	// A raw stream can not be reset into a gzip one; where it was is kept.
+	z_stream zstrm = this->zstrm;
+
+	inflateEnd (&this->zstrm);
+	this->zinit = this->zraw = false;
+
+	memset (&this->zstrm, 0, sizeof (this->zstrm));
+	if (Z_OK != inflateInit2 (&this->zstrm, 47))
+		return false;
+
+	this->zinit = true;
+	this->zstrm.next_in = zstrm.next_in;
+	this->zstrm.avail_in = zstrm.avail_in;
+	this->zstrm.next_out = zstrm.next_out;
+	this->zstrm.avail_out = zstrm.avail_out;
+	return true;
+}
+
+bool
+GnuzipFileWorker::Readlines (off64_t skip, off64_t lines, off64_t N, std::string & window) {
+	char buf[GZIP_WINSIZE];
+	ssize_t bytes;
+
+	while (N > 0 && 0 < (bytes = this->Inflate (buf, sizeof (buf)))) {
+		const char * p = buf, * end = buf + bytes, * q;
+
+		if (false == this->isRunning())
+			return false;
+
+		if (skip > 0) {
+			off64_t k = MIN (skip, (off64_t)bytes);
+			p += k;
+			skip -= k;
+		}
+
+		for (; lines > 0 && p < end; lines--) {
+			if (NULL == (q = (const char *)memchr (p, '\n', end - p))) {
+				p = end;
+				break;
+			}
+			p = q + 1;
+		}
+
+		for (; N > 0 && p < end; N--) {
+			if (NULL == (q = (const char *)memchr (p, '\n', end - p))) {
+				window.append (p, end - p);
+				break;
+			}
+			window.append (p, q + 1 - p);
+			p = q + 1;
+		}
+	}
+
+	return (bytes >= 0);
+}
+
+bool
+GnuzipFileWorker::FindPoint (off64_t line, off64_t byte, LineOffset & point) {
+	bool found = false;
+
+	this->marks->lock();
+
+	// Marks without a line have not been indexed yet. A point in the middle of a line
+	// is only any good for the lines after it.
+	for (int index = 0; index < this->marks->size(); index++) {
+		LineOffset * mark = this->marks->get(index);
+
+		if (mark->line < 0)
+			break;
+		if (index > 0 && ((line >= 0 && mark->line >= line) || (byte >= 0 && mark->byte > byte)))
+			break;
+
+		point = *mark;
+		found = true;
+	}
+
+	this->marks->unlock();
+	return found;
 }
 
 bool
@@ -196,7 +541,8 @@ GnuzipFileWorker::Openfile (void) {
 
 void *
 GnuzipDispatcher::run (void * null) {
-	this->Index();
+	if (false == this->indexed)
+		this->Index();
 	
 	while (true == this->isRunning()) {
 		while (0 == this->inputQueue.size()) {
@@ -213,10 +559,12 @@ GnuzipDispatcher::run (void * null) {
 
 bool
 GnuzipFileWorker::Closefile (void) {
-	// This is important for compressed files: we must write our index at this point when we know that we are
-	// explicitly "closing" the file from our system. There can be no additional file handles open to the file
-	// on disk.
-	return false;
+	if (NULL == this->fp)
+		return false;
+
+	fclose (this->fp);
+	this->fp = NULL;
+	return true;
 }
 
 GnuzipLineReader::GnuzipLineReader (const std::string & filename, FileIndexPtr marks, off64_t start, off64_t N)
@@ -230,54 +578,695 @@ GnuzipLineReader::~GnuzipLineReader (void) {
 
 void *
 GnuzipLineReader::run (void * null) {
-	off64_t offset = 0, delta = 0, index = 0, line = -1, zin = -1;
-	off64_t read_max = this->marks->size(), line_max = this->startLine + read_max;
-	char buf[GZIP_CHUNK+1]; buf[GZIP_CHUNK] = 0;
+	LineOffset point;
+	std::string window;
 	
 	if (false == GnuzipFileWorker::Openfile ()) {
 		// STUB: Spawn some kind of worker that produces an error on the GUI.
 		g_critical ("Failed opening");
+		return NULL;
+	}
+
+	// Only the span after the access point is inflated; before the indexer gets to
+	// the line this is the last point that it has reached.
+	if (false == this->FindPoint (this->startLine, -1, point)
+		 || false == this->InflateBlockAtOffset (&point)
+		 || false == this->Readlines (0, this->startLine - point.line, this->numberOfLinesToRead, window)) {
+		// STUB: Throw some kind of exception or spawn something to tell the user in the GUI.
+		g_critical ("Failed inflating line %lld of %s", (long long)this->startLine, this->filename.c_str());
 		goto thread_teardown;
 	}
+
+	if (window.length() > 0)
+		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (window);
+	this->dispatcher->removeWorker (this);
+
+ thread_teardown:
+	this->Closefile();
+	return NULL;
+}
+
+GnuzipOffsetReader::GnuzipOffsetReader (const std::string & filename, FileIndexPtr marks, off64_t offset, off64_t N)
+	: GnuzipFileWorker (filename, marks) {
+	this->numberOfLinesToRead = N;
+	this->startOffset = offset;
+}
+
+GnuzipOffsetReader::~GnuzipOffsetReader (void) {
+}
+
+void *
+GnuzipOffsetReader::run (void * null) {
+	LineOffset point;
+	std::string window;
 	
-	this->marks->lock();
+	if (false == GnuzipFileWorker::Openfile ()) {
+		g_critical ("Failed opening");
+		return NULL;
+	}
+
+	// The offset is into the uncompressed data; like the plaintext reader this starts
+	// with the (next) line after it.
+	if (false == this->FindPoint (-1, this->startOffset, point)
+		 || false == this->InflateBlockAtOffset (&point)
+		 || false == this->Readlines (this->startOffset - point.byte, 1, this->numberOfLinesToRead, window)) {
+		g_critical ("Failed inflating offset %lld of %s", (long long)this->startOffset, this->filename.c_str());
+		goto thread_teardown;
+	}
+
+	if (window.length() > 0)
+		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (window);
+	this->dispatcher->removeWorker (this);
+
+ thread_teardown:
+	this->Closefile();
+	return NULL;
+}
+
+/* The n (at most 16) bits of a deflate stream from bit at on; they go from the low bit of
+	each byte to its high one. */
+static inline unsigned int
+deflate_bits (const unsigned char * p, size_t at, int n) {
+	const unsigned char * q = p + (at >> 3);
+	return ((q[0] | (q[1] << 8) | (q[2] << 16)) >> (at & 7)) & ((1U << n) - 1);
+}
+
+/* Whether code lengths make a prefix code that zlib takes: a complete one, or else (but
+	for the code length code) a single code of one bit. */
+static bool
+deflate_code (const unsigned char * lengths, int n, bool code_lengths) {
+	int count[16] = { 0 }, left = 1, max = 0;
+
+	for (int ii = 0; ii < n; ii++) {
+		count[lengths[ii]]++;
+		max = MAX (max, (int)lengths[ii]);
+	}
+
+	for (int len = 1; len < 16; len++) {
+		left = (left << 1) - count[len];
+		if (left < 0)
+			return false;
+	}
+
+	return (0 == left) || (false == code_lengths && 1 == max && 1 == count[1]);
+}
+
+/* Whether a block (that is not the last one) could start at bit at. A stored block has
+	zeroes up to the next byte and then a length along with its complement; a block with
+	dynamic codes has to have its counts in range, and all three of its codes have to be
+	ones that zlib would take. This reads at most DEFLATE_HEADER bytes. */
+#define DEFLATE_HEADER 1024
+
+static bool
+deflate_block_header (const unsigned char * p, size_t at) {
+	static const unsigned char order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	unsigned char lengths[320], codes[19] = { 0 }, sorted[19];
+	int count[8] = { 0 }, offset[8] = { 0 };
+	unsigned int hlit, hdist, hclen, n = 0;
+
+	if (0 == deflate_bits (p, at, 3)) {
+		size_t pad = (8 - ((at + 3) & 7)) & 7;
+		const unsigned char * q = p + ((at + 3 + pad) >> 3);
+
+		return (0 == deflate_bits (p, at + 3, pad)) && (q[0] == (q[2] ^ 0xff)) && (q[1] == (q[3] ^ 0xff));
+	}
+
+	if (4 != deflate_bits (p, at, 3))
+		return false;
+
+	hlit = deflate_bits (p, at + 3, 5) + 257;
+	hdist = deflate_bits (p, at + 8, 5) + 1;
+	hclen = deflate_bits (p, at + 13, 4) + 4;
+	at += 17;
+
+	if (hlit > 286 || hdist > 30)
+		return false;
+
+	for (unsigned int ii = 0; ii < hclen; ii++, at += 3)
+		codes[order[ii]] = deflate_bits (p, at, 3);
+	if (false == deflate_code (codes, 19, true))
+		return false;
+
+	// The code length code is canonical; its symbols go in order of their lengths.
+	for (int ii = 0; ii < 19; ii++)
+		count[codes[ii]]++;
+	for (int len = 1; len < 7; len++)
+		offset[len + 1] = offset[len] + count[len];
+	for (int ii = 0; ii < 19; ii++) {
+		if (codes[ii])
+			sorted[offset[codes[ii]]++] = ii;
+	}
+
+	while (n < hlit + hdist) {
+		int code = 0, first = 0, index = 0, symbol = -1, repeat = 0;
+		unsigned char value = 0;
+
+		for (int len = 1; len < 8 && symbol < 0; len++, at++) {
+			code |= deflate_bits (p, at, 1);
+			if (code - first < count[len])
+				symbol = sorted[index + code - first];
+			index += count[len];
+			first = (first + count[len]) << 1;
+			code <<= 1;
+		}
+
+		if (symbol < 16)
+			lengths[n++] = symbol;
+		else {
+			if (16 == symbol) {
+				if (0 == n)
+					return false;
+				value = lengths[n - 1];
+				repeat = 3 + deflate_bits (p, at, 2);
+				at += 2;
+			}
+			else if (17 == symbol) {
+				repeat = 3 + deflate_bits (p, at, 3);
+				at += 3;
+			}
+			else {
+				repeat = 11 + deflate_bits (p, at, 7);
+				at += 7;
+			}
+
+			if (n + repeat > hlit + hdist)
+				return false;
+			while (repeat--)
+				lengths[n++] = value;
+		}
+	}
+
+	// A block without an end to it could not be one.
+	return (0 != lengths[256])
+		&& deflate_code (lengths, hlit, false)
+		&& deflate_code (lengths + hlit, hdist, false);
+}
+
+/* An access point at a block boundary, given in bits, out of a flat window. */
+static GzipBlockData *
+deflate_block_point (off64_t bit, const std::string & window) {
+	off64_t zin = (bit + 7) >> 3;
+
+	if (GZIP_WINSIZE != window.size())
+		return NULL;
+	return GzipIndex::Pack (zin, (int)((zin << 3) - bit), 0, (const unsigned char *)window.data());
+}
+
+GnuzipRangeScanner::GnuzipRangeScanner (const std::string & filename,
+													 GzipIndexPtr index,
+													 concurrent::IRunnable * owner,
+													 off64_t begin,
+													 off64_t end,
+													 off64_t span,
+													 bool bgzf)
+	: filename (filename), index (index), owner (owner), begin (begin), end (end), span (span),
+	  bgzf (bgzf), exact (false), blocks (false), raw (false), first (-1), upto (-1), last (-1), header (false),
+	  bytes (0), lines (0), partial (false), eof (false), done (false) {
+}
+
+GnuzipRangeScanner::~GnuzipRangeScanner (void) {
+	this->Reset();
+}
+
+void
+GnuzipRangeScanner::Reset (void) {
+	// Points that were handed to the index no longer belong to the scanner.
+	for (size_t ii = 0; ii < this->points.size(); ii++) {
+		if (NULL != this->points[ii].extra)
+			free (this->points[ii].extra);
+	}
+
+	this->points.clear();
+	this->markers.clear();
+	this->pending.clear();
+	this->tail.clear();
+	this->last = -1;
+	this->bytes = this->lines = 0;
+	this->partial = this->eof = this->header = false;
+}
+
+bool
+GnuzipRangeScanner::Point (off64_t byte, off64_t line, GzipBlockData * block) {
+	LineOffset point = { byte, line, block };
+
+	if (NULL == block)
+		return false;
+
+	if (!this->index) {
+		this->points.push_back (point);
+		return true;
+	}
+
+	if (NULL == this->index->Add (byte, line, block)) {
+		free (block);
+		return false;
+	}
+
+	this->index->setLines (line);
+	return true;
+}
+
+void
+GnuzipRangeScanner::Fill (std::string & flat, off64_t offset, const std::string & window) {
+	off64_t from = offset - GZIP_WINSIZE;
+
+	// The start of a window that goes back past the range is the window before it.
+	if (from < 0)
+		flat.replace (0, -from, window, offset, -from);
+
+	Marker marker = { MAX (from, (off64_t)0), 0 };
+	std::vector<Marker>::iterator it =
+		std::lower_bound (this->markers.begin(), this->markers.end(), marker, Marker::Before);
+
+	for (; it != this->markers.end() && it->offset < offset; ++it)
+		flat[it->offset - from] = window[it->source];
+}
+
+bool
+GnuzipRangeScanner::Resolve (const std::string & window) {
+	off64_t count = 0;
+	size_t next = 0;
+
+	if (false == this->raw || false == this->dictionary.empty())
+		return true;
+	if (GZIP_WINSIZE != window.size())
+		return false;
+
+	// A marker was counted as the low byte of its source; each point is put right by
+	// the markers before it.
+	for (size_t ii = 0; ii <= this->points.size(); ii++) {
+		off64_t before = (ii < this->points.size()) ? this->points[ii].byte : this->bytes;
+
+		for (; next < this->markers.size() && this->markers[next].offset < before; next++) {
+			uint16_t source = this->markers[next].source;
+			count += ('\n' == window[source]) - ('\n' == (source & 0xff));
+		}
+
+		if (ii < this->points.size())
+			this->points[ii].line += count;
+	}
+
+	this->lines += count;
+	if (false == this->markers.empty() && this->markers.back().offset == this->bytes - 1)
+		this->partial = ('\n' != window[this->markers.back().source]);
+
+	for (size_t ii = 0; ii < this->pending.size(); ii++) {
+		Pending & wait = this->pending[ii];
+
+		this->Fill (wait.window, this->points[wait.point].byte, window);
+		if (NULL == (this->points[wait.point].extra =
+						 GzipIndex::Pack (wait.zin, wait.bits, 0, (const unsigned char *)wait.window.data())))
+			return false;
+	}
+
+	this->Fill (this->tail, this->bytes, window);
+	this->pending.clear();
+	this->markers.clear();
+	return true;
+}
+
+off64_t
+GnuzipRangeScanner::Find (FILE * fp, off64_t from, unsigned char * input) {
+	const size_t HEADER = 14;
+	size_t bytes = 0;
+
+	from = (from + 7) >> 3;
+
+	while ((from << 3) < this->end && true == this->owner->isRunning()) {
+		if (0 != fseeko64 (fp, from, SEEK_SET) || 0 == (bytes = fread (input, 1, GZIP_CHUNK, fp)))
+			return -1;
+
+		const unsigned char * p = input, * stop = input + bytes;
+
+		while (NULL != (p = (const unsigned char *)memchr (p, 0x1f, stop - p))) {
+			if ((from + (p - input)) << 3 >= this->end)
+				return -1;
+
+			// A header that runs past the chunk is looked at again from the next one.
+			if ((size_t)(stop - p) < HEADER && GZIP_CHUNK == bytes)
+				break;
+			if (true == gzip_member_header (p, stop - p, this->bgzf))
+				return (from + (p - input)) << 3;
+			p++;
+		}
+
+		from += (NULL == p) ? bytes : (p - input);
+	}
+
+	return -1;
+}
+
+off64_t
+GnuzipRangeScanner::FindBlock (FILE * fp, off64_t from, unsigned char * input) {
+	const size_t HEADER = DEFLATE_HEADER;
+	size_t bytes = 0;
+
+	while (from < this->end && true == this->owner->isRunning()) {
+		off64_t byte = from >> 3;
 
-	// If the value is marked as a negative one then we have not indexed it yet. Thus
-	// we should exit now and begin our inflating at this block. 
-	while (-1 != (line = this->marks->get(index)->line)) {
-		if (line_max < line) {
-			delta = this->startLine - line;
-			offset = this->marks->get(index)->byte;
-			zin = ((GzipBlockData *)this->marks->get(index)->extra)->zin;
+		if (0 != fseeko64 (fp, byte, SEEK_SET) || HEADER > (bytes = fread (input, 1, GZIP_CHUNK, fp)))
+			return -1;
+
+		// Every bit that a whole header fits after is a start.
+		size_t at = from & 7, stop = (bytes - HEADER + 1) << 3;
+
+		for (; at < stop; at++) {
+			if ((byte << 3) + (off64_t)at >= this->end)
+				return -1;
+			if (false == deflate_block_header (input, at))
+				continue;
+
+			// The zeroes in front of a stored block make it start just as well at any bit
+			// up to the last one that leaves room for its type before the length.
+			this->upto = (byte << 3) + at;
+			if (0 == deflate_bits (input, at, 3))
+				this->upto = (byte << 3) + ((at + 10) & ~(size_t)7) - 3;
+			return (byte << 3) + at;
+		}
+
+		from = (byte << 3) + stop;
+	}
+
+	return -1;
+}
+
+int
+GnuzipRangeScanner::Scan (FILE * fp, off64_t from, unsigned char * input, unsigned char * window) {
+	z_stream zstrm[2];
+	unsigned char * windows[2] = { window, window + GZIP_WINSIZE };
+	off64_t fpos = from >> 3, mark = 0, stop = -1;
+	bool raw = this->raw, speculative = (true == this->raw && true == this->dictionary.empty());
+	int ret = Z_OK, members = 0, streams = 1, ch = 0;
+
+	// Without the window before a block, there are two streams until it is not needed.
+	if (true == speculative)
+		streams = 2;
+
+	if (0 != fseeko64 (fp, fpos, SEEK_SET))
+		return -1;
+	if (true == raw && (from & 7)) {
+		if (EOF == (ch = getc (fp)))
+			return -1;
+		fpos++;
+	}
+
+	memset (zstrm, 0, sizeof (zstrm));
+	for (int ii = 0; ii < streams; ii++) {
+		if (Z_OK != inflateInit2 (&zstrm[ii], raw ? -15 : 47)) {
+			while (--ii >= 0)
+				inflateEnd (&zstrm[ii]);
+			return -1;
+		}
+	}
+
+	if (true == raw) {
+		unsigned char dictionary[GZIP_WINSIZE];
+
+		// The low byte of each position, and the low byte plus the high one plus one; the
+		// two never match, and a byte that did come out of the window gives both back.
+		for (int ii = 0; ii < streams; ii++) {
+			for (unsigned int jj = 0; true == speculative && jj < GZIP_WINSIZE; jj++)
+				dictionary[jj] = (0 == ii) ? (jj & 0xff) : (((jj & 0xff) + (jj >> 8) + 1) & 0xff);
+
+			if (from & 7)
+				inflatePrime (&zstrm[ii], 8 - (from & 7), ch >> (from & 7));
+
+			inflateSetDictionary (&zstrm[ii],
+										 speculative ? dictionary : (const unsigned char *)this->dictionary.data(),
+										 GZIP_WINSIZE);
+		}
+
+		// The output window starts out as the window before the range, if it is known.
+		if (false == speculative)
+			memcpy (windows[0], this->dictionary.data(), GZIP_WINSIZE);
+		zstrm[0].avail_out = 0;
+	}
+	else {
+		// Readers can always start at the first member of the range.
+		GzipBlockData * header = GzipBlockNew (0);
+		if (NULL != header) {
+			header->zin = fpos;
+			header->zbits = 0;
+		}
+		if (false == this->Point (0, 0, header)) {
+			inflateEnd (&zstrm[0]);
+			return -1;
+		}
+	}
+
+	// The below code has been taken from Mark Adler's Zlib Random Access code found in the
+	// example zran.c within the Zlib distribution. This builds a random access index from
+	// compressed blocks of a Gzip file; a point is taken at a block boundary every span
+	// of output, and at the header of a member if that comes first.
+	while (true) {
+		if (0 == zstrm[0].avail_in) {
+			if (false == this->owner->isRunning()) {
+				ret = Z_ERRNO;
+				break;
+			}
+
+			// The file was cut short in the middle of a member.
+			if (0 == (zstrm[0].avail_in = fread (input, 1, GZIP_CHUNK, fp)) || ferror (fp)) {
+				ret = Z_DATA_ERROR;
+				break;
+			}
+
+			fpos += zstrm[0].avail_in;
+			for (int ii = 0; ii < streams; ii++) {
+				zstrm[ii].next_in = input;
+				zstrm[ii].avail_in = zstrm[0].avail_in;
+			}
+		}
+
+		if (0 == zstrm[0].avail_out) {
+			for (int ii = 0; ii < streams; ii++) {
+				zstrm[ii].avail_out = GZIP_WINSIZE;
+				zstrm[ii].next_out = windows[ii];
+			}
+		}
+
+		size_t produced = zstrm[0].next_out - windows[0];
+		ret = inflate (&zstrm[0], Z_BLOCK);
+
+		// The same stream against another dictionary takes the very same steps.
+		for (int ii = 1; ii < streams; ii++) {
+			if (ret != inflate (&zstrm[ii], Z_BLOCK) || zstrm[ii].avail_out != zstrm[0].avail_out)
+				ret = Z_DATA_ERROR;
+		}
+
+		size_t length = (zstrm[0].next_out - windows[0]) - produced;
+		if (length > 0) {
+			const unsigned char * out = windows[0] + produced, * other = windows[1] + produced;
+
+			for (size_t jj = 0; 2 == streams && jj < length; jj++) {
+				if (out[jj] != other[jj]) {
+					Marker marker = { this->bytes + (off64_t)jj,
+											(uint16_t)(out[jj] | (((other[jj] - out[jj] - 1) & 0xff) << 8)) };
+					this->markers.push_back (marker);
+				}
+			}
+
+			// Every access point knows how many lines come before it.
+			this->bytes += length;
+			this->lines += CountNewlines (out, length);
+			this->partial = ('\n' != out[length - 1]);
+		}
+
+		if (Z_NEED_DICT == ret)
+			ret = Z_DATA_ERROR;
+		if (ret < 0 && Z_BUF_ERROR != ret)
 			break;
+
+		// Once the last 32K of output did not come out of the window, the rest of it
+		// can not either.
+		if (2 == streams && this->bytes > GZIP_WINSIZE
+			 && (true == this->markers.empty() || this->markers.back().offset < this->bytes - GZIP_WINSIZE)) {
+			inflateEnd (&zstrm[1]);
+			streams = 1;
+		}
+		else if (2 == streams && (off64_t)this->markers.size() > GZIP_MARKERS_MAX) {
+			ret = Z_BUF_ERROR;
+			break;
+		}
+
+		off64_t zin = fpos - zstrm[0].avail_in;
+
+		if (Z_STREAM_END == ret) {
+			members++;
+
+			// A raw stream stops short of the member's trailer.
+			for (int trailer = (raw ? 8 : 0); trailer > 0; ) {
+				if (0 == zstrm[0].avail_in) {
+					if (0 == (zstrm[0].avail_in = fread (input, 1, GZIP_CHUNK, fp)))
+						break;
+					fpos += zstrm[0].avail_in;
+					zstrm[0].next_in = input;
+				}
+
+				uInt skip = MIN ((uInt)trailer, zstrm[0].avail_in);
+				zstrm[0].next_in += skip;
+				zstrm[0].avail_in -= skip;
+				trailer -= skip;
+			}
+			zin = fpos - zstrm[0].avail_in;
+
+			// The next member does not depend on anything before it.
+			if (2 == streams) {
+				inflateEnd (&zstrm[1]);
+				streams = 1;
+			}
+
+			// The members go on past the end of the range until one of them ends.
+			stop = zin << 3;
+			if (false == gzip_member_follows (fp, &zstrm[0], input, &fpos)) {
+				this->eof = true;
+				break;
+			}
+			if (stop >= this->end) {
+				this->header = true;
+				break;
+			}
+
+			if (true == raw) {
+				z_stream next = zstrm[0];
+
+				inflateEnd (&zstrm[0]);
+				memset (&zstrm[0], 0, sizeof (zstrm[0]));
+				if (Z_OK != inflateInit2 (&zstrm[0], 47)) {
+					ret = Z_MEM_ERROR;
+					break;
+				}
+
+				zstrm[0].next_in = next.next_in;
+				zstrm[0].avail_in = next.avail_in;
+				zstrm[0].next_out = next.next_out;
+				zstrm[0].avail_out = next.avail_out;
+				raw = false;
+			}
+			else if (Z_OK != inflateReset (&zstrm[0])) {
+				ret = Z_MEM_ERROR;
+				break;
+			}
+
+			if (this->bytes - mark > this->span) {
+				GzipBlockData * header = GzipBlockNew (0);
+
+				if (NULL != header) {
+					header->zin = zin;
+					header->zbits = 0;
+				}
+				if (false == this->Point (this->bytes, this->lines, header)) {
+					ret = Z_MEM_ERROR;
+					break;
+				}
+				mark = this->bytes;
+			}
+		}
+		else if ((zstrm[0].data_type & 128) && !(zstrm[0].data_type & 64)) {
+			off64_t bit = (zin << 3) - (zstrm[0].data_type & 7);
+
+			// A range that is put together block by block stops at the first block past it.
+			if (true == this->blocks && bit >= this->end) {
+				ret = Z_STREAM_END;
+				stop = bit;
+				break;
+			}
+
+			if (this->bytes - mark > this->span) {
+				int bits = zstrm[0].data_type & 7;
+				unsigned int left = zstrm[0].avail_out;
+
+				// A window with markers in it (or that goes back past a speculative
+				// range) is packed once they have been resolved.
+				if (true == speculative && (this->bytes < GZIP_WINSIZE || (false == this->markers.empty()
+																							  && this->markers.back().offset >= this->bytes - GZIP_WINSIZE))) {
+					LineOffset point = { this->bytes, this->lines, NULL };
+					Pending wait = { this->points.size(), zin, bits, std::string() };
+
+					wait.window.assign ((const char *)windows[0] + GZIP_WINSIZE - left, left);
+					wait.window.append ((const char *)windows[0], GZIP_WINSIZE - left);
+					this->points.push_back (point);
+					this->pending.push_back (wait);
+				}
+				else if (false == this->Point (this->bytes, this->lines, GzipIndex::Pack (zin, bits, left, windows[0]))) {
+					ret = Z_MEM_ERROR;
+					break;
+				}
+				mark = this->bytes;
+			}
 		}
-		index++;
 	}
 
-	this->marks->unlock();
+	unsigned int left = zstrm[0].avail_out;
+	for (int ii = 0; ii < streams; ii++)
+		inflateEnd (&zstrm[ii]);
 
-	// The Line Indexer has not reached this point yet. Since we have no way of knowing
-	// how much further needs to be indexed (or we could do it) just pull out.
-	if (-1 == line || -1 == zin) {
-		// STUB: Throw some kind of exception or spawn something to tell the user in the GUI.
-		goto thread_teardown;
+	if (Z_STREAM_END != ret)
+		return (0 == members && Z_DATA_ERROR == ret) ? 0 : -1;
+
+	this->last = stop;
+
+	// The window is circular; the oldest of its bytes start at the end of the output.
+	this->tail.assign ((const char *)windows[0] + GZIP_WINSIZE - left, left);
+	this->tail.append ((const char *)windows[0], GZIP_WINSIZE - left);
+	return 1;
+}
+
+void *
+GnuzipRangeScanner::run (void * null) {
+	off64_t from = this->begin;
+	FILE * fp = NULL;
+	int ret = 0;
+
+	if (true == this->raw && false == this->dictionary.empty() && GZIP_WINSIZE != this->dictionary.size())
+		return NULL;
+
+	if (NULL == (fp = FOPEN (this->filename.c_str(), "rb"))) {
+		g_critical ("Failed opening file descriptor in gzip range scanner");
+		return NULL;
 	}
-	
-	// At this point we will inflate each block at will, count the number of lines until
-	// we reach the one we're looking for.
-	while (delta > 0) {
 
-		if (false == InflateBlockAtOffset (zin, buf, GZIP_CHUNK)) {
+	unsigned char * input = new unsigned char[GZIP_CHUNK];
+	unsigned char * window = new unsigned char[3 * GZIP_WINSIZE];
+
+	memset (window, 0, 3 * GZIP_WINSIZE);
+
+	// Anything that looks like a header could just as well be compressed data. One is
+	// only taken once a whole member inflates from it (and its CRC checks out), and a
+	// block once it inflates without an error; the indexer has the final word on both.
+	while (true == this->owner->isRunning()) {
+		if (false == this->exact) {
+			from = (true == this->raw) ? this->FindBlock (fp, from, input) : this->Find (fp, from, input);
+
+			if (from < 0) {
+				this->done = true;
+				break;
+			}
+		}
+
+		this->first = from;
+		if (false == this->raw || true == this->exact)
+			this->upto = from;
+		if (1 == (ret = this->Scan (fp, from, input, window))) {
+			this->done = true;
 			break;
 		}
+
+		this->Reset();
+		this->first = this->upto = -1;
+		if (0 != ret || true == this->exact)
+			break;
+		from += (true == this->raw) ? 1 : 8;
 	}
 
- thread_teardown:
+	delete [] window;
+	delete [] input;
+	FCLOSE (fp);
 	return NULL;
 }
 
-GnuzipBlockIndexer::GnuzipBlockIndexer (const std::string & filename, FileIndexPtr marks)
-	: GnuzipFileWorker (filename, marks) {
+GnuzipBlockIndexer::GnuzipBlockIndexer (const std::string & filename, FileIndexPtr marks, bool speculative)
+	: GnuzipFileWorker (filename, marks), speculative (speculative) {
 }
 
 GnuzipBlockIndexer::~GnuzipBlockIndexer (void) {
@@ -286,119 +1275,156 @@ GnuzipBlockIndexer::~GnuzipBlockIndexer (void) {
 void *
 GnuzipBlockIndexer::run (void * null) {
 	GzipIndexPtr index = std::tr1::dynamic_pointer_cast <GzipIndex> (this->marks);
-	double ms;
+	std::vector<GnuzipRangeScanner *> scanners, repairs;
+	GnuzipRangeScanner * scanner = NULL;
+	unsigned char gzheader[14];
 	struct timeval start, end;
-	int ret;
-	off64_t total_in = 0, total_out = 0, last = 0;
-	LookupTable * table = NULL;
-	z_stream zstrm;
-	unsigned char input[GZIP_CHUNK];
-	unsigned char window[GZIP_WINSIZE];
+	std::string tail;
+	off64_t size = 0, expect = 0, bytes = 0, lines = 0;
+	bool partial = false, done = false, bgzf = false, blocks = false, header = true;
+	size_t next = 0, joined = 0;
+	int ranges = 1;
+	double ms;
 	
 	if (false == GnuzipFileWorker::Openfile()) {
 		std::cerr << "Failed opening file descriptor in gz line indexer\n";
 		return NULL;
 	}
 
-	// Iniitalize the z_stream struct and inflate
-	zstrm.zalloc = Z_NULL;
-	zstrm.zfree = Z_NULL;
-	zstrm.opaque = Z_NULL;
-	zstrm.avail_in = 0;
-	zstrm.avail_out = 0;
-	zstrm.next_in = Z_NULL;
+	// A BGZF file says so in the extra field of every one of its members.
+	bgzf = (sizeof (gzheader) == fread (gzheader, 1, sizeof (gzheader), this->fp))
+		&& gzip_member_header (gzheader, sizeof (gzheader), true);
 
-	if (Z_OK != (ret = inflateInit2 (&zstrm, 47)))
-		return NULL;
+	// Otherwise the ranges can be put together at deflate blocks instead of members.
+	blocks = (true == this->speculative && false == bgzf);
+
+	FSEEK_END (this->fp);
+	size = FTELL (this->fp);
+
+	// One range per core, as long as they stay large enough to be worth a thread.
+	ranges = MIN ((off64_t)sysconf (_SC_NPROCESSORS_ONLN), size / GZIP_RANGE_MIN);
+	ranges = CLAMP (ranges, 1, GZIP_THREADS_MAX);
 
 	std::cout << "index starting..." << std::flush;
 	
 	gettimeofday (&start, NULL);
 
-	// The below code has been taken from Mark Adler's Zlib Random Access code found in the
-	// example zran.c within the Zlib distribution. This builds a random access index from
-	// compressed blocks of a Gzip file. The size of the index is determined by the number
-	// of reset points inside of a Gzip file.
-	// Mark explains this much better than I could in the Zlib zran.c header comments.
-	do {
-		while (!this->marks || false == this->marks->trylock()) {
-			if (false == this->isRunning())
-				goto thread_teardown;
-			Thread::sleep(1);
+	// Every member of a gzip file (a file that was concatenated together, or a BGZF one)
+	// inflates on its own, so each range of the file is indexed on its own thread. A
+	// file with only the one member is indexed by the first range, as before, unless
+	// the others are to guess where its deflate blocks start.
+	for (int ii = 0; ii < ranges; ii++) {
+		scanner = new GnuzipRangeScanner (this->filename,
+													 (0 == ii) ? index : GzipIndexPtr(),
+													 this,
+													 ((size * ii) / ranges) << 3,
+													 ((size * (ii + 1)) / ranges) << 3,
+													 index->getSpan(),
+													 bgzf);
+		if (true == blocks)
+			scanner->setBlocks (0 != ii);
+		if (0 == ii)
+			scanner->setExact (false);
+
+		scanners.push_back (scanner);
+		scanner->start();
+	}
+
+	// The ranges are put together in order. Each one has to start where the one before
+	// it stopped; if none did (it was fooled by something that looked like a header or
+	// a block) the stretch in between is inflated here, from what came before it.
+	while (true == this->isRunning()) {
+		scanner = NULL;
+
+		for (; next < scanners.size(); next++) {
+			for (; joined <= next; joined++)
+				scanners[joined]->join();
+
+			if (0 == next && false == scanners[next]->done)
+				break;
+			if (true == scanners[next]->done && scanners[next]->first <= expect && expect <= scanners[next]->upto
+				 && scanners[next]->isRaw() == !header) {
+				scanner = scanners[next++];
+				break;
+			}
+			if (scanners[next]->first > expect)
+				break;
 		}
-		
-		if (0 == (zstrm.avail_in = fread (input, 1, GZIP_CHUNK, this->fp))) {
-			ret = Z_DATA_ERROR;
-			this->marks->unlock();
-			goto thread_teardown;
+
+		if (NULL == scanner) {
+			if (0 == next)
+				break;
+
+			scanner = new GnuzipRangeScanner (this->filename, GzipIndexPtr(), this, expect,
+														 (next < scanners.size()) ? scanners[next]->first : (size << 3),
+														 index->getSpan(), bgzf);
+			if (true == blocks)
+				scanner->setBlocks (false);
+			scanner->setExact (!header, tail);
+
+			repairs.push_back (scanner);
+			scanner->run (NULL);
+
+			if (false == scanner->done)
+				break;
 		}
 
-		if (ferror (this->fp)) {
-			ret = Z_ERRNO;
-			this->marks->unlock();
-			goto thread_teardown;
+		// A range that starts in the middle of a member gets a point of its own, and
+		// whatever it inflated before it had a window of its own is filled in.
+		if (true == scanner->isRaw()) {
+			if (false == scanner->Resolve (tail)
+				 || NULL == index->Add (bytes, lines, deflate_block_point (expect, tail)))
+				break;
 		}
 
-		zstrm.next_in = input;
+		size_t added = 0;
+		for (; added < scanner->points.size(); added++) {
+			LineOffset * point = &scanner->points[added];
 
-		// Process all of the data that was just read in from [this->fp]
-		do {
-				if (0 == zstrm.avail_out) {
-				zstrm.avail_out = GZIP_WINSIZE;
-				zstrm.next_out = window;
-			}
+			if (NULL == index->Add (bytes + point->byte, lines + point->line, (GzipBlockData *)point->extra))
+				break;
+			point->extra = NULL;
+		}
+		if (added < scanner->points.size())
+			break;
 
-			total_in += zstrm.avail_in;
-			total_out += zstrm.avail_out;
+		bytes += scanner->bytes;
+		lines += scanner->lines;
+		if (scanner->bytes > 0)
+			partial = scanner->partial;
+		index->setLines (lines);
 
-			if (Z_NEED_DICT == (ret = inflate (&zstrm, Z_BLOCK))) {
-				ret = Z_DATA_ERROR;
-			}
-			else if (Z_MEM_ERROR == ret || Z_DATA_ERROR == ret) {
-				this->marks->unlock();
-				goto thread_teardown;
-			}
-			else if (Z_STREAM_END == ret)
-				break;
+		expect = scanner->last;
+		header = scanner->header;
+		tail = scanner->tail;
+		if (true == (done = scanner->eof))
+			break;
+	}
 
-			total_in -= zstrm.avail_in;
-			total_out -= zstrm.avail_out;
-			
-			if ((zstrm.data_type & 128) && !(zstrm.data_type & 64) &&
-				 (0 == total_out || (total_out - last > GZIP_SPAN))) {
-				// Add the point to our GzipFileIndex which will in turn do all the fancy things underneath.
-				table = index->Add (total_out,
-										  -1,
-										  total_in,
-										  zstrm.data_type & 7,
-										  zstrm.avail_out,
-										  window);
-				if (NULL == table) {
-					ret = Z_MEM_ERROR;
-					this->marks->unlock();
-					goto thread_teardown;
-				}
-				
-				last = total_out;
-			}
-		} while (zstrm.avail_in != 0);
+	// Whatever was not put together is waited for (and thrown away).
+	for (size_t ii = 0; ii < scanners.size(); ii++) {
+		if (ii >= joined)
+			scanners[ii]->join();
+		delete scanners[ii];
+	}
+	for (size_t ii = 0; ii < repairs.size(); ii++)
+		delete repairs[ii];
 
-		this->marks->unlock();
-		
-	} while (ret != Z_STREAM_END);
+	if (false == done) {
+		std::cerr << "Failed indexing!\n";
+		goto thread_teardown;
+	}
 	
 	gettimeofday (&end, NULL);
 
 	ms = ((((end.tv_sec-start.tv_sec) * 1000) + ((end.tv_usec-start.tv_usec)/1000.0)) + 0.5);
-	std::cout<<"ready (ms:"<<ms<<")!\n"<<std::flush;
+	std::cout<<"ready (ms:"<<ms<<", ranges:"<<ranges<<(bgzf ? ", bgzf" : "")<<(blocks ? ", speculative" : "")<<")!\n"<<std::flush;
 
+	index->setLines (partial ? lines + 1 : lines);
 	index->Relax();
-	inflateEnd (&zstrm);
-	return NULL;
-	
+	index->setFinished (true);
+
  thread_teardown:
-	std::cerr << "Failed indexing!\n";
-	inflateEnd (&zstrm);
+	this->Closefile();
 	return NULL;
 }
-
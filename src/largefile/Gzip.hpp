@@ -22,7 +22,9 @@
 #include "FileIndex.hpp"
 #include "FileWorker.hpp"
 #include "FileDispatcher.hpp"
+#include <concurrent/Thread.hpp>
 #include <tr1/memory>
+#include <vector>
 #include <zlib.h>
 
 namespace largefile {
@@ -30,12 +32,29 @@ namespace largefile {
 #define GZIP_SPAN 1048576L
 #define GZIP_WINSIZE 32768U
 #define GZIP_CHUNK 16384
+
+	/// The gzip indexer splits a file into at most this many ranges of compressed
+	/// bytes, one thread apiece, and never into ranges smaller than the minimum.
+#define GZIP_THREADS_MAX 16
+#define GZIP_RANGE_MIN (4L << 20)
+
+	/// A speculative range gives up once this many bytes of its output were copied out
+	/// of the window before it.
+#define GZIP_MARKERS_MAX (4L << 20)
 	
+	/// An access point. Its 32K window is kept deflated (length bytes), since a point is
+	/// taken every span of output; a window that would not get any smaller is kept as it
+	/// is, with a length of GZIP_WINSIZE. The window is allocated along with the rest.
+	/// A point with no window (a length of 0) is the header of a gzip member at zin.
 	struct GzipBlockData : public OffsetData {
 		off64_t zin;
 		off64_t zbits;
-		unsigned char window [GZIP_WINSIZE];
+		unsigned int length;
+		unsigned char window [1];
 	};
+
+	/// Allocates an access point with room for a window of length bytes.
+	GzipBlockData * GzipBlockNew (unsigned int length);
 	
 	/***
 	 * \class GzipIndex
@@ -44,13 +63,36 @@ namespace largefile {
 	 * \brief
 	 */
 	class GzipIndex : public FileIndex {
+	protected:
+		off64_t span;
+
+		uint32_t Kind (void) const { return 1; }
+		bool SaveExtra (FILE * fp, const LineOffset * mark);
+		bool LoadExtra (FILE * fp, LineOffset * mark);
+		bool Inside (const LineOffset * mark, const IndexStamp & stamp) const;
 	public:
+		GzipIndex (void);
+
+		/// How much output there is between access points; set it before indexing.
+		inline off64_t getSpan (void) const { return this->span; }
+		inline void setSpan (off64_t span) { this->span = (span < GZIP_WINSIZE) ? GZIP_WINSIZE : span; }
+
+		/// Inflates the window of an access point into a GZIP_WINSIZE buffer.
+		static bool Window (const GzipBlockData * block, unsigned char * window);
+
+		/// Makes an access point at a block boundary out of the circular window that
+		/// inflate was writing into, left bytes short of its end.
+		static GzipBlockData * Pack (off64_t zin, int bits, unsigned int left, const unsigned char * window);
+
 		LookupTable * Add (off64_t byte,
 								 off64_t line,
 								 off64_t zin,
 								 int bits,
 								 unsigned int left,
 								 unsigned char * window);
+
+		/// Adds a mark that owns an access point from then on.
+		LookupTable * Add (off64_t byte, off64_t line, GzipBlockData * block);
 		void Relax (void);
 	};
 
@@ -63,6 +105,8 @@ namespace largefile {
 	 * \brief
 	 */
 	class GnuzipDispatcher : public AbstractFileDispatcher {
+	protected:
+		bool speculative;
 	public:
 		/// Constructor.
 		GnuzipDispatcher (int e);
@@ -79,6 +123,14 @@ namespace largefile {
 		void Index (void);
 		
 		void * run (void * null);
+
+		/// How much output there is between access points. A smaller span costs more
+		/// memory (a window for each point) but less inflating before each read.
+		void setSpan (off64_t span);
+
+		/// Indexes a file with only the one member over parallel ranges too, guessing
+		/// where their deflate blocks start; this is experimental.
+		inline void setSpeculative (bool speculative) { this->speculative = speculative; }
 	};
 	
 	/***
@@ -90,8 +142,32 @@ namespace largefile {
 	class GnuzipFileWorker : public AbstractFileWorker {
 	protected:
 		FILE * fp;
-	
-		bool InflateBlockAtOffset (off64_t offset, char * buf, size_t size);
+		z_stream zstrm;
+		bool zinit;
+		bool zend;
+		bool zraw;
+		unsigned char zinput[GZIP_CHUNK];
+
+		/// Sets the stream up to inflate from an access point of the index: the file is
+		/// seeked to its compressed offset, the bits of the byte that it starts in are
+		/// primed and its 32K window becomes the dictionary. The first mark, which has
+		/// no access point, starts at the gzip header instead.
+		bool InflateBlockAtOffset (const LineOffset * point);
+
+		/// Inflates the next (up to) size bytes from where the stream is; returns the
+		/// number of bytes, 0 at the end of the stream or -1 on an error.
+		ssize_t Inflate (char * buf, size_t size);
+
+		/// Carries on with the gzip member after the one that inflate just finished, if
+		/// there is one; files that were concatenated (or written as BGZF) have several.
+		bool NextMember (void);
+
+		/// Passes over skip bytes and then lines newlines of the stream, and collects the
+		/// N lines after that into window.
+		bool Readlines (off64_t skip, off64_t lines, off64_t N, std::string & window);
+
+		/// Copies the last mark before (or at) a line or an uncompressed byte.
+		bool FindPoint (off64_t line, off64_t byte, LineOffset & point);
 	public:
 		GnuzipFileWorker (const std::string & filename, FileIndexPtr marks);
 		GnuzipFileWorker (const std::string & filename);
@@ -119,6 +195,148 @@ namespace largefile {
 		void * run (void * null);
 	};
 	
+	/***
+	 * \class GnuzipOffsetReader
+	 * \ingroup Largefile
+	 * \author jb (jvb4@njit.edu)
+	 * \brief
+	 */
+	class GnuzipOffsetReader : public GnuzipFileWorker {
+	private:
+		off64_t numberOfLinesToRead;
+		off64_t startOffset;
+	public:
+		GnuzipOffsetReader (const std::string & filename, FileIndexPtr marks, off64_t offset, off64_t N);
+
+		virtual ~GnuzipOffsetReader (void);
+
+		void * run (void * null);
+	};
+	
+	/***
+	 * \class GnuzipRangeScanner
+	 * \ingroup Largefile
+	 * \brief Inflates one range of a gzip file for the GnuzipBlockIndexer, counting its
+	 * lines and taking access points along the way. A range that does not start the file
+	 * begins at the first member header inside of it that inflates cleanly, or (when it
+	 * is speculative) at the first deflate block that does. Its points are relative to
+	 * there until the indexer adds in the ranges before it. The range at the start of the
+	 * file adds its points to the index as it goes.
+	 *
+	 * A speculative range does not have the 32K of output that came before it. It is
+	 * inflated twice over, against two dictionaries that spell out the position of each
+	 * of their bytes, until 32K of output in a row did not come out of them. Each byte
+	 * that did is kept as a marker, and Resolve fills them in (along with the lines and
+	 * windows that they went into) once the window is known. All positions are in bits.
+	 */
+	class GnuzipRangeScanner : public concurrent::Thread {
+	private:
+		std::string filename;
+		GzipIndexPtr index;
+		concurrent::IRunnable * owner;
+		off64_t begin;
+		off64_t end;
+		off64_t span;
+		bool bgzf;
+		bool exact;
+		bool blocks;
+		bool raw;
+		std::string dictionary;
+
+		/// A byte of output that was copied out of the window before the range: where it
+		/// is, and where inside of that window it came from.
+		struct Marker {
+			off64_t offset;
+			uint16_t source;
+
+			static bool Before (const Marker & a, const Marker & b) { return a.offset < b.offset; }
+		};
+		std::vector<Marker> markers;
+
+		/// An access point whose window still has markers in it, or is short of 32K.
+		struct Pending {
+			size_t point;
+			off64_t zin;
+			int bits;
+			std::string window;
+		};
+		std::vector<Pending> pending;
+
+		/// Puts the window before the range, and the bytes that markers stand for, into
+		/// the 32K of output before offset.
+		void Fill (std::string & flat, off64_t offset, const std::string & window);
+
+		/// Finds the first bit (from on) inside of the range that looks like the header of
+		/// a member, or of a deflate block if the range is speculative.
+		off64_t Find (FILE * fp, off64_t from, unsigned char * input);
+		off64_t FindBlock (FILE * fp, off64_t from, unsigned char * input);
+
+		/// Inflates from a header or a block until it gets past the range. Returns 1 when
+		/// it did, 0 if it could not have started there and -1 on any other failure.
+		int Scan (FILE * fp, off64_t from, unsigned char * input, unsigned char * window);
+
+		bool Point (off64_t byte, off64_t line, GzipBlockData * block);
+		void Reset (void);
+	public:
+		/// The access points, relative to the start (unless they went into the index).
+		/// Their lines are a guess until the markers have been resolved.
+		std::vector<LineOffset> points;
+
+		/// Where the range starts (-1 if nothing did), or just as well could have (up to
+		/// upto), and where it stopped, which is the header of a member when header is set.
+		off64_t first;
+		off64_t upto;
+		off64_t last;
+		bool header;
+
+		/// Uncompressed bytes and newlines, and whether the last line was left without a
+		/// newline.
+		off64_t bytes;
+		off64_t lines;
+		bool partial;
+
+		/// The 32K of output before where the range stopped.
+		std::string tail;
+
+		/// Whether anything other than another member comes after the last one.
+		bool eof;
+
+		/// Whether the whole range was read.
+		bool done;
+
+		/// Constructor; the range is [begin, end). The index is given to the range at the
+		/// start of the file only.
+		GnuzipRangeScanner (const std::string & filename, GzipIndexPtr index, concurrent::IRunnable * owner,
+								  off64_t begin, off64_t end, off64_t span, bool bgzf);
+
+		/// Destructor.
+		virtual ~GnuzipRangeScanner (void);
+
+		/// Starts right at begin: a member header, or a deflate block that comes after the
+		/// given 32K of output.
+		inline void setExact (bool raw, const std::string & dictionary = std::string()) {
+			this->exact = true;
+			this->raw = raw;
+			this->dictionary = dictionary;
+		}
+
+		/// Stops at the first deflate block past the range rather than the first member;
+		/// a speculative (raw) range also starts at one.
+		inline void setBlocks (bool raw) {
+			this->blocks = true;
+			this->raw = raw;
+		}
+
+		/// Whether the range started in the middle of a member.
+		inline bool isRaw (void) const { return this->raw; }
+
+		/// Fills the markers in from the 32K of output before the range.
+		bool Resolve (const std::string & window);
+
+		/// Method that acts as "main" for thread of execution.
+		void * run (void * null);
+	};
+	
 	/***
 	 * \class GnuzipBlockIndexer
 	 * \ingroup Largefile
@@ -126,9 +344,11 @@ namespace largefile {
 	 * \brief
 	 */
 	class GnuzipBlockIndexer : public GnuzipFileWorker {
+	private:
+		bool speculative;
 	public:
-		/// Constructor.
-		GnuzipBlockIndexer (const std::string & filename, FileIndexPtr marks);
+		/// Constructor; a speculative indexer splits up files that have only the one member.
+		GnuzipBlockIndexer (const std::string & filename, FileIndexPtr marks, bool speculative);
 
 		/// Destructor.
 		virtual ~GnuzipBlockIndexer (void);
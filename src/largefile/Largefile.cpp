@@ -27,6 +27,7 @@
 #include <sstream>
 #include "GotoDialog.hpp"
 #include "Largefile.hpp"
+#include "Gzip.hpp"
 
 using namespace largefile;
 
@@ -63,9 +64,13 @@ GotoDialogResponseCallback (GtkWidget * gtkdialog, gint response, gpointer data)
 
 				// absolute line
 				case 1: {
-					dialog->lf->Readline (dialog->lf->workbook()->focus_sheet,
-												 value,
-												 1000);
+					Sheet * sheet = dialog->lf->workbook()->focus_sheet;
+
+					// A windowed sheet jumps by moving its scrollbar, which reads the lines.
+					if (sheet->gtk_vscrollbar != NULL)
+						gtk_range_set_value (GTK_RANGE (sheet->gtk_vscrollbar), value);
+					else
+						dialog->lf->Readline (sheet, value, 1000);
 				}
 				break;
 
@@ -103,6 +108,26 @@ GotoDialogRadioToggleCallback (GtkToggleButton * button, gpointer data) {
 	}
 }
 
+/* @description: This function is called by a windowed sheet when its
+   scrollbar has moved, and reads the lines of the new window. */
+static void
+LargefileWindowRequest (Sheet * sheet, guint64 line, gint rows, gpointer data) {
+	Largefile * lf = (Largefile *)data;
+	lf->Readline (sheet, line, rows);
+}
+
+/* @description: This function runs on the main loop and keeps the
+   scrollbars of the windowed sheets in step with their indexers. */
+static gboolean
+LargefileWindowTimeout (gpointer data) {
+	Largefile * lf = (Largefile *)data;
+
+	gdk_threads_enter();
+	lf->RefreshWindows();
+	gdk_threads_leave();
+	return TRUE;
+}
+
 static void
 CsvOpenDialogCallback (GtkWidget * w, gpointer data) {
 	GtkWidget * open_dialog = NULL;
@@ -218,6 +243,7 @@ Largefile::Largefile (Application * appstate, Handle * platform)
 
 	this->wb = workbook_open (appstate->gtkwindow(), "largefile");
 	this->gtk_togglegroup = NULL;
+	this->window_source = 0;
 	
 	ConfigPair * logpath =
 		appstate->config()->get_pair (appstate->config(), "largefile", "log", "path");
@@ -241,6 +267,13 @@ Largefile::Largefile (Application * appstate, Handle * platform)
 }
 
 Largefile::~Largefile (void) {
+	if (this->window_source != 0)
+		g_source_remove (this->window_source);
+
+	// Compressed files write their index out on close.
+	for (FilenameMap::iterator it = this->mapping.begin(); it != this->mapping.end(); it++)
+		it->second->Closefile();
+
 	FCLOSE (pktlog);
 }
 
@@ -331,8 +364,43 @@ Largefile::OpenFile (Sheet * sheet, const std::string & filename) {
 	
 	int fdEventId = proactor::Event::uniqueEventId();
 	AbstractFileDispatcher * fd = AbstractFileDispatcher::CreateFromExtension (filename, fdEventId);
+
+	ConfigPair * windowed =
+		appstate->config()->get_pair (appstate->config(), "largefile", "sheet", "virtual");
+
+	if (!IS_NULL (windowed) && atoi (windowed->value) == 1) {
+		sheet->set_window (sheet, LargefileWindowRequest, this);
+
+		if (this->window_source == 0)
+			this->window_source = g_timeout_add (500, LargefileWindowTimeout, this);
+	}
+
 	CsvParser * csv = new CsvParser (sheet, this->pktlog, 0);
 	
+	ConfigPair * persist =
+		appstate->config()->get_pair (appstate->config(), "largefile", "index", "persist");
+
+	if (!IS_NULL (persist) && atoi (persist->value) == 1) {
+		ConfigPair * directory =
+			appstate->config()->get_pair (appstate->config(), "largefile", "index", "directory");
+
+		fd->setIndexPath (AbstractFileDispatcher::SidecarPath (filename,
+																				 IS_NULL (directory) ? "" : directory->value));
+	}
+	
+	GnuzipDispatcher * gzip = dynamic_cast<GnuzipDispatcher *>(fd);
+	ConfigPair * span =
+		appstate->config()->get_pair (appstate->config(), "largefile", "gzip", "span");
+
+	if (!IS_NULL (gzip) && !IS_NULL (span) && atoll (span->value) > 0)
+		gzip->setSpan (atoll (span->value));
+
+	ConfigPair * speculative =
+		appstate->config()->get_pair (appstate->config(), "largefile", "gzip", "speculative");
+
+	if (!IS_NULL (gzip) && !IS_NULL (speculative))
+		gzip->setSpeculative (atoi (speculative->value) == 1);
+	
 	if (appstate->proactor()->addWorker (fdEventId, csv) == false) {
 		g_critical ("Failed starting CsvParser for file %s", filename.c_str());
 		this->unlock();
@@ -359,6 +427,24 @@ Largefile::OpenFile (Sheet * sheet, const std::string & filename) {
 	return true;
 }
 
+void
+Largefile::RefreshWindows (void) {
+	this->lock();
+
+	for (FilenameMap::iterator it = this->mapping.begin(); it != this->mapping.end(); it++) {
+		Sheet * sheet = wb->get_sheet (wb, it->first.c_str());
+
+		if (sheet == NULL || sheet->gtk_vscrollbar == NULL)
+			continue;
+
+		off64_t lines = it->second->Lines();
+		if (lines > 0 && (guint64)lines != sheet->window_lines)
+			sheet->set_window_lines (sheet, lines);
+	}
+
+	this->unlock();
+}
+
 bool
 Largefile::CloseFile (const std::string & filename) {
 	this->lock();
@@ -370,6 +456,7 @@ Largefile::CloseFile (const std::string & filename) {
 		return false;
 	}
 	// STUB: procedure for shutting down a file dispatcher and CsvParser.
+	it->second->Closefile();
 	this->mapping.erase (it);
 
 	this->unlock();
@@ -45,6 +45,7 @@ namespace largefile {
 		FILE * pktlog;
 		FilenameMap mapping;
 		GSList * gtk_togglegroup;
+		guint window_source;
 		
 		GtkWidget * CreateMainMenu (void);
 		GtkWidget * CreateStatusBar (void);
@@ -59,6 +60,7 @@ namespace largefile {
 		bool Readline (Sheet * sheet, off64_t start, off64_t N);
 		bool Readoffset (Sheet * sheet, off64_t offset, off64_t N);
 		bool Readpercent (Sheet * sheet, float percent, off64_t N);
+		void RefreshWindows (void);
 		
 		inline void setGotoDialogRadioGroup (GSList * group) { this->gtk_togglegroup = group; }
 		inline GotoDialog * gotodialog() { return &this->goto_dialog; }
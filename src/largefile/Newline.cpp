@@ -0,0 +1,101 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include <cstring>
+#include "Newline.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// The AVX2 kernel is built regardless of the compiler flags and only picked at
+// runtime, on a processor that has it.
+#if defined(__x86_64__) && defined(__GNUC__) \
+	&& (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define NEWLINE_AVX2 1
+#include <immintrin.h>
+#endif
+
+using namespace largefile;
+
+typedef size_t (*CountKernel) (const unsigned char *, size_t);
+
+static size_t
+CountScalar (const unsigned char * p, size_t n) {
+	size_t count = 0;
+
+	for (const unsigned char * end = p + n; p < end; p++)
+		count += (*p == '\n');
+	return count;
+}
+
+#if defined(__SSE2__)
+static size_t
+CountSSE2 (const unsigned char * p, size_t n) {
+	const __m128i nl = _mm_set1_epi8 ('\n');
+	size_t count = 0, ii = 0;
+
+	for (; ii + 16 <= n; ii += 16) {
+		__m128i v = _mm_loadu_si128 ((const __m128i *)(p + ii));
+		count += __builtin_popcount (_mm_movemask_epi8 (_mm_cmpeq_epi8 (v, nl)));
+	}
+	return count + CountScalar (p + ii, n - ii);
+}
+#endif
+
+#if defined(NEWLINE_AVX2)
+__attribute__ ((target ("avx2"))) static size_t
+CountAVX2 (const unsigned char * p, size_t n) {
+	const __m256i nl = _mm256_set1_epi8 ('\n');
+	size_t count = 0, ii = 0;
+
+	for (; ii + 32 <= n; ii += 32) {
+		__m256i v = _mm256_loadu_si256 ((const __m256i *)(p + ii));
+		count += __builtin_popcount ((unsigned int)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, nl)));
+	}
+	return count + CountScalar (p + ii, n - ii);
+}
+#endif
+
+static CountKernel
+SelectKernel (void) {
+#if defined(NEWLINE_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports ("avx2"))
+		return CountAVX2;
+#endif
+#if defined(__SSE2__)
+	return CountSSE2;
+#else
+	return CountScalar;
+#endif
+}
+
+// Picked once, when the plugin is loaded.
+static const CountKernel kernel = SelectKernel();
+
+size_t
+largefile::CountNewlines (const unsigned char * p, size_t n) {
+	return kernel (p, n);
+}
+
+const unsigned char *
+largefile::FindLastNewline (const unsigned char * p, size_t n) {
+	// glibc already vectorizes this one.
+	return (const unsigned char *)memrchr (p, '\n', n);
+}
@@ -0,0 +1,36 @@
+/* 
+   The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+   Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+   This library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public
+   License along with the library; if not, write to the Free Software
+   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef NEWLINE_HPP
+#define NEWLINE_HPP
+
+#include <cstddef>
+
+namespace largefile {
+
+	/// Returns the number of newlines inside of the n bytes at p. This is the inner
+	/// loop of the plaintext indexer; it compares 32 (AVX2) or 16 (SSE2) bytes at a
+	/// time where the processor has them, and one byte at a time where it does not.
+	size_t CountNewlines (const unsigned char * p, size_t n);
+
+	/// Returns a pointer to the last newline inside of the n bytes at p, or NULL.
+	const unsigned char * FindLastNewline (const unsigned char * p, size_t n);
+
+}
+
+#endif
@@ -23,6 +23,7 @@
 #include <glib.h>
 #include <header.h>
 #include "Plaintext.hpp"
+#include "Newline.hpp"
 
 using namespace largefile;
 
@@ -61,7 +62,7 @@ PlaintextDispatcher::Readoffset (off64_t offset, off64_t N) {
 	// them of their wrong choice to do so.
 	this->marks->lock();
 	
-	if (offset > this->marks->get(this->marks->size())->byte) {
+	if (NULL == this->marks->get(0) || offset > this->marks->get(this->marks->size() - 1)->byte) {
 		this->marks->unlock();
 		return false;
 	}
@@ -91,7 +92,8 @@ PlaintextDispatcher::Readpercent (float percent, off64_t N) {
 
 void
 PlaintextDispatcher::Index (void) {
-	PlaintextLineIndexer * indexer = new PlaintextLineIndexer (this->filename, this->marks);
+	PlaintextLineIndexer * indexer =
+		new PlaintextLineIndexer (this->filename, this->marks, this->indexpath, this->stamp);
 	this->addWorker (indexer);
 }
 
@@ -105,6 +107,19 @@ PlaintextDispatcher::Openfile (const std::string & filename) {
 		return false;
 	}
 
+	// A file that was indexed before, and has not changed since, has its exact marks
+	// already; there is nothing left to index.
+	if (false == this->indexpath.empty() && FileIndex::Stamp (filename, this->stamp) == true) {
+		if (this->marks->Load (this->indexpath, this->stamp) == true) {
+			FCLOSE (fp);
+			this->indexed = true;
+			this->filename = filename;
+			return true;
+		}
+	}
+	else
+		this->indexpath.clear();
+
 	// Take the relative byte position, e.g. .75 * byte_end, and we now have the a relative
 	// line at that byte position for indexing at a later point in time.
 	FSEEK_END (fp);
@@ -133,7 +148,8 @@ PlaintextDispatcher::Closefile (void) {
 void *
 PlaintextDispatcher::run (void * null) {
 	this->Readline(0,1000);
-	this->Index();
+	if (false == this->indexed)
+		this->Index();
 		
 	while (this->isRunning() == true) {
 		while (this->inputQueue.size() == 0) {
@@ -202,42 +218,117 @@ PlaintextOffsetReader::~PlaintextOffsetReader (void) {
 	
 void *
 PlaintextOffsetReader::run (void * null) {
-	char buf[4096];
-	int ch;
+	LineSlice line;
 
-	if (PlaintextFileWorker::Openfile () == false) {
+	if (false == this->Mapfile()) {
 		// STUB: throw some kind of error here; we failed opening the file.
-		g_critical ("Failed opening file descriptor inside of PlaintextOffsetReader.");
+		g_critical ("Failed mapping file inside of PlaintextOffsetReader.");
 		return NULL;
 	}
 		
-	off64_t offset = 0;
+	off64_t cursor = this->startOffset;
 	off64_t read_max = this->numberOfLinesToRead;
-
-	FSEEK (this->fp, this->startOffset);
 						
 	// We need to go to the beginning of the (next) line.
-	while (EOF != (ch = fgetc (this->fp))) {
-		if (ch == '\n') {
-			offset = FTELL (fp);
-			break;
-		}
-	}
-			
+	if (false == this->Nextline (cursor, line, cursor))
+		cursor = this->fileLength;
+
+	// The lines of the window sit next to each other inside of the mapping, so they
+	// are handed over in one piece.
+	off64_t window = cursor;
+
 	for (off64_t ii = 0; ii < read_max; ii++) {
-		if (NULL == (std::fgets (buf, 4096, this->fp)))
+		if (false == this->Nextline (cursor, line, window))
 			break;
-						
-		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (buf);
 	}
+
+	if (cursor > window && NULL != this->map)
+		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (this->Span (window), cursor - window);
 		
 	this->dispatcher->removeWorker (this);
-	this->Closefile();
+	this->Unmapfile();
 	return NULL;
 }
 		
-PlaintextLineIndexer::PlaintextLineIndexer (const std::string & filename, FileIndexPtr marks)
-	: PlaintextFileWorker (filename, marks) {
+PlaintextRangeScanner::PlaintextRangeScanner (const std::string & filename,
+															 FileIndexPtr marks,
+															 concurrent::IRunnable * owner,
+															 off64_t begin,
+															 off64_t end,
+															 int first_mark,
+															 int last_mark)
+	: filename (filename), marks (marks), owner (owner), begin (begin), end (end), firstMark (first_mark),
+	  lines (last_mark - first_mark, 0), bytes (last_mark - first_mark, -1), count (0), last (-1), done (false) {
+}
+
+PlaintextRangeScanner::~PlaintextRangeScanner (void) {
+}
+
+void *
+PlaintextRangeScanner::run (void * null) {
+	const size_t CHUNK = 1 << 20;
+	off64_t cursor = this->begin;
+	size_t index = 0;
+	FILE * fp = NULL;
+
+	if (NULL == (fp = FOPEN (this->filename.c_str(), "r"))) {
+		g_critical ("Failed opening file descriptor in range scanner");
+		return NULL;
+	}
+
+	unsigned char * input = new unsigned char[CHUNK];
+	FSEEK (fp, this->begin);
+
+	// A mark is placed once the byte that it points at has been counted, so it
+	// gets the line that the byte is on. Marks that share a byte (e.g. in a
+	// small file) all get the same place.
+	while (cursor < this->end && true == this->owner->isRunning()) {
+		size_t want = (size_t)MIN ((off64_t)CHUNK, this->end - cursor);
+		size_t bytes = fread (input, 1, want, fp);
+		const unsigned char * ch = input, * found;
+		off64_t chunk_end = cursor + bytes;
+
+		if (0 == bytes || ferror (fp))
+			break;
+
+		for (; index < this->lines.size(); index++) {
+			off64_t byte = this->marks->get(this->firstMark + index)->byte;
+
+			if (byte >= chunk_end)
+				break;
+
+			if (byte >= cursor) {
+				size_t n = (size_t)(byte - cursor) + 1;
+
+				this->count += CountNewlines (ch, n);
+				if (NULL != (found = FindLastNewline (ch, n)))
+					this->last = cursor + (found - ch) + 1;
+				ch += n;
+				cursor += n;
+			}
+
+			this->lines[index] = this->count;
+			this->bytes[index] = this->last;
+		}
+
+		this->count += CountNewlines (ch, chunk_end - cursor);
+		if (NULL != (found = FindLastNewline (ch, chunk_end - cursor)))
+			this->last = cursor + (found - ch) + 1;
+		cursor = chunk_end;
+	}
+
+	this->done = (cursor == this->end);
+
+	delete [] input;
+	FCLOSE (fp);
+	return NULL;
+}
+
+PlaintextLineIndexer::PlaintextLineIndexer (const std::string & filename,
+														  FileIndexPtr marks,
+														  const std::string & indexpath,
+														  const IndexStamp & stamp)
+	: PlaintextFileWorker (filename, marks), indexpath (indexpath), stamp (stamp) {
 }
 
 PlaintextLineIndexer::~PlaintextLineIndexer (void) {
@@ -245,15 +336,12 @@ PlaintextLineIndexer::~PlaintextLineIndexer (void) {
 
 void *
 PlaintextLineIndexer::run (void * null) {
-	int index = 0;
-	off64_t cursor = 0, count = 0, byte_beg = 0;
+	int index = 0, marks_size = 0, ranges = 1;
+	off64_t size = 0, count = 0, byte_beg = 0;
 	struct timeval start, end;
-	const int CHUNK = 16384;
-	unsigned char * ch;
-	LineOffset * x = NULL;
-	unsigned char input[CHUNK+1];
+	std::vector<PlaintextRangeScanner *> scanners;
+	bool done = true;
 	double ms = 0.0f;
-	input[CHUNK] = 0;
 	
 	if (PlaintextFileWorker::Openfile() == false) {
 		// STUB: throw some kind of error here; we failed opening the file.
@@ -262,54 +350,86 @@ PlaintextLineIndexer::run (void * null) {
 	}
 		
 	std::cout<<"index start..."<<std::flush;
+
+	this->marks->lock();
+	marks_size = this->marks->size();
+	this->marks->unlock();
+
+	FSEEK_END (this->fp);
+	size = FTELL (this->fp);
+
+	// One range per core, as long as they stay large enough to be worth a thread.
+	ranges = MIN ((off64_t)sysconf (_SC_NPROCESSORS_ONLN), size / INDEX_RANGE_MIN);
+	ranges = CLAMP (ranges, 1, INDEX_THREADS_MAX);
 		
 	gettimeofday (&start, NULL);
 		
-	// We need to get a absoltue line number from the relative position. We're not
-	// going to get away from having to sequentially read this file in, but once we
-	// have line numbers we can jump throughout the file pretty quickly.
-	while (0 != fread (input, 1, CHUNK, this->fp)) {
-		if (ferror (this->fp) || false == this->isRunning())
-			goto thread_teardown;
-		
-		ch = input;
-		
-		while (*ch) {
-			while (false == this->marks->trylock()) {
-				if (false == this->isRunning())
-					goto thread_teardown;
-				Thread::sleep(1);
-			}
+	// We need to get a absoltue line number from the relative position. Every range
+	// of the file is counted on its own thread; the marks were all added by Openfile,
+	// so each scanner is handed the ones that fall inside of its range.
+	for (int ii = 0; ii < ranges; ii++) {
+		off64_t range_beg = (size * ii) / ranges, range_end = (size * (ii + 1)) / ranges;
+		int first = index;
+
+		while (index < marks_size && this->marks->get(index)->byte < range_end)
+			index++;
+
+		PlaintextRangeScanner * scanner =
+			new PlaintextRangeScanner (this->filename, this->marks, this, range_beg, range_end, first, index);
+		scanners.push_back (scanner);
+		scanner->start();
+	}
 
-			if (NULL == (x = this->marks->get(index))) {
-				this->marks->unlock();
-				goto thread_teardown;
-			}
-					
-			if (*ch=='\n') {
-				byte_beg = cursor;
-				count++;
-			}
-										
-			if (x->byte == cursor++) {
-				x->line = count;
-				x->byte = byte_beg;
-			
-				index++;
-								
-				if (index == this->marks->size()) {
-					break;
-				}
-			}
+	// The ranges are finished in order, which turns their counts into absolute lines
+	// (a prefix sum) and publishes the marks of each one as soon as it can.
+	index = 0;
+	for (size_t ii = 0; ii < scanners.size(); ii++) {
+		PlaintextRangeScanner * scanner = scanners[ii];
 
-			this->marks->unlock();
+		scanner->join();
+		done = done && scanner->done;
+		if (false == done)
+			continue;
+
+		for (size_t jj = 0; jj < scanner->lines.size(); jj++, index++) {
+			off64_t line = count + scanner->lines[jj];
+			off64_t byte = (scanner->bytes[jj] < 0) ? byte_beg : scanner->bytes[jj];
+
+			this->marks->publish (this->marks->get(index), byte, line);
+
+			// Until the end of the file the number of lines is a guess based on
+			// how far into the file this mark is.
+			if (index > 0)
+				this->marks->setLines ((line * LINE_PRECISION) / index);
 		}
+
+		count += scanner->count;
+		if (scanner->last >= 0)
+			byte_beg = scanner->last;
 	}
+
+	for (size_t ii = 0; ii < scanners.size(); ii++)
+		delete scanners[ii];
+
+	if (false == done || false == this->isRunning())
+		goto thread_teardown;
+
+	// The last mark sits at the very end of the file, which no range goes past; it
+	// belongs to the last line, wherever that started.
+	for (; index < marks_size; index++)
+		this->marks->publish (this->marks->get(index), byte_beg, count);
+
+	this->marks->setLines ((size > byte_beg) ? count + 1 : count);
+	this->marks->setFinished (true);
+
+	// The next time this file is opened it does not have to be indexed again.
+	if (false == this->indexpath.empty() && false == this->marks->Save (this->indexpath, this->stamp))
+		g_warning ("Failed saving the index of %s to %s", this->filename.c_str(), this->indexpath.c_str());
 		
 	gettimeofday (&end, NULL);
 
 	ms = ((((end.tv_sec-start.tv_sec) * 1000) + ((end.tv_usec-start.tv_usec)/1000.0)) + 0.5);
-	std::cout<<"ready (ms:"<<ms<<")!\n"<<std::flush;
+	std::cout<<"ready (ms:"<<ms<<", ranges:"<<ranges<<")!\n"<<std::flush;
 	this->dispatcher->removeWorker (this);
 
  thread_teardown:
@@ -331,49 +451,51 @@ PlaintextLineReader::~PlaintextLineReader (void) {
 
 void *
 PlaintextLineReader::run (void * null) {
-	char buf[4096];
+	LineSlice line;
 
-	if (false == PlaintextFileWorker::Openfile ()) {
+	if (false == this->Mapfile()) {
 		// STUB: throw some kind of error here; we failed opening the file.
-		g_critical ("Failed opening file descriptor in PlaintextLineReader");
+		g_critical ("Failed mapping file in PlaintextLineReader");
 		return NULL;
 	}
 		
-	off64_t offset = 0, delta = 0;
-	off64_t read_max = this->numberOfLinesToRead, line_max = this->startLine + read_max;
+	off64_t cursor = 0, delta = 0;
+	off64_t read_max = this->numberOfLinesToRead;
 
-	this->marks->lock();
-	
-	for (off64_t index = 1; index < LINE_INDEX_MAX; index++) {
-		if (line_max < this->marks->get(index)->line) {
-			delta = this->startLine - this->marks->get(index-1)->line;
-			offset = this->marks->get(index-1)->byte;
+	// Start from the last mark at or before the line, which may be past the
+	// last one that has been indexed so far. The indexer publishes the marks
+	// while this reads them, without either one taking the lock.
+	for (int index = 0; index < this->marks->size(); index++) {
+		LineOffset * mark = this->marks->get(index);
+		off64_t line = this->marks->published (mark);
+
+		if (line < 0 || line > this->startLine)
 			break;
-		}
+		delta = this->startLine - line;
+		cursor = mark->byte;
 	}
 
-	this->marks->unlock();
-	
-	FSEEK (this->fp, offset);
-		
-	// Munch lines to get to our starting point.
+	// Munch lines to get to our starting point. Only the lines from the mark on are
+	// read, in order, so the window that is mapped slides along with them.
 	while (delta > 0) {
-		if (NULL == std::fgets (buf, 4096, this->fp))
+		if (false == this->Nextline (cursor, line, cursor))
 			break;
-						
 		--delta;
 	}
-		
+
+	// The lines of the window sit next to each other inside of the mapping, so they
+	// are handed over in one piece.
+	off64_t window = cursor;
+
 	for (off64_t ii = 0; ii < read_max; ii++) {
-		if (NULL == std::fgets (buf, 4096, this->fp))
+		if (false == this->Nextline (cursor, line, window))
 			break;
-						      
-		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (buf);
 	}
+
+	if (cursor > window && NULL != this->map)
+		((proactor::InputDispatcher *)this->dispatcher)->onReadComplete (this->Span (window), cursor - window);
 		
 	this->dispatcher->removeWorker (this);
-
- thread_teardown:
-	this->Closefile();
+	this->Unmapfile();
 	return NULL;
 }
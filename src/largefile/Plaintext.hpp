@@ -23,11 +23,18 @@
 #include <proactor/InputDispatcher.hpp>
 #include "FileDispatcher.hpp"
 #include "FileWorker.hpp"
+#include <concurrent/Thread.hpp>
+#include <vector>
 
 namespace largefile {
 
 	const int LINE_INDEX_MAX = 1001;
 	const int LINE_PRECISION = 1000;
+
+	/// The plaintext indexer splits a file into at most this many byte ranges, one
+	/// thread apiece, and never into ranges smaller than the minimum.
+	const int INDEX_THREADS_MAX = 16;
+	const off64_t INDEX_RANGE_MIN = 16 << 20;
 	
 	/***
 	 * \class PlaintextDispatcher
@@ -72,6 +79,48 @@ namespace largefile {
 		bool Closefile (void);
 	};
 	
+	/***
+	 * \class PlaintextRangeScanner
+	 * \ingroup Largefile
+	 * \brief Counts the newlines inside of one byte range of a plaintext file for the
+	 * PlaintextLineIndexer, along with where each of the marks that fall inside of the
+	 * range goes. Everything is relative to the start of the range; the indexer adds
+	 * in the lines of the ranges before it.
+	 */
+	class PlaintextRangeScanner : public concurrent::Thread {
+	private:
+		std::string filename;
+		FileIndexPtr marks;
+		concurrent::IRunnable * owner;
+		off64_t begin;
+		off64_t end;
+		int firstMark;
+	public:
+		/// Newlines from the start of the range up to and including the byte of each mark.
+		std::vector<off64_t> lines;
+
+		/// The byte after the last of those newlines, or -1 if there was none.
+		std::vector<off64_t> bytes;
+
+		/// Newlines inside of the whole range, and the byte after the last one (or -1).
+		off64_t count;
+		off64_t last;
+
+		/// Whether the whole range was read.
+		bool done;
+
+		/// Constructor; the range is [begin, end) and holds the marks [first_mark, last_mark).
+		PlaintextRangeScanner (const std::string & filename, FileIndexPtr marks,
+									  concurrent::IRunnable * owner, off64_t begin, off64_t end,
+									  int first_mark, int last_mark);
+
+		/// Destructor.
+		virtual ~PlaintextRangeScanner (void);
+
+		/// Method that acts as "main" for thread of execution.
+		void * run (void * null);
+	};
+
 	/***
 	 * \class PlaintextLineIndexer
 	 * \ingroup Largefile
@@ -79,9 +128,13 @@ namespace largefile {
 	 * \brief
 	 */
 	class PlaintextLineIndexer : public PlaintextFileWorker {
+	private:
+		std::string indexpath;
+		IndexStamp stamp;
 	public:
-		/// Constructor.
-		PlaintextLineIndexer (const std::string & filename, FileIndexPtr marks);
+		/// Constructor; the finished index is saved to indexpath, unless it is empty.
+		PlaintextLineIndexer (const std::string & filename, FileIndexPtr marks,
+									 const std::string & indexpath, const IndexStamp & stamp);
 
 		/// Destructor.
 		virtual ~PlaintextLineIndexer (void);
@@ -45,6 +45,7 @@ namespace realtime {
 	gboolean
 	Packet::parse (const gchar * buf) {
 		this->fields.clear();
+		this->offsets.clear();
 
 		if (IS_NULLSTR (buf)) 
 			return FALSE;
@@ -55,8 +56,10 @@ namespace realtime {
 
 		WORD (this->delimiter, line, this->time);
 		WORD (this->delimiter, line, this->type);
+		this->body = line;
 
 		while (line.length() > 0) {
+			this->offsets.push_back (this->body.length() - line.length());
 			WORD (this->delimiter, line, value);
 			this->fields.push_back (value);
 		}
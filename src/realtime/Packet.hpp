@@ -38,6 +38,8 @@ namespace realtime {
 		String time;
 		String type;
 		Array<String> fields;
+		Array<size_t> offsets;
+		String body;
 		gchar delimiter;
 	public:
 		const static int TYPE_UPDATECELL = 0;
@@ -47,7 +49,8 @@ namespace realtime {
 		const static int TYPE_MOVESHEET = 4;
 		const static int TYPE_SAVESHEET = 5;
 		const static int TYPE_LOADSHEET = 6;
-		const static int MAX_TYPES = 7;
+		const static int TYPE_SNAPSHOT = 7;
+		const static int MAX_TYPES = 8;
 		  
 		Packet (void);
 		~Packet (void);
@@ -64,6 +67,12 @@ namespace realtime {
 			return this->fields.at(index).c_str();
 		}
 		inline size_t size (void) const { return this->fields.size(); }
+
+		/* The rest of the line from a field on, delimiters and all; for a
+			last field that may hold the delimiter itself (e.g. a filepath). */
+		inline String tail (gint index) const {
+			return this->body.substr (this->offsets.at(index));
+		}
 	};
 
 } // end of namespace
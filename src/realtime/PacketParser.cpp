@@ -3,15 +3,246 @@
 
 namespace realtime {
 
-	PacketParser::PacketParser (Workbook * wb, FILE * pktlog, int verbosity = 0) {
+	PacketParser::PacketParser (Workbook * wb, FILE * pktlog, int verbosity = 0,
+										 SnapshotWorker * snapshots = NULL) {
 		this->wb = wb;
 		this->pktlog = pktlog;
-		this->cell = cell_new();
 		this->verbosity = verbosity;
+		this->snapshots = snapshots;
 	}
 
 	PacketParser::~PacketParser (void) {
-		this->cell->destroy (cell);
+	}
+
+	/* @description: This function applies a packet from the main loop. The
+		sheet is looked up here rather than on the worker thread, since the
+		packets queued ahead of it may add, rename or remove sheets. */
+	void
+	PacketParser::apply (Scheduler * scheduler, gpointer data) {
+		Update * update = (Update *)data;
+		Workbook * wb = update->wb;
+		SnapshotWorker * snapshots = update->snapshots;
+		int verbosity = update->verbosity;
+		Packet & packet = update->packet;
+		const std::string & line = update->line;
+
+		switch (packet.getType()) {
+			default:
+			g_warning ("Invaild packet line '%s'", line.c_str());
+			break;
+			/* ^time^type^sheet_name^sheet_name^after */
+			case Packet::TYPE_MOVESHEET: {
+				if (packet.size() != 3) {
+					g_warning ("Packet::TYPE_MOVESHEET: Wrong packet format: %s",
+								  line.c_str());
+					break;
+				}
+	      
+				Sheet * sheet = wb->get_sheet (wb, packet[0]);
+				if (IS_NULL (sheet)) {
+					g_warning ("Failed moving sheet '%s' to %s sheet '%s'",
+								  packet[0],
+								  (strcmp(packet[2], "0") == 0) ? "after" : "before",
+								  packet[1]);
+					break;
+				}
+
+				if (wb->move_sheet (wb, sheet, packet[1], atoi (packet[2]))
+					 == FALSE) {
+					g_warning ("Failed moving sheet '%s'", packet[0]);
+					break;
+				}
+			}
+			break;
+			/* ^time^type^sheet_name^loadpath */
+			case Packet::TYPE_LOADSHEET: {
+				if (packet.size() != 2) {			  
+					g_warning ("Packet::TYPE_LOADSHEET: Wrong packet format: %s",
+								  line.c_str());
+					break;
+				}
+
+				Sheet * sheet = wb->get_sheet (wb, packet[0]);
+				if (IS_NULL (sheet)) {
+					g_warning ("Unable to load geometry file; sheet '%s'"
+								  " does not exist", packet[0]);
+					break;
+				}
+	      
+				if (snapshots)
+					snapshots->load (sheet, packet[1]);
+				else {
+					scheduler->hold (scheduler, sheet);
+					sheet->load (sheet, packet[1]);
+				}
+			}
+			break;
+			/* ^time^type^sheet_name^savepath */
+			case Packet::TYPE_SAVESHEET: {
+				if (packet.size() != 2) {
+					g_warning ("Packet::TYPE_SAVESHEET: Wrong packet format: %s",
+								  line.c_str());
+					break;
+				}
+		      
+				Sheet * sheet = wb->get_sheet (wb, packet[0]);
+				if (IS_NULL (sheet)) {
+					g_warning ("Failed saving sheet '%s'; does not exist",
+								  packet[0]);
+					break;
+				}
+	      
+				/* Only what changed since the last save is written, and
+					only copying it out of the sheet is done here. */
+				if (snapshots) {
+					Snapshot * snapshot = sheet->snapshot (sheet, packet[1], TRUE);
+
+					if (snapshot->delta == TRUE && snapshot->cells->len == 0)
+						snapshot->destroy (snapshot);
+					else
+						snapshots->save (sheet, snapshot, packet[1]);
+					break;
+				}
+
+				gboolean saved = sheet->checkpoint (sheet, packet[1]);
+
+				if (saved == FALSE) {
+					g_warning ("Unable to save sheet.");
+					break;
+				}
+			}
+			break;
+			/* ^time^type^sheet_name^save|load^result^filepath */
+			case Packet::TYPE_SNAPSHOT: {
+				if (packet.size() < 4) {
+					g_warning ("Packet::TYPE_SNAPSHOT: Wrong packet format: %s",
+								  line.c_str());
+					break;
+				}
+
+				String filepath = packet.tail (3);
+
+				if (atoi (packet[2]) == 0) {
+					g_warning ("Unable to %s sheet '%s' (%s)",
+								  packet[1], packet[0], filepath.c_str());
+				}
+				else if (verbosity > 0) {
+					g_message ("Sheet '%s' %s (%s) done", packet[0], packet[1],
+								  filepath.c_str());
+				}
+			}
+			break;
+			/* ^time^type^sheet_name^position */
+			case Packet::TYPE_MOVESHEETINDEX: {
+				if (packet.size() != 2) {
+					g_warning ("Packet::TYPE_MOVESHEETINDEX: Wrong packet "
+								  "format: %s", line.c_str());
+					break;
+				}
+
+				Sheet * sheet = wb->get_sheet (wb, packet[0]);
+				if (IS_NULL (sheet)) {
+					g_warning ("Failed moving sheet '%s' to %d:"
+								  " Does not exist", packet[0], atoi(packet[1]));
+					break;
+				}
+		      
+				if (wb->move_sheet_index (wb, sheet, atoi(packet[1])) == FALSE) {
+					g_warning ("Failed moving sheet '%s' to %d:"
+								  " Invaild index\n", packet[0], atoi(packet[1]));
+				}
+			}
+			break;
+			/* ^time^type^sheet_name */
+			case Packet::TYPE_REMSHEET: {
+				if (packet.size() != 1) {
+					g_warning ("Packet::TYPE_REMSHEET: Wrong packet format: %s",
+								  line.c_str());
+					break;
+				}
+		      
+				Sheet * sheet = wb->get_sheet (wb, packet[0]);
+				if (IS_NULL (sheet)) {
+					g_warning ("Failed removing sheet '%s':"
+								  " Does not exist", packet[0]);
+					break;
+				}
+				// The frame that is being applied may be holding on to it, and
+				// a save may still be; it is destroyed after the saves that
+				// were queued ahead of it instead of waiting for them here.
+				scheduler->release (scheduler);
+				wb->remove_sheet (wb, sheet);
+
+				if (snapshots)
+					snapshots->destroy (sheet);
+				else
+					sheet->destroy (sheet);
+			}
+			break;
+			/* ^time^type^sheet_name^max_row^max_column */
+			case Packet::TYPE_ADDSHEET: {
+				if (packet.size() != 3) {
+					g_warning ("Packet::TYPE_ADDSHEET: Wrong packet format: %s",
+								  line.c_str());
+					break;
+				}
+		      
+				wb->add_new_sheet (wb, 
+										 packet[0],
+										 atoi (packet[1]),
+										 atoi (packet[2]));
+			}
+			break;
+			/* ^time^type^sheet_name^row^column^format^data */
+			case Packet::TYPE_UPDATECELL: {
+				if (packet.size() != 5) {
+					g_warning ("Packet::TYPE_UPDATESHEET: Wrong packet "
+								  "format: %s", line.c_str());
+					break;
+				}
+		      
+				Sheet * sheet = wb->get_sheet (wb, packet[0]);
+				if (IS_NULL (sheet)) {
+					g_warning ("Invaild sheet name '%s': Does not exist",
+								  packet[0]);
+					break;
+				}
+	            
+				Cell * cell = cell_new();
+				cell->methods->set_row (cell, atoi (packet[1]) );
+				cell->methods->set_column (cell, atoi (packet[2]) );
+	      
+				if (strlen (packet[3]) > 0) {
+					Map<String,String> fmt = packet.parseFormatString (packet[3]);
+		
+					if (fmt["bgcolor"].length() > 0)
+						cell->methods->set_bgcolor (cell, fmt["bgcolor"].c_str());
+					if (fmt["fgcolor"].length() > 0)
+						cell->methods->set_fgcolor (cell, fmt["fgcolor"].c_str());
+					if (fmt["justification"].length() > 0)
+						cell->methods->set_justification (cell, 
+														 (GtkJustification)
+														 atoi (fmt["justification"].c_str()));
+				}
+	      
+				cell->methods->set_value (cell, packet[4]);
+
+				scheduler->hold (scheduler, sheet);
+				sheet->apply_cell (sheet, cell);
+					
+				if (verbosity > 0) {
+					g_message ("Cell (%d,%d) updated", 
+								  cell->row, cell->column);
+				}
+				cell->methods->destroy (cell);
+			}
+			break;
+		}
+	}
+
+	void
+	PacketParser::release (gpointer data) {
+		delete (Update *)data;
 	}
 
 	void *
@@ -43,172 +274,14 @@ namespace realtime {
 						continue;
 					}
 
-					switch (packet.getType()) {
-						default:
-						g_warning ("Invaild packet line '%s'", buf.c_str());
-						break;
-						/* ^time^type^sheet_name^sheet_name^after */
-						case Packet::TYPE_MOVESHEET: {
-							if (packet.size() != 3) {
-								g_warning ("Packet::TYPE_MOVESHEET: Wrong packet format: %s",
-											  buf.c_str());
-								break;
-							}
-	      
-							Sheet * sheet = wb->get_sheet (wb, packet[0]);
-							if (IS_NULL (sheet)) {
-								g_warning ("Failed moving sheet '%s' to %s sheet '%s'",
-											  packet[0],
-											  (strcmp(packet[2], "0") == 0) ? "after" : "before",
-											  packet[1]);
-								break;
-							}
-
-							if (wb->move_sheet (wb, sheet, packet[1], atoi (packet[2]))
-								 == FALSE) {
-								g_warning ("Failed moving sheet '%s'", packet[0]);
-								break;
-							}
-						}
-						break;
-						/* ^time^type^sheet_name^loadpath */
-						case Packet::TYPE_LOADSHEET: {
-							if (packet.size() != 2) {			  
-								g_warning ("Packet::TYPE_LOADSHEET: Wrong packet format: %s",
-											  buf.c_str());
-								break;
-							}
-
-							Sheet * sheet = wb->get_sheet (wb, packet[0]);
-							if (IS_NULL (sheet)) {
-								g_warning ("Unable to load geometry file; sheet '%s'"
-											  " does not exist", packet[0]);
-								break;
-							}
-	      
-							sheet->load (sheet, packet[1]);
-						}
-						break;
-						/* ^time^type^sheet_name^savepath */
-						case Packet::TYPE_SAVESHEET: {
-							if (packet.size() != 2) {
-								g_warning ("Packet::TYPE_SAVESHEET: Wrong packet format: %s",
-											  buf.c_str());
-								break;
-							}
-		      
-							Sheet * sheet = wb->get_sheet (wb, packet[0]);
-							if (IS_NULL (sheet)) {
-								g_warning ("Failed saving sheet '%s'; does not exist",
-											  packet[0]);
-								break;
-							}
-	      
-							if (sheet->save (sheet, packet[1]) == FALSE) {
-								g_warning ("Unable to save sheet.");
-								break;
-							}
-						}
-						break;
-						/* ^time^type^sheet_name^position */
-						case Packet::TYPE_MOVESHEETINDEX: {
-							if (packet.size() != 2) {
-								g_warning ("Packet::TYPE_MOVESHEETINDEX: Wrong packet "
-											  "format: %s", buf.c_str());
-								break;
-							}
-
-							Sheet * sheet = wb->get_sheet (wb, packet[0]);
-							if (IS_NULL (sheet)) {
-								g_warning ("Failed moving sheet '%s' to %d:"
-											  " Does not exist", packet[0], atoi(packet[1]));
-								break;
-							}
-		      
-							if (wb->move_sheet_index (wb, sheet, atoi(packet[1])) == FALSE) {
-								g_warning ("Failed moving sheet '%s' to %d:"
-											  " Invaild index\n", packet[0], atoi(packet[1]));
-							}
-						}
-						break;
-						/* ^time^type^sheet_name */
-						case Packet::TYPE_REMSHEET: {
-							if (packet.size() != 1) {
-								g_warning ("Packet::TYPE_REMSHEET: Wrong packet format: %s",
-											  buf.c_str());
-								break;
-							}
-		      
-							Sheet * sheet = wb->get_sheet (wb, packet[0]);
-							if (IS_NULL (sheet)) {
-								g_warning ("Failed removing sheet '%s':"
-											  " Does not exist", packet[0]);
-								break;
-							}
-							wb->remove_sheet (wb, sheet);
-							sheet->destroy (sheet);
-						}
-						break;
-						/* ^time^type^sheet_name^max_row^max_column */
-						case Packet::TYPE_ADDSHEET: {
-							if (packet.size() != 3) {
-								g_warning ("Packet::TYPE_ADDSHEET: Wrong packet format: %s",
-											  buf.c_str());
-								break;
-							}
-		      
-							wb->add_new_sheet (wb, 
-													 packet[0],
-													 atoi (packet[1]),
-													 atoi (packet[2]));
-						}
-						break;
-						/* ^time^type^sheet_name^row^column^format^data */
-						case Packet::TYPE_UPDATECELL: {
-							if (packet.size() != 5) {
-								g_warning ("Packet::TYPE_UPDATESHEET: Wrong packet "
-											  "format: %s", buf.c_str());
-								break;
-							}
-		      
-							Sheet * sheet = wb->get_sheet (wb, packet[0]);
-							if (IS_NULL (sheet)) {
-								g_warning ("Invaild sheet name '%s': Does not exist",
-											  packet[0]);
-								break;
-							}
-	            
-							cell->set_row (cell, atoi (packet[1]) );
-							cell->set_column (cell, atoi (packet[2]) );
-	      
-							if (strlen (packet[3]) > 0) {
-								Map<String,String> fmt = packet.parseFormatString (packet[3]);
-		
-								if (fmt["bgcolor"].length() > 0)
-									cell->set_bgcolor (cell, fmt["bgcolor"].c_str());
-								if (fmt["fgcolor"].length() > 0)
-									cell->set_fgcolor (cell, fmt["fgcolor"].c_str());
-								if (fmt["justification"].length() > 0)
-									cell->set_justification (cell, 
-																	 (GtkJustification)
-																	 atoi (fmt["justification"].c_str()));
-							}
-	      
-							cell->set_value (cell, packet[4]);
-
-							gdk_threads_enter();
-								
-							sheet->apply_cell (sheet, cell);
-
-							gdk_threads_leave();
-								
-							if (this->verbosity > 0) {
-								g_message ("Cell (%d,%d) updated", 
-											  cell->row, cell->column);
-							}
-						}
-						break;
-					}
+					Update * update = new Update;
+
+					update->wb = this->wb;
+					update->snapshots = this->snapshots;
+					update->verbosity = this->verbosity;
+					update->packet = packet;
+					update->line = buf;
+					wb->scheduler->push (wb->scheduler, PacketParser::apply, update, PacketParser::release);
 		
 					fprintf (pktlog, "%s\n", buf.c_str());
 					fflush (pktlog);
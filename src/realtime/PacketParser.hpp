@@ -20,6 +20,7 @@
 #define HPP_PACKETHANDLER
 
 #include <proactor/Worker.hpp>
+#include <workers/SnapshotWorker.hpp>
 #include "Packet.hpp"
 #include <libgtkworkbook/cell.h>
 #include <libgtkworkbook/sheet.h>
@@ -37,10 +38,23 @@ namespace realtime {
 	private:
 		Workbook * wb;
 		FILE * pktlog;
-		Cell * cell;
 		int verbosity;
+		SnapshotWorker * snapshots;
+
+		// A parsed packet on its way to the main loop.
+		struct Update {
+			Workbook * wb;
+			SnapshotWorker * snapshots;
+			int verbosity;
+			Packet packet;
+			std::string line;
+		};
+
+		static void apply (Scheduler * scheduler, gpointer data);
+		static void release (gpointer data);
 	public:
-		PacketParser (Workbook * wb, FILE * pktlog, int verbosity);
+		PacketParser (Workbook * wb, FILE * pktlog, int verbosity,
+						  SnapshotWorker * snapshots);
 		virtual ~PacketParser (void);
 
 		void * run (void * null);
@@ -117,6 +117,7 @@ Realtime::Realtime (Application * appstate, Handle * platform)
 
 	this->wb = workbook_open (appstate->gtkwindow(), "realtime");
 	this->packet_parser = NULL;
+	this->snapshot_worker = NULL;
 	this->tcp_server = NULL;
 }
 
@@ -143,6 +144,12 @@ Realtime::~Realtime (void) {
 		delete this->packet_parser;
 	}
 
+	// Queued saves are finished before this returns.
+	if (this->snapshot_worker) {
+		this->snapshot_worker->stop();
+		delete this->snapshot_worker;
+	}
+
 	if (this->tcp_server) {
 		this->tcp_server->stop();
 		delete this->tcp_server;
@@ -193,18 +200,32 @@ Realtime::OpenTcpServer (int port) {
 	if (this->tcp_server == NULL) {
 		int eventId = proactor::Event::uniqueEventId();
 		NetworkDispatcher * nd = new NetworkDispatcher (eventId);
-		PacketParser * pp = new PacketParser (this->workbook(), this->pktlog, 0);
+		SnapshotWorker * sw = new SnapshotWorker (this->app()->proactor(), eventId);
+		PacketParser * pp = new PacketParser (this->workbook(), this->pktlog, 0, sw);
 		
 		if (nd->start() == false) {
 			g_critical ("Failed starting network dispatcher for tcp server");
+			delete pp;
+			delete sw;
+			return false;
+		}
+
+		// Sheets are saved and loaded on this thread; it reports back to the
+		// packet parser through the proactor.
+		if (sw->start() == false) {
+			g_critical ("Failed starting snapshot worker for tcp server");
+			delete pp;
+			delete sw;
 			return false;
 		}
 
 		if (this->app()->proactor()->addWorker (eventId, pp) == false) {
 			g_critical ("Failed starting packet parser for tcp server");
+			delete sw;
 			return false;
 		}
 		
+		this->snapshot_worker = sw;
 		this->tcp_server = nd;
 		this->packet_parser = pp;
 	}
@@ -243,7 +264,15 @@ Realtime::OpenTcpClient (Sheet * sheet, const std::string & address, int port) {
 	// up with a simple way to strap on the ability to have multiple sheets without the need
 	// for an additioanl dispatcher/csv combo I would. It totally destroys the principle of
 	// the proactor design.
+	// A stream never ends; with stream :: tail=1 the sheet only keeps its newest rows.
+	ConfigPair * tail =
+		this->app()->config()->get_pair (this->app()->config(), "realtime", "stream", "tail");
+
+	if (!IS_NULL (tail) && atoi (tail->value) == 1)
+		sheet->set_tail (sheet, TRUE);
+
 	CsvParser * csv = new CsvParser (sheet, this->pktlog, 0);
+
 	if (this->app()->proactor()->addWorker (eventId, csv) == false) {
 		g_critical ("Failed starting csv parser and adding to proactor for %s:%d",
 						address.c_str(), port);
@@ -25,6 +25,7 @@
 #include <memory>
 #include <concurrent/Thread.hpp>
 #include <workers/CsvParser.hpp>
+#include <workers/SnapshotWorker.hpp>
 #include "../Plugin.hpp"
 #include "../Application.hpp"
 #include "../config.h"
@@ -44,6 +45,7 @@ namespace realtime {
 		FILE * pktlog;
 		NetworkDispatcher * tcp_server;
 		PacketParser * packet_parser;
+		SnapshotWorker * snapshot_worker;
 		
 		GtkWidget * CreateMainMenu (void);
 	public:
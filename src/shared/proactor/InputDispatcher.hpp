@@ -40,6 +40,10 @@ namespace proactor {
 			this->inputQueue.push ( Event (getEventId(), std::string(buf)) );
 		}
 
+		inline void onReadComplete (const char * buf, size_t length) {
+			this->inputQueue.push ( Event (getEventId(), std::string (buf, length)) );
+		}
+
 		inline void onReadComplete (const std::string & buf) {
 			this->inputQueue.push ( Event (getEventId(), std::string (buf) ) );
 		}
@@ -18,6 +18,112 @@
 */
 #include "CsvParser.hpp"
 #include <iostream>
+#include <cstring>
+
+/* The rows of one commit, on their way to the main loop. The sheet is
+	looked up by name when they get there, since it may have been removed
+	in the meantime; a new Sheet that took over the name is left alone. */
+struct csv_block {
+	Workbook * wb;
+	std::string name;
+	guint serial;
+	int row;
+	int rows;
+	std::string bytes;
+	std::vector<gsize> offsets;
+};
+
+/* Installs a block of rows from the main loop: a single apply_block for a
+	windowed sheet, or apply_rows over the slots of a tail sheet. The
+	scheduler holds the sheet, so the whole frame is drawn once. */
+static void
+commit_apply (Scheduler * scheduler, gpointer data) {
+	struct csv_block * block = (struct csv_block *)data;
+	Sheet * sheet = block->wb->get_sheet (block->wb, block->name.c_str());
+
+	if (sheet == NULL || sheet->serial != block->serial)
+		return;
+
+	// A new window is written over the sheet; everything from the last one
+	// has already been applied to the GtkSheet.
+	if (block->row == 0)
+		sheet->reset_values (sheet);
+
+	scheduler->hold (scheduler, sheet);
+
+	if (sheet->tail == FALSE) {
+		sheet->apply_block (sheet,
+								  block->row,
+								  block->rows,
+								  sheet->max_columns,
+								  &block->offsets[0],
+								  block->bytes.data());
+		return;
+	}
+
+	for (int ii = 0; ii < block->rows; ii++) {
+		int slot = (block->row + ii) % sheet->max_rows;
+
+		for (int jj = 0; jj < sheet->max_columns; jj++) {
+			const char * value = block->bytes.data() + block->offsets[ii * sheet->max_columns + jj];
+			sheet->set_cell_value_length (sheet, slot, jj, (void *)value, strlen (value));
+		}
+	}
+	sheet->apply_rows (sheet, block->row, block->rows);
+}
+
+static void
+commit_free (gpointer data) {
+	delete (struct csv_block *)data;
+}
+
+/* Hands every row that has been staged since the last commit over to the
+	main loop. The staged buffers are swapped into the block, so nothing is
+	copied and the parser never waits for the GDK lock; it only waits for
+	the main loop to catch up once too many updates are pending. */
+static void
+commit (struct csv_column * column) {
+	const struct csv_sheet * sheet = column->sheet;
+	int rows = column->row - column->block_row;
+
+	if (rows > 0) {
+		Scheduler * scheduler = sheet->wb->scheduler;
+		struct csv_block * block = new csv_block;
+
+		while (g_atomic_int_get (&scheduler->pending) >= SCHEDULER_HIGH_WATER
+				 && column->parser->isRunning() == true)
+			concurrent::Thread::sleep (1);
+
+		block->wb = sheet->wb;
+		block->name = sheet->name;
+		block->serial = sheet->serial;
+		block->row = column->block_row;
+		block->rows = rows;
+		block->bytes.swap (*column->bytes);
+		block->offsets.swap (*column->offsets);
+		scheduler->push (scheduler, commit_apply, block, commit_free);
+	}
+
+	column->offsets->clear();
+	column->bytes->assign (1, '\0');
+	column->block_row = column->row;
+	gettimeofday (&column->block_start, NULL);
+}
+
+/* Returns true once the staged rows have either reached the row bound or
+	the oldest of them has waited for longer than the time budget. */
+static bool
+commit_due (struct csv_column * column) {
+	struct timeval now;
+
+	if (column->row - column->block_row >= CSV_BLOCK_ROWS)
+		return true;
+
+	gettimeofday (&now, NULL);
+	long ms = ((now.tv_sec - column->block_start.tv_sec) * 1000)
+		+ ((now.tv_usec - column->block_start.tv_usec) / 1000);
+	return (ms >= CSV_BLOCK_MILLISECONDS);
+}
 
 /* This structure is due to the libcsv parser; it uses function pointers to
 	do any work inside of an actual tuple. So the cb1 is called after a field
@@ -25,27 +131,65 @@
 static void 
 cb1 (void * s, size_t length, void * data) {
 	struct csv_column * column = (struct csv_column *)data;
-	
-	column->sheet->set_cell_value_length (column->sheet, column->row, column->field++, s, length);
+
+	if (column->field++ < column->sheet->max_columns) {
+		column->offsets->push_back (column->bytes->size());
+		column->bytes->append ((const char *)s, length);
+		column->bytes->push_back ('\0');
+	}
 }
   
 static void
 cb2 (int c, void * data) {
 	struct csv_column * column = (struct csv_column *)data;
 
-	gdk_threads_enter();
-	column->sheet->apply_row (column->sheet, column->row);
-	gdk_threads_leave();
+	// Short rows are padded out with the empty value at the front of bytes.
+	for (; column->field < column->sheet->max_columns; column->field++)
+		column->offsets->push_back (0);
 	
 	column->row++;
 	column->field = 0;
+
+	// A tail sheet scrolls on its own; its rows are a ring of slots, and a
+	// block never wraps past the last one.
+	if (column->sheet->tail == true && column->row >= column->sheet->max_rows) {
+		commit (column);
+		column->row = column->block_row = 0;
+	}
+	else if (commit_due (column) == true)
+		commit (column);
+}
+
+/* Sets the column titles from the first row of the sheet. It is queued
+	behind the first block, so that row is already in the GtkSheet. */
+static void
+header_apply (Scheduler * scheduler, gpointer data) {
+	struct csv_block * block = (struct csv_block *)data;
+	Sheet * sheet = block->wb->get_sheet (block->wb, block->name.c_str());
+
+	if (sheet == NULL || sheet->serial != block->serial)
+		return;
+
+	Row * header = row_new (sheet->max_columns);
+
+	sheet->get_row (sheet, 0, header->cells, header->size);
+	for (int ii = 0; ii < header->size; ii++)
+		sheet->set_column_title (sheet, ii, header->cells[ii]->methods->get_value (header->cells[ii]));
+
+	header->destroy (header);
 }
 
 CsvParser::CsvParser (Sheet * sheet,
 							 FILE * log,
 							 int verbosity)
-	: sheet(sheet), log (log) {
-	this->wb = sheet->workbook;
+	: log (log) {
+	this->sheet.wb = sheet->workbook;
+	this->sheet.name = sheet->name;
+	this->sheet.serial = sheet->serial;
+	this->sheet.max_rows = sheet->max_rows;
+	this->sheet.max_columns = sheet->max_columns;
+	this->sheet.tail = (sheet->tail == TRUE);
+	this->sheet.windowed = (sheet->window_request != NULL);
 }
 
 CsvParser::~CsvParser (void) {
@@ -68,6 +212,14 @@ CsvParser::process (std::queue<std::string> & queue,
 		if (this->isRunning() == false)
 			break;
 
+		// Every read of a windowed sheet hands over a whole window, which is
+		// written over the sheet from row 0 no matter how short the last
+		// one was.
+		if (sheet.windowed == true && column.row > 0) {
+			commit (&column);
+			column.row = column.block_row = 0;
+		}
+
 		if ((bytes = csv_parse (&csv, str.c_str(), bytes, cb1, cb2, &column)) == bytes) {
 			if (csv_error (&csv) == CSV_EPARSE) {
 				std::cerr << "Parsing error on input: "<<"\n";
@@ -77,11 +229,14 @@ CsvParser::process (std::queue<std::string> & queue,
 				
 		csv_fini (&csv, cb1, cb2, &column);
 			
-		if (column.row >= sheet->max_rows) {
-			column.row = 0;
+		if (column.row >= sheet.max_rows) {
+			commit (&column);
+			column.row = column.block_row = 0;
 			break;
 		}
 	}
+
+	commit (&column);
 }
 
 void *
@@ -89,7 +244,12 @@ CsvParser::run (void * null) {
 	std::queue<std::string> queue;
 	struct csv_parser csv;
 	char buf[1024];
-	struct csv_column column = {sheet,0,0,&buf[0]};
+	std::string bytes (1, '\0');
+	std::vector<gsize> offsets;
+	struct csv_column column = {&sheet,0,0,&buf[0],0,&bytes,&offsets};
+
+	column.parser = this;
+	gettimeofday (&column.block_start, NULL);
 	
 	if (csv_init (&csv, CSV_STRICT) != 0) {
 		std::cerr << "Failed initializing libcsv parser library\n";
@@ -107,12 +267,15 @@ CsvParser::run (void * null) {
 	
 	this->process(queue, csv, column);
 
-	// Assign the first row of the input to our header row.
-	gdk_threads_enter();
-	for (int ii = 0; ii < sheet->max_columns; ii++) {
-		sheet->set_column_title (sheet, ii, sheet->cells[0][ii]->value->str);
-	}
-	gdk_threads_leave();
+	// Assign the first row of the input to our header row. The block only
+	// carries the sheet's name.
+	struct csv_block * header = new csv_block;
+
+	header->wb = sheet.wb;
+	header->name = sheet.name;
+	header->serial = sheet.serial;
+	header->row = header->rows = 0;
+	sheet.wb->scheduler->push (sheet.wb->scheduler, header_apply, header, commit_free);
 	
 	while (this->isRunning() == true) {
 		while (this->inputQueue.size() == 0) {
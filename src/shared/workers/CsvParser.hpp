@@ -24,23 +24,54 @@
 #include <libgtkworkbook/workbook.h>
 #include <concurrent/Thread.hpp>
 #include <libcsv/csv.h>
+#include <sys/time.h>
 #include <queue>
 #include <string>
+#include <vector>
+
+// Parsed rows are committed to the sheet once this many are staged, or once
+// the oldest of them has waited this long.
+const int CSV_BLOCK_ROWS = 1000;
+const int CSV_BLOCK_MILLISECONDS = 50;
+
+// What the parser needs to know about its sheet, copied when it is made.
+// The parser runs on its own thread and the Sheet may be removed and
+// destroyed from the main loop at any time, so it is never touched there.
+struct csv_sheet {
+	Workbook * wb;
+	std::string name;
+	guint serial;
+	int max_rows;
+	int max_columns;
+	bool tail;
+	bool windowed;
+};
 
 struct csv_column {
-	Sheet * sheet;
+	const struct csv_sheet * sheet;
 	int row;
 	int field;
 	char * value;
+
+	// Rows from block_row on are staged here and not yet handed over to the
+	// workbook's scheduler.
+	int block_row;
+	std::string * bytes;
+	std::vector<gsize> * offsets;
+	struct timeval block_start;
+
+	// Commits wait while the workbook's scheduler is backed up, for as long
+	// as this is running.
+	concurrent::Thread * parser;
 };
 
 class CsvParser : public proactor::Worker {
 private:
-	Sheet * sheet;
-	Workbook * wb;
+	struct csv_sheet sheet;
 	FILE * log;
 	int verbosity;
 public:
+	// The sheet has to be made a tail or a window before this.
 	CsvParser (Sheet * sheet, FILE * log, int verbosity);
 	virtual ~CsvParser (void);
 
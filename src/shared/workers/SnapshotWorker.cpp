@@ -0,0 +1,194 @@
+/*
+  The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+  Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include "SnapshotWorker.hpp"
+#include <sstream>
+#include <ctime>
+
+SnapshotWorker::SnapshotWorker (proactor::Proactor * pro, int eventId)
+	: pending(0), pro(pro), eventId(eventId) {
+}
+
+SnapshotWorker::~SnapshotWorker (void) {
+	if (this->isRunning() == true)
+		this->stop();
+
+	// Nothing is left unless the worker was never started.
+	while (this->jobs.size() > 0) {
+		Job job = this->jobs.pop();
+		if (job.snapshot)
+			job.snapshot->destroy (job.snapshot);
+	}
+}
+
+/* @description: This method queues a Snapshot to be committed to a file.
+   The worker owns the Snapshot from here on. 
+   @sheet: The Sheet that the Snapshot was taken of.
+   @snapshot: The Snapshot returned by sheet->snapshot.
+   @filepath: The file that it was taken for. */
+void
+SnapshotWorker::save (Sheet * sheet, Snapshot * snapshot, const std::string & filepath) {
+	Job job = { Job::SAVE, sheet, snapshot, sheet->name, filepath };
+
+	this->pending_lock.lock();
+	this->pending++;
+	this->pending_lock.unlock();
+	this->jobs.push (job);
+}
+
+/* @description: This method queues a file to be loaded into a Sheet.
+   @sheet: The Sheet to load into.
+   @filepath: The file to load. */
+void
+SnapshotWorker::load (Sheet * sheet, const std::string & filepath) {
+	Job job = { Job::LOAD, sheet, NULL, sheet->name, filepath };
+
+	this->pending_lock.lock();
+	this->pending++;
+	this->pending_lock.unlock();
+	this->jobs.push (job);
+}
+
+/* @description: This method destroys a Sheet once every job that has been
+   queued so far is done. The Sheet has to have been taken out of its
+   workbook (remove_sheet) already; it is destroyed from the main loop.
+   @sheet: The Sheet to destroy. */
+void
+SnapshotWorker::destroy (Sheet * sheet) {
+	Job job = { Job::DESTROY, sheet, NULL, sheet->name, std::string() };
+
+	this->jobs.push (job);
+}
+
+/* @description: This method blocks until every job that has been queued so
+   far is done. */
+void
+SnapshotWorker::wait (void) {
+	for (;;) {
+		this->pending_lock.lock();
+		int count = this->pending;
+		this->pending_lock.unlock();
+
+		if (count == 0 || this->isRunning() == false)
+			break;
+		Thread::sleep (1);
+	}
+}
+
+void
+SnapshotWorker::finish (void) {
+	this->pending_lock.lock();
+	this->pending--;
+	this->pending_lock.unlock();
+}
+
+void
+SnapshotWorker::complete (const Job & job, bool result) {
+	std::stringstream s;
+
+	// The filepath goes last since it may hold the delimiter.
+	s << "^" << time (NULL) << "^7^" << job.name << "^" << (job.kind == Job::SAVE ? "save" : "load")
+	  << "^" << (result ? 1 : 0) << "^" << job.filepath;
+
+	if (this->pro)
+		this->pro->onReadComplete (this->eventId, s.str().c_str());
+}
+
+/* @description: This function applies a loaded Snapshot from the main
+   loop. The Sheet is looked up by name again, since it may have been
+   removed in the meantime; a new Sheet that took over the name is left
+   alone. */
+void
+SnapshotWorker::apply (Scheduler * scheduler, gpointer data) {
+	Load * load = (Load *)data;
+	Sheet * sheet = load->wb->get_sheet (load->wb, load->name.c_str());
+
+	if (sheet == NULL || sheet->serial != load->serial)
+		return;
+
+	scheduler->hold (scheduler, sheet);
+	sheet->apply_snapshot (sheet, load->snapshot);
+}
+
+/* @description: This function destroys a Sheet from the main loop, once
+   the jobs that were queued ahead of it are done. */
+void
+SnapshotWorker::discard (Scheduler * scheduler, gpointer data) {
+	Sheet * sheet = (Sheet *)data;
+
+	scheduler->release (scheduler);
+	sheet->destroy (sheet);
+}
+
+void
+SnapshotWorker::release (gpointer data) {
+	Load * load = (Load *)data;
+
+	load->snapshot->destroy (load->snapshot);
+	delete load;
+}
+
+void *
+SnapshotWorker::run (void * null) {
+	// Saves that are still queued when the worker is stopped are finished
+	// first; loads are dropped since the sheets are going away.
+	for (;;) {
+		if (this->jobs.size() == 0) {
+			if (this->isRunning() == false)
+				return NULL;
+			Thread::sleep (1);
+			continue;
+		}
+
+		Job job = this->jobs.pop();
+		bool result = false;
+
+		if (job.kind == Job::DESTROY) {
+			Scheduler * scheduler = job.sheet->workbook->scheduler;
+
+			scheduler->push (scheduler, SnapshotWorker::discard, job.sheet, NULL);
+			continue;
+		}
+
+		if (job.kind == Job::SAVE) {
+			result = job.sheet->commit (job.sheet, job.snapshot, job.filepath.c_str());
+			job.snapshot->destroy (job.snapshot);
+		}
+		else if (this->isRunning() == true) {
+			Snapshot * snapshot = snapshot_new (-1, -1, FALSE);
+
+			if (snapshot->read (snapshot, job.filepath.c_str()) == TRUE) {
+				Workbook * wb = job.sheet->workbook;
+				Load * load = new Load;
+
+				load->wb = wb;
+				load->name = job.name;
+				load->serial = job.sheet->serial;
+				load->snapshot = snapshot;
+				wb->scheduler->push (wb->scheduler, SnapshotWorker::apply, load, SnapshotWorker::release);
+				result = true;
+			}
+			else
+				snapshot->destroy (snapshot);
+		}
+
+		this->finish();
+		this->complete (job, result);
+	}
+	return NULL;
+}
@@ -0,0 +1,85 @@
+/*
+  The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+  Copyright (C) 2008, 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef HPP_SNAPSHOTWORKER
+#define HPP_SNAPSHOTWORKER
+
+#include <proactor/Proactor.hpp>
+#include <concurrent/Thread.hpp>
+#include <concurrent/Queue.hpp>
+#include <concurrent/Mutex.hpp>
+#include <libgtkworkbook/sheet.h>
+#include <libgtkworkbook/workbook.h>
+#include <string>
+
+/* This thread saves and loads sheets in the background. A save is handed a
+	Snapshot that was already taken (under the GDK lock) by whoever asked for
+	it, so the caller only pays for copying the cells out of the GtkSheet; the
+	encoding and the disk I/O happen here. A load reads the file here and
+	hands it to the workbook's scheduler to be applied, as long as the Sheet it
+	was meant for is still there. A Sheet that has been taken out of its
+	workbook can be handed over to be destroyed once the jobs queued ahead of
+	it are done, so nobody has to wait for them. Jobs run one at a time, in
+	the order in which they were queued, and every save and load is reported
+	back through the proactor as a packet on eventId, with the filepath as the
+	rest of the line:
+
+	^time^7^sheet_name^save|load^1|0^filepath */
+class SnapshotWorker : public concurrent::Thread {
+private:
+	struct Job {
+		enum { SAVE, LOAD, DESTROY } kind;
+		Sheet * sheet;
+		Snapshot * snapshot;
+		std::string name;
+		std::string filepath;
+	};
+	typedef concurrent::Queue<Job> JobQueueType;
+
+	struct Load {
+		Workbook * wb;
+		std::string name;
+		guint serial;
+		Snapshot * snapshot;
+	};
+
+	JobQueueType jobs;
+	concurrent::Mutex pending_lock;
+	int pending;
+	proactor::Proactor * pro;
+	int eventId;
+
+	void complete (const Job & job, bool result);
+	void finish (void);
+
+	static void apply (Scheduler * scheduler, gpointer data);
+	static void release (gpointer data);
+	static void discard (Scheduler * scheduler, gpointer data);
+public:
+	SnapshotWorker (proactor::Proactor * pro, int eventId);
+	virtual ~SnapshotWorker (void);
+
+	void save (Sheet * sheet, Snapshot * snapshot, const std::string & filepath);
+	void load (Sheet * sheet, const std::string & filepath);
+	void wait (void);
+	void destroy (Sheet * sheet);
+
+	void * run (void * null);
+};
+
+#endif
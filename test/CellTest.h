@@ -34,7 +34,7 @@ public:
 	}
 
 	virtual void TearDown (void) {
-		cell->destroy (cell);
+		cell->methods->destroy (cell);
 		SheetTest::TearDown();
 	}
 };
@@ -0,0 +1,56 @@
+/*
+  The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+  Copyright (C) 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#ifndef FILEINDEX_TEST_H
+#define FILEINDEX_TEST_H
+
+// The testing fixture for the largefile FileIndex object: a small file with
+// four lines, and the sidecar that its index is saved to.
+
+#include <gtest/gtest.h>
+#include "../src/largefile/FileIndex.hpp"
+#include <cstdio>
+#include <unistd.h>
+
+class FileIndexTest : public ::testing::Test {
+protected:
+	std::string filename;
+	std::string indexpath;
+	largefile::IndexStamp stamp;
+	largefile::FileIndex * marks;
+public:
+	virtual void SetUp (void) {
+		this->filename = "fileindex_test.csv";
+		this->indexpath = "fileindex_test.csv.idx";
+
+		FILE * fp = fopen (this->filename.c_str(), "w");
+		fputs ("a,1\nb,2\nc,3\nd,4\n", fp);
+		fclose (fp);
+
+		largefile::FileIndex::Stamp (this->filename, this->stamp);
+		this->marks = new largefile::FileIndex;
+	}
+
+	virtual void TearDown (void) {
+		delete this->marks;
+		unlink (this->filename.c_str());
+		unlink (this->indexpath.c_str());
+	}
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+  The GTKWorkbook Project <http://gtkworkbook.sourceforge.net/>
+  Copyright (C) 2009 John Bellone, Jr. <jvb4@njit.edu>
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PRACTICAL PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with the library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
+*/
+#include "FileIndexTest.h"
+
+using namespace largefile;
+
+TEST_F (FileIndexTest, FixtureIsWorking) {
+	EXPECT_TRUE (marks != NULL);
+	EXPECT_EQ (16, stamp.size);
+}
+
+TEST_F (FileIndexTest, SaveAndLoadWorks) {
+	marks->Add (8, 2);
+	marks->Add (16, 4);
+	marks->setLines (4);
+
+	EXPECT_TRUE (marks->Save (indexpath, stamp));
+
+	FileIndex loaded;
+	EXPECT_TRUE (loaded.Load (indexpath, stamp));
+	EXPECT_TRUE (loaded.isFinished());
+	EXPECT_EQ (4, loaded.lines());
+	ASSERT_EQ (3, loaded.size());
+	EXPECT_EQ (0, loaded.get(0)->line);
+	EXPECT_EQ (8, loaded.get(1)->byte);
+	EXPECT_EQ (2, loaded.get(1)->line);
+	EXPECT_EQ (16, loaded.get(2)->byte);
+	EXPECT_EQ (4, loaded.get(2)->line);
+}
+
+// A mark that was never indexed is left out, rather than keeping the rest
+// of the index from being loaded again.
+TEST_F (FileIndexTest, SaveSkipsUnpublishedMarks) {
+	marks->Add (8, 2);
+	marks->Add (16, -1);
+	marks->setLines (4);
+
+	EXPECT_TRUE (marks->Save (indexpath, stamp));
+
+	FileIndex loaded;
+	EXPECT_TRUE (loaded.Load (indexpath, stamp));
+	ASSERT_EQ (2, loaded.size());
+	EXPECT_EQ (8, loaded.get(1)->byte);
+	EXPECT_EQ (2, loaded.get(1)->line);
+}
+
+TEST_F (FileIndexTest, LoadRejectsAChangedFile) {
+	marks->Add (8, 2);
+	marks->setLines (4);
+
+	EXPECT_TRUE (marks->Save (indexpath, stamp));
+
+	IndexStamp changed = stamp;
+	changed.size++;
+
+	FileIndex loaded;
+	EXPECT_FALSE (loaded.Load (indexpath, changed));
+}
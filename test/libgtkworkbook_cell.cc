@@ -25,21 +25,33 @@ TEST_F (CellTest, FixtureIsWorking) {
 }
 
 TEST_F (CellTest, MethodSetWorks) {
-	EXPECT_STREQ ("", cell->value->str);
+	EXPECT_STREQ ("", cell->methods->get_value (cell));
 
-	cell->set(cell, 0, 1, "2");
+	cell->methods->set(cell, 0, 1, "2");
 
 	EXPECT_EQ (0,   cell->row);
 	EXPECT_EQ (1,   cell->column);
-	EXPECT_STREQ ("2", cell->value->str);
+	EXPECT_STREQ ("2", cell->methods->get_value (cell));
 }
 
 TEST_F (CellTest, MethodSetValueWorks) {
-	EXPECT_STREQ ("", cell->value->str);
+	EXPECT_STREQ ("", cell->methods->get_value (cell));
 
-	cell->set_value (cell, "testing");
+	cell->methods->set_value (cell, "testing");
 
-	EXPECT_STREQ ("testing", cell->value->str);
+	EXPECT_STREQ ("testing", cell->methods->get_value (cell));
+}
+
+TEST_F (CellTest, LongValuesAreNotInline) {
+	const gchar * value = "a value that is much too long to be stored inline";
+
+	cell->methods->set_value (cell, value);
+	EXPECT_EQ ((guint)CELL_VALUE_HEAP, (guint)cell->storage);
+	EXPECT_STREQ (value, cell->methods->get_value (cell));
+
+	cell->methods->set_value (cell, "short");
+	EXPECT_EQ ((guint)CELL_VALUE_INLINE, (guint)cell->storage);
+	EXPECT_STREQ ("short", cell->methods->get_value (cell));
 }
 
 TEST_F (CellTest, MethodSetColumnWorks) {
@@ -47,7 +59,7 @@ TEST_F (CellTest, MethodSetColumnWorks) {
 
 	EXPECT_EQ (0, cell->column);
 
-	cell->set_column (cell, 2);
+	cell->methods->set_column (cell, 2);
 
 	EXPECT_EQ (2, cell->column);
 }
@@ -57,7 +69,7 @@ TEST_F (CellTest, MethodSetRowWorks) {
 
 	EXPECT_EQ (0, cell->row);
 
-	cell->set_row (cell, 2);
+	cell->methods->set_row (cell, 2);
 
 	EXPECT_EQ (2, cell->row);
 }
@@ -73,7 +85,7 @@ TEST_F (CellTest, MethodSetRangeWorks) {
 	EXPECT_EQ (0, cell->range.col0);
 	EXPECT_EQ (0, cell->range.coli);
 
-	cell->set_range (cell, &range);
+	cell->methods->set_range (cell, &range);
 
 	EXPECT_EQ (1, cell->range.row0);
 	EXPECT_EQ (3, cell->range.rowi);
@@ -82,67 +94,129 @@ TEST_F (CellTest, MethodSetRangeWorks) {
 }
 
 TEST_F (CellTest, MethodSetJustificationWorks) {
-	EXPECT_EQ (GTK_JUSTIFY_LEFT, cell->attributes.justification);
+	EXPECT_EQ (GTK_JUSTIFY_LEFT, (GtkJustification)cell->attributes.justification);
 
-	cell->set_justification (cell, GTK_JUSTIFY_RIGHT);
+	cell->methods->set_justification (cell, GTK_JUSTIFY_RIGHT);
 
-	EXPECT_EQ (GTK_JUSTIFY_RIGHT, cell->attributes.justification);
+	EXPECT_EQ (GTK_JUSTIFY_RIGHT, (GtkJustification)cell->attributes.justification);
 }
 
 TEST_F (CellTest, MethodSetFgColorWorks) {
-	EXPECT_STREQ ("", (cell->attributes.fgcolor)->str);
+	EXPECT_STREQ ("", cell->methods->get_fgcolor (cell));
 
-	cell->set_fgcolor (cell, "black");
+	cell->methods->set_fgcolor (cell, "black");
 
-	EXPECT_STREQ ("black", (cell->attributes.fgcolor)->str);
+	EXPECT_STREQ ("black", cell->methods->get_fgcolor (cell));
 }
 
 TEST_F (CellTest, MethodSetBgColorWorks) {
-	EXPECT_STREQ ("", (cell->attributes.bgcolor)->str);
+	EXPECT_STREQ ("", cell->methods->get_bgcolor (cell));
+
+	cell->methods->set_bgcolor (cell, "white");
+
+	EXPECT_STREQ ("white", cell->methods->get_bgcolor (cell));
+}
+
+TEST_F (CellTest, ColorsAreInterned) {
+	Cell * other = cell_new();
+
+	cell->methods->set_bgcolor (cell, "#ffffcc");
+	other->methods->set_fgcolor (other, "#ffffcc");
+
+	EXPECT_NE (PALETTE_NONE, cell->attributes.bgcolor);
+	EXPECT_EQ (cell->attributes.bgcolor, other->attributes.fgcolor);
+
+	cell->methods->set_bgcolor (cell, "");
+	EXPECT_EQ (PALETTE_NONE, cell->attributes.bgcolor);
 
-	cell->set_bgcolor (cell, "white");
+	other->methods->destroy (other);
+}
+
+TEST_F (CellTest, SheetCellsUseWorkbookPalette) {
+	sheet->set_cell_value_length (sheet, 0, 0, (void*)"Foo", 3);
+	Cell * sc = sheet->get_cell (sheet, 0, 0);
+
+	ASSERT_TRUE (sc != NULL);
+	sc->methods->set_fgcolor (sc, "blue");
 
-	EXPECT_STREQ ("white", (cell->attributes.bgcolor)->str);
+	EXPECT_STREQ ("blue", sc->methods->get_fgcolor (sc));
+	EXPECT_STREQ ("blue", workbook->palette->lookup (workbook->palette,
+																	 sc->attributes.fgcolor));
 }
 
 TEST_F (CellTest, MethodSetEditableWorks) {
 	cell->attributes.editable = FALSE;
-	EXPECT_EQ (FALSE, cell->attributes.editable);
+	EXPECT_FALSE (cell->attributes.editable);
 
-	cell->set_editable (cell, TRUE);
-	EXPECT_EQ (TRUE, cell->attributes.editable);
+	cell->methods->set_editable (cell, TRUE);
+	EXPECT_TRUE (cell->attributes.editable);
 }
 
 TEST_F (CellTest, MethodSetHighlightedWorks) {
 	cell->attributes.highlighted = FALSE;
-	EXPECT_EQ (FALSE, cell->attributes.highlighted);
+	EXPECT_FALSE (cell->attributes.highlighted);
 
-	cell->set_highlighted (cell, TRUE);
-	EXPECT_EQ (TRUE, cell->attributes.highlighted);
+	cell->methods->set_highlighted (cell, TRUE);
+	EXPECT_TRUE (cell->attributes.highlighted);
 }
 
 TEST_F (CellTest, MethodSetAttributesWorks) {
+	Palette * palette = palette_default ();
 	CellAttributes attrib;
-	attrib.bgcolor = g_string_new_len ("black", 1024);
-	attrib.fgcolor = g_string_new_len ("white", 1024);
+	attrib.bgcolor = palette->intern (palette, "black");
+	attrib.fgcolor = palette->intern (palette, "white");
 	attrib.editable = FALSE;
 	attrib.highlighted = TRUE;
 	attrib.justification = GTK_JUSTIFY_FILL;
 	
-	EXPECT_STREQ ("", cell->attributes.fgcolor->str);
-	EXPECT_STREQ ("", cell->attributes.bgcolor->str);
-	EXPECT_EQ (TRUE, cell->attributes.editable);
-	EXPECT_EQ (FALSE, cell->attributes.highlighted);
-	EXPECT_EQ (GTK_JUSTIFY_LEFT, cell->attributes.justification);
+	EXPECT_STREQ ("", cell->methods->get_fgcolor (cell));
+	EXPECT_STREQ ("", cell->methods->get_bgcolor (cell));
+	EXPECT_TRUE (cell->attributes.editable);
+	EXPECT_FALSE (cell->attributes.highlighted);
+	EXPECT_EQ (GTK_JUSTIFY_LEFT, (GtkJustification)cell->attributes.justification);
 	
-	cell->set_attributes (cell, &attrib);
+	cell->methods->set_attributes (cell, &attrib);
 
-	EXPECT_STREQ ("white", cell->attributes.fgcolor->str);
-	EXPECT_STREQ ("black", cell->attributes.bgcolor->str);
-	EXPECT_EQ (FALSE, cell->attributes.editable);
-	EXPECT_EQ (TRUE, cell->attributes.highlighted);
-	EXPECT_EQ (GTK_JUSTIFY_FILL, cell->attributes.justification);
-	
-	g_string_free (attrib.fgcolor, TRUE);
-	g_string_free (attrib.bgcolor, TRUE);
+	EXPECT_STREQ ("white", cell->methods->get_fgcolor (cell));
+	EXPECT_STREQ ("black", cell->methods->get_bgcolor (cell));
+	EXPECT_FALSE (cell->attributes.editable);
+	EXPECT_TRUE (cell->attributes.highlighted);
+	EXPECT_EQ (GTK_JUSTIFY_FILL, (GtkJustification)cell->attributes.justification);
+}
+
+// Colors are parsed once per palette entry; #rrggbb does not go through gdk.
+TEST_F (CellTest, PaletteCachesColors) {
+	Palette * palette = workbook->palette;
+	GdkColormap * colormap = gtk_widget_get_colormap (sheet->gtk_sheet);
+	GdkColor a, b;
+
+	guint16 index = palette->intern (palette, "#ff8000");
+	ASSERT_TRUE (palette->get_color (palette, index, colormap, &a));
+	EXPECT_EQ (0xffff, a.red);
+	EXPECT_EQ (0x8080, a.green);
+	EXPECT_EQ (0x0000, a.blue);
+
+	ASSERT_TRUE (palette->get_color (palette, index, colormap, &b));
+	EXPECT_EQ (a.pixel, b.pixel);
+	EXPECT_FALSE (palette->get_color (palette, PALETTE_NONE, colormap, &b));
+	EXPECT_STREQ ("black", palette->lookup (palette, palette->black));
+}
+
+// A full palette hands out the closest color it holds instead of dropping one.
+TEST_F (CellTest, FullPaletteUsesClosestColor) {
+	Palette * palette = palette_new ();
+	gchar color[8];
+
+	for (guint ii = 0; palette->names->len <= PALETTE_MAX; ii++) {
+		g_snprintf (color, sizeof (color), "#%02x%02x00", (ii >> 8) & 0xff, ii & 0xff);
+		palette->intern (palette, color);
+	}
+
+	guint16 index = palette->intern (palette, "#0a0b01");
+	EXPECT_NE (PALETTE_NONE, index);
+	EXPECT_STREQ ("#0a0b00", palette->lookup (palette, index));
+	EXPECT_EQ (index, palette->intern (palette, "#0a0b01"));
+	EXPECT_EQ (PALETTE_NONE, palette->intern (palette, "not-a-color"));
+
+	palette->destroy (palette);
 }
@@ -17,6 +17,9 @@
   Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301 USA
 */
 #include "SheetTest.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
 
 // Basic sanity checks to make sure the underlying fixture is working.
 TEST_F (SheetTest, FixtureIsWorking) {
@@ -128,6 +131,79 @@ TEST_F (SheetTest, MethodFreezeAndThawSelectionWorks) {
 	EXPECT_STREQ ("Foo", gtksheet->data[1][1]->text);
 }
 
+// This test checks to make sure that frozen and highlighted selections are kept as ranges:
+//	a selection far larger than the Sheet is taken in one go, and thawing a hole in the
+//	middle of it only unfreezes the hole.
+TEST_F (SheetTest, MethodSelectionRangesWork) {
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+
+	sheet->frozen->add (sheet->frozen, 0, 0, 999999, 999);
+	sheet->highlighted->add (sheet->highlighted, 0, 0, 999999, 999);
+
+	EXPECT_TRUE (sheet->frozen->contains (sheet->frozen, 999999, 999));
+	EXPECT_FALSE (sheet->frozen->contains (sheet->frozen, 1000000, 0));
+	EXPECT_TRUE (sheet->is_highlighted (sheet, 500000, 500));
+
+	sheet->frozen->remove (sheet->frozen, 1, 1, 1, 1);
+	sheet->highlighted->clear (sheet->highlighted);
+
+	sheet->set_cell (sheet, 1, 1, "Foo");
+	sheet->set_cell (sheet, 1, 2, "Bar");
+
+	EXPECT_STREQ ("Foo", gtksheet->data[1][1]->text);
+	EXPECT_TRUE (gtksheet->data[1][2] == NULL || gtksheet->data[1][2]->text == NULL);
+	EXPECT_FALSE (sheet->is_highlighted (sheet, 500000, 500));
+
+	sheet->frozen->add (sheet->frozen, 1, 1, 1, 1);
+	EXPECT_EQ (1U, sheet->frozen->bands->len);
+}
+
+// Freezing a selection only paints the rows that are shown, and thawing it paints
+//	them back.
+TEST_F (SheetTest, MethodFreezeSelectionPaintsVisibleRows) {
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	gtksheet->view.row0 = 0; gtksheet->view.rowi = 1;
+	gtksheet->range.row0 = gtksheet->range.col0 = 0;
+	gtksheet->range.rowi = 4; gtksheet->range.coli = 1;
+
+	sheet->freeze_selection (sheet);
+
+	EXPECT_TRUE (sheet->frozen->contains (sheet->frozen, 4, 1));
+	EXPECT_TRUE (sheet->painted->contains (sheet->painted, 1, 1));
+	EXPECT_FALSE (sheet->painted->contains (sheet->painted, 2, 0));
+
+	sheet->thaw_selection (sheet);
+
+	EXPECT_FALSE (sheet->frozen->contains (sheet->frozen, 4, 1));
+	EXPECT_FALSE (sheet->painted->contains (sheet->painted, 1, 1));
+}
+
+// This test checks to make sure that the Sheet object's "apply_block" method installs
+//	a block of rows, clips whatever does not fit and leaves frozen cells alone.
+TEST_F (SheetTest, MethodApplyBlockWorks) {
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	const gchar bytes[] = "\0a\0b\0c";
+	gsize offsets[3 * 6] = { 0 };
+
+	offsets[0] = 1; offsets[1] = 3;	/* row 3 */
+	offsets[6] = 5; offsets[7] = 3;	/* row 4; column 1 is frozen */
+	offsets[5] = 5;						/* column 5 is outside of the Sheet */
+
+	// The cell has to be written before it is frozen; set_cell drops writes
+	// into frozen cells too.
+	sheet->set_cell (sheet, 4, 1, "frozen");
+	sheet->frozen->add (sheet->frozen, 4, 1, 4, 1);
+	sheet->dirty->clear (sheet->dirty);
+
+	sheet->apply_block (sheet, 3, 3, 6, offsets, bytes);
+
+	EXPECT_STREQ ("a", gtksheet->data[3][0]->text);
+	EXPECT_STREQ ("b", gtksheet->data[3][1]->text);
+	EXPECT_STREQ ("c", gtksheet->data[4][0]->text);
+	EXPECT_STREQ ("frozen", gtksheet->data[4][1]->text);
+	EXPECT_EQ (10u, sheet->dirty->count);
+}
+
 // This test checks to make sure that the Sheet object's "apply_cell" method will take
 //	the parameters from a Cell object pointer and apply it to the GtkSheet widget.
 TEST_F (SheetTest, MethodApplyCellWorks) {
@@ -139,7 +215,7 @@ TEST_F (SheetTest, MethodApplyCellWorks) {
 
 	EXPECT_STREQ ("Zero", gtksheet->data[0][0]->text);
 
-	g_string_assign (cell->value, "One");
+	cell->methods->set_value (cell, "One");
 
 	sheet->apply_cell (sheet, cell);
 
@@ -152,7 +228,7 @@ TEST_F (SheetTest, MethodApplyCellWorks) {
 	EXPECT_STREQ ("One", gtksheet->data[0][0]->text);
 	EXPECT_STREQ ("One", gtksheet->data[1][1]->text);
 	
-	cell->destroy (cell);
+	cell->methods->destroy (cell);
 }
 
 TEST_F (SheetTest, MethodGetRowWorks) {
@@ -169,8 +245,8 @@ TEST_F (SheetTest, MethodGetRowWorks) {
 	
 	// Tear everything down and make sure we don't leak any memory.
 	for (int ii = 0; ii < gtksheet->maxcol; ii++) {
-		EXPECT_STREQ ("asdfkasdgjkasdf", row[ii]->value->str) << "Assertion failure in column "<<ii;
-		row[ii]->destroy (row[ii]);
+		EXPECT_STREQ ("asdfkasdgjkasdf", row[ii]->methods->get_value (row[ii])) << "Assertion failure in column "<<ii;
+		row[ii]->methods->destroy (row[ii]);
 	}
 	free (row);
 }
@@ -182,7 +258,7 @@ TEST_F (SheetTest, MethodApplyArrayWorks) {
 	Cell ** row = (Cell **)malloc (sizeof (Cell *) * gtksheet->maxcol);
 	for (int ii = 0; ii < gtksheet->maxcol; ii++) {
 		row[ii] = cell_new();
-		row[ii]->set (row[ii], 0, ii, "asdfkasdgjkasdf");
+		row[ii]->methods->set (row[ii], 0, ii, "asdfkasdgjkasdf");
 		sheet->set_cell (sheet, 0, ii, ""); /* Columns need to be allocated inside of the widget. */
 		EXPECT_STREQ ("", gtksheet->data[0][ii]->text) << "Assertion failure in column "<<ii;
 	}
@@ -191,7 +267,7 @@ TEST_F (SheetTest, MethodApplyArrayWorks) {
 
 	for (int ii = 0; ii < gtksheet->maxcol; ii++) {
 		EXPECT_STREQ ("asdfkasdgjkasdf", gtksheet->data[0][ii]->text) << "Assertion failure in column "<<ii;
-		row[ii]->destroy (row[ii]);
+		row[ii]->methods->destroy (row[ii]);
 	}
 	free (row);
 }
@@ -202,7 +278,7 @@ TEST_F (SheetTest, MethodApplyRowWorks) {
 	for (int ii = 0; ii < gtksheet->maxcol; ii++) {
 		sheet->set_cell (sheet, 0, ii, "");
 		EXPECT_STREQ ("", gtksheet->data[0][ii]->text) << "Assertion failure in column "<<ii;
-		g_string_assign (sheet->cells[0][ii]->value, "asdfkjglasdf");
+		sheet->set_cell_value_length (sheet, 0, ii, (void *)"asdfkjglasdf", 12);
 	}
 
 	sheet->apply_row (sheet, 0);
@@ -211,3 +287,329 @@ TEST_F (SheetTest, MethodApplyRowWorks) {
 		EXPECT_STREQ ("asdfkjglasdf", gtksheet->data[0][ii]->text) << "Assertion failure in column "<<ii;
 	}
 }
+
+// The cell buffer is sparse; a cell should only exist once something has been written
+//	into it, or an attribute has been applied to it.
+TEST_F (SheetTest, CellsAreAllocatedOnWrite) {
+	EXPECT_TRUE (sheet->get_cell (sheet, 0, 0) == NULL);
+	EXPECT_TRUE (sheet->get_cell (sheet, 4, 4) == NULL);
+
+	sheet->set_cell_value_length (sheet, 4, 4, (void *)"Foo", 3);
+
+	Cell * cell = sheet->get_cell (sheet, 4, 4);
+	ASSERT_TRUE (cell != NULL);
+	EXPECT_EQ (4, cell->row);
+	EXPECT_EQ (4, cell->column);
+	EXPECT_STREQ ("Foo", cell->methods->get_value (cell));
+	EXPECT_TRUE (sheet->get_cell (sheet, 4, 3) == NULL);
+	EXPECT_TRUE (sheet->get_cell (sheet, 0, 0) == NULL);
+
+	// Anything outside of the sheet's dimensions is never allocated.
+	sheet->set_cell_value_length (sheet, 5, 5, (void *)"Bar", 3);
+	EXPECT_TRUE (sheet->get_cell (sheet, 5, 5) == NULL);
+}
+
+// Row and column titles are allocated lazily as well.
+TEST_F (SheetTest, TitlesAreAllocatedOnWrite) {
+	EXPECT_STREQ ("", sheet->get_column_title (sheet, 1));
+	EXPECT_STREQ ("", sheet->get_row_title (sheet, 1));
+
+	sheet->set_column_title (sheet, 1, "Column");
+	sheet->set_row_title (sheet, 1, "Row");
+
+	EXPECT_STREQ ("Column", sheet->get_column_title (sheet, 1));
+	EXPECT_STREQ ("Row", sheet->get_row_title (sheet, 1));
+	EXPECT_STREQ ("", sheet->get_column_title (sheet, 2));
+	EXPECT_TRUE (sheet->column_titles->find_cell (sheet->column_titles, 2) == NULL);
+}
+
+// Long values live in the sheet's arena and are all released by reset_values.
+TEST_F (SheetTest, MethodResetValuesWorks) {
+	const gchar * value = "a value that is much too long to be stored inline";
+
+	sheet->set_cell_value_length (sheet, 0, 0, (void *)value, strlen (value));
+	sheet->set_cell_value_length (sheet, 0, 1, (void *)"Foo", 3);
+
+	Cell * cell = sheet->get_cell (sheet, 0, 0);
+	Cell * other = sheet->get_cell (sheet, 0, 1);
+	ASSERT_TRUE (cell != NULL && other != NULL);
+	EXPECT_EQ ((guint)CELL_VALUE_ARENA, (guint)cell->storage);
+	EXPECT_STREQ (value, cell->methods->get_value (cell));
+
+	sheet->reset_values (sheet);
+
+	EXPECT_STREQ ("", cell->methods->get_value (cell));
+	EXPECT_STREQ ("Foo", other->methods->get_value (other));
+
+	sheet->set_cell_value_length (sheet, 0, 0, (void *)value, strlen (value));
+	EXPECT_STREQ (value, cell->methods->get_value (cell));
+}
+
+// The shadow store infers a type for each column from what is written to it.
+TEST_F (SheetTest, MethodSetShadowWorks) {
+	EXPECT_TRUE (sheet->shadow == NULL);
+	sheet->set_shadow (sheet, TRUE);
+	ASSERT_TRUE (sheet->shadow != NULL);
+
+	ColumnStore * shadow = sheet->shadow;
+	gint64 i = 0;
+	gdouble d = 0.0;
+
+	sheet->set_cell_value_length (sheet, 0, 0, (void *)"42", 2);
+	sheet->set_cell_value_length (sheet, 0, 1, (void *)"Foo", 3);
+	sheet->set_cell_value_length (sheet, 0, 2, (void *)"2009-03-01", 10);
+
+	EXPECT_EQ (COLUMN_TYPE_INT64, shadow->get_type (shadow, 0));
+	EXPECT_EQ (COLUMN_TYPE_STRING, shadow->get_type (shadow, 1));
+	EXPECT_EQ (COLUMN_TYPE_TIMESTAMP, shadow->get_type (shadow, 2));
+	EXPECT_EQ (COLUMN_TYPE_NULL, shadow->get_type (shadow, 3));
+	EXPECT_TRUE (shadow->get_int64 (shadow, 0, 0, &i));
+	EXPECT_EQ (42, i);
+	EXPECT_STREQ ("Foo", shadow->get_string (shadow, 0, 1));
+	EXPECT_FALSE (shadow->is_valid (shadow, 1, 0));
+
+	// An int64 column widens to double, and then to string.
+	sheet->set_cell_value_length (sheet, 1, 0, (void *)"1.5", 3);
+	EXPECT_EQ (COLUMN_TYPE_DOUBLE, shadow->get_type (shadow, 0));
+	EXPECT_TRUE (shadow->get_double (shadow, 0, 0, &d));
+	EXPECT_EQ (42.0, d);
+
+	sheet->set_cell_value_length (sheet, 2, 0, (void *)"Bar", 3);
+	EXPECT_EQ (COLUMN_TYPE_STRING, shadow->get_type (shadow, 0));
+	EXPECT_STREQ ("42", shadow->get_string (shadow, 0, 0));
+
+	// A timestamp column keeps its milliseconds when it widens to string.
+	sheet->set_cell_value_length (sheet, 1, 2, (void *)"2009-03-01 12:30:05.250", 23);
+	sheet->set_cell_value_length (sheet, 2, 2, (void *)"Baz", 3);
+	EXPECT_EQ (COLUMN_TYPE_STRING, shadow->get_type (shadow, 2));
+	EXPECT_STREQ ("2009-03-01 00:00:00", shadow->get_string (shadow, 0, 2));
+	EXPECT_STREQ ("2009-03-01 12:30:05.250", shadow->get_string (shadow, 1, 2));
+
+	sheet->reset_values (sheet);
+	EXPECT_FALSE (shadow->is_valid (shadow, 0, 0));
+	EXPECT_EQ (COLUMN_TYPE_STRING, shadow->get_type (shadow, 0));
+
+	sheet->set_shadow (sheet, FALSE);
+	EXPECT_TRUE (sheet->shadow == NULL);
+}
+
+// A saved sheet loads back into another sheet with the same text, and a
+// truncated file is rejected rather than read past its end.
+TEST_F (SheetTest, MethodSaveAndLoadWorks) {
+	const gchar * filepath = "libgtkworkbook_sheet.geometry";
+	Sheet * other = workbook->add_new_sheet (workbook, "two", 5, 5);
+
+	sheet->set_cell (sheet, 0, 0, "0,0");
+	sheet->set_cell (sheet, 3, 0, "same");
+	sheet->set_cell (sheet, 2, 4, "same");
+
+	ASSERT_TRUE (sheet->save (sheet, filepath));
+	ASSERT_TRUE (other->load (other, filepath));
+
+	GtkSheet * gtksheet = GTK_SHEET (other->gtk_sheet);
+
+	EXPECT_STREQ ("0,0", gtksheet->data[0][0]->text);
+	EXPECT_STREQ ("same", gtksheet->data[3][0]->text);
+	EXPECT_STREQ ("same", gtksheet->data[2][4]->text);
+
+	FILE * fp = fopen (filepath, "rb");
+	ASSERT_TRUE (fp != NULL);
+	fseek (fp, 0, SEEK_END);
+	long size = ftell (fp);
+	fclose (fp);
+	ASSERT_EQ (0, truncate (filepath, size - 8));
+
+	EXPECT_FALSE (other->load (other, filepath));
+
+	unlink (filepath);
+	other->destroy (other);
+}
+
+// A checkpoint after a save only appends the changed cells to the journal,
+// and loading replays the journal on top of the file.
+TEST_F (SheetTest, MethodCheckpointWorks) {
+	const gchar * filepath = "libgtkworkbook_checkpoint.geometry";
+	Sheet * other = workbook->add_new_sheet (workbook, "two", 5, 5);
+
+	sheet->set_cell (sheet, 0, 0, "0,0");
+	sheet->set_cell (sheet, 1, 1, "1,1");
+	EXPECT_EQ (2u, sheet->dirty->count);
+
+	// The first checkpoint to a file saves all of it.
+	ASSERT_TRUE (sheet->checkpoint (sheet, filepath));
+	EXPECT_EQ (0u, sheet->dirty->count);
+	EXPECT_EQ (0u, sheet->journal_size);
+
+	sheet->set_cell (sheet, 1, 1, "changed");
+	sheet->set_cell (sheet, 4, 4, "4,4");
+	EXPECT_EQ (2u, sheet->dirty->count);
+
+	ASSERT_TRUE (sheet->checkpoint (sheet, filepath));
+	EXPECT_EQ (0u, sheet->dirty->count);
+	EXPECT_LT (0u, sheet->journal_size);
+
+	ASSERT_TRUE (other->load (other, filepath));
+	GtkSheet * gtksheet = GTK_SHEET (other->gtk_sheet);
+
+	EXPECT_STREQ ("0,0", gtksheet->data[0][0]->text);
+	EXPECT_STREQ ("changed", gtksheet->data[1][1]->text);
+	EXPECT_STREQ ("4,4", gtksheet->data[4][4]->text);
+
+	// A full save folds the journal back into the file.
+	ASSERT_TRUE (sheet->save (sheet, filepath));
+	EXPECT_EQ (0u, sheet->journal_size);
+
+	unlink (filepath);
+	other->destroy (other);
+}
+
+// Recoloring a range only marks the cells in it that are saved, which are
+// the ones with text.
+TEST_F (SheetTest, MethodRangesSetBackgroundMarksTextOnly) {
+	GtkSheetRange range = { 0, 0, 9, 9 };
+
+	sheet->set_cell (sheet, 1, 1, "1,1");
+	sheet->set_cell (sheet, 2, 3, "2,3");
+	sheet->dirty->clear (sheet->dirty);
+
+	sheet->ranges_set_background (sheet, &range, 1, "red");
+	EXPECT_EQ (2u, sheet->dirty->count);
+
+	sheet->dirty->clear (sheet->dirty);
+	sheet->ranges_set_foreground (sheet, &range, 1, "blue");
+	EXPECT_EQ (2u, sheet->dirty->count);
+}
+
+// A snapshot is a point-in-time image: changes made after it was taken
+// are not written when it is committed.
+TEST_F (SheetTest, MethodSnapshotIsPointInTime) {
+	const gchar * filepath = "libgtkworkbook_snapshot.geometry";
+	Sheet * other = workbook->add_new_sheet (workbook, "two", 5, 5);
+
+	sheet->set_cell (sheet, 0, 0, "before");
+
+	Snapshot * snapshot = sheet->snapshot (sheet, filepath, FALSE);
+	ASSERT_TRUE (snapshot != NULL);
+	EXPECT_FALSE (snapshot->delta);
+	EXPECT_EQ (1u, snapshot->cells->len);
+
+	sheet->set_cell (sheet, 0, 0, "after");
+	sheet->set_cell (sheet, 1, 1, "after");
+
+	ASSERT_TRUE (sheet->commit (sheet, snapshot, filepath));
+	snapshot->destroy (snapshot);
+
+	ASSERT_TRUE (other->load (other, filepath));
+	GtkSheet * gtksheet = GTK_SHEET (other->gtk_sheet);
+
+	EXPECT_STREQ ("before", gtksheet->data[0][0]->text);
+	EXPECT_TRUE (gtk_sheet_cell_get_text (gtksheet, 1, 1) == NULL);
+
+	// The next checkpoint only needs the two cells changed since.
+	snapshot = sheet->snapshot (sheet, filepath, TRUE);
+	EXPECT_TRUE (snapshot->delta);
+	EXPECT_EQ (2u, snapshot->cells->len);
+	snapshot->destroy (snapshot);
+
+	unlink (filepath);
+	other->destroy (other);
+}
+
+// A tail sheet writes the newest row over the oldest one in place, and
+// titles its rows with their absolute sequence numbers.
+TEST_F (SheetTest, MethodSetTailWorks) {
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	gchar value[8];
+
+	sheet->set_tail (sheet, TRUE);
+
+	for (gint ii = 0; ii < 7; ii++) {
+		gint slot = ii % sheet->max_rows;
+
+		g_snprintf (value, sizeof (value), "%d", ii);
+		sheet->set_cell_value_length (sheet, slot, 0, (void *)value, strlen (value));
+		sheet->apply_row (sheet, slot);
+	}
+
+	EXPECT_EQ (5, sheet->tail_count);
+	EXPECT_EQ (7u, sheet->tail_sequence);
+	EXPECT_EQ (2, sheet->tail_head);
+	EXPECT_STREQ ("5", gtksheet->data[0][0]->text);
+	EXPECT_STREQ ("6", gtksheet->data[1][0]->text);
+	EXPECT_STREQ ("2", gtksheet->data[2][0]->text);
+	EXPECT_STREQ ("2", sheet->get_row_title (sheet, 0));
+	EXPECT_STREQ ("6", sheet->get_row_title (sheet, 4));
+}
+
+// Wrapping around keeps frozen cells in place and only marks the row that
+// was written, so a checkpoint can still be a delta.
+TEST_F (SheetTest, MethodSetTailKeepsRows) {
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+
+	sheet->set_tail (sheet, TRUE);
+
+	for (gint ii = 0; ii < sheet->max_rows; ii++) {
+		sheet->set_cell_value_length (sheet, ii, 0, (void *)"a", 1);
+		sheet->set_cell_value_length (sheet, ii, 1, (void *)"b", 1);
+		sheet->apply_row (sheet, ii);
+	}
+	sheet->frozen->add (sheet->frozen, 1, 0, 1, 0);
+	sheet->dirty->clear (sheet->dirty);
+
+	// The two oldest rows are replaced; the frozen cell keeps its value.
+	sheet->set_cell_value_length (sheet, 0, 0, (void *)"c", 1);
+	sheet->set_cell_value_length (sheet, 1, 0, (void *)"d", 1);
+	sheet->apply_row (sheet, 0);
+	sheet->apply_row (sheet, 1);
+
+	EXPECT_STREQ ("c", gtksheet->data[0][0]->text);
+	EXPECT_STREQ ("a", gtksheet->data[1][0]->text);
+	EXPECT_TRUE (sheet->frozen->contains (sheet->frozen, 1, 0));
+	EXPECT_EQ (3u, sheet->dirty->count);
+}
+
+// Staged rows of a tail sheet are applied as one block, wrapping around the slots.
+TEST_F (SheetTest, MethodApplyRowsWorks) {
+	GtkSheet * gtksheet = GTK_SHEET (sheet->gtk_sheet);
+	gchar value[8];
+
+	sheet->set_tail (sheet, TRUE);
+
+	for (gint ii = 0; ii < 3; ii++) {
+		g_snprintf (value, sizeof (value), "%d", ii);
+		sheet->set_cell_value_length (sheet, (3 + ii) % sheet->max_rows, 0,
+												(void *)value, strlen (value));
+	}
+	sheet->apply_rows (sheet, 3, 3);
+
+	EXPECT_EQ (3, sheet->tail_count);
+	EXPECT_STREQ ("0", gtksheet->data[0][0]->text);
+	EXPECT_STREQ ("2", gtksheet->data[2][0]->text);
+	EXPECT_EQ (3u, sheet->dirty->count);
+}
+
+static void
+window_request (Sheet * sheet, guint64 line, gint rows, gpointer data) {
+	*(guint64 *)data = line + rows;
+}
+
+// A windowed sheet's scrollbar spans every line of its source, and moving it asks for
+//	the max_rows lines at its position; the window never runs past the last line.
+TEST_F (SheetTest, MethodSetWindowWorks) {
+	guint64 requested = 0;
+
+	sheet->set_window (sheet, window_request, &requested);
+	ASSERT_TRUE (sheet->gtk_vscrollbar != NULL);
+	EXPECT_EQ (5u, sheet->window_lines);
+
+	sheet->set_window_lines (sheet, 1000000);
+	EXPECT_EQ (1000000u, sheet->window_lines);
+
+	gtk_range_set_value (GTK_RANGE (sheet->gtk_vscrollbar), 999999);
+	EXPECT_EQ (999995u, sheet->window_first);
+	EXPECT_EQ (1000000u, requested);
+	EXPECT_STREQ ("999999", sheet->get_row_title (sheet, 4));
+
+	sheet->set_window (sheet, NULL, NULL);
+	EXPECT_TRUE (sheet->gtk_vscrollbar == NULL);
+}
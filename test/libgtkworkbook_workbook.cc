@@ -90,6 +90,93 @@ TEST_F (WorkbookTest, MethodRemoveSheetWorks) {
 	EXPECT_EQ (NULL, workbook->sheet_last);
 }
 
+// The name and widget indexes must follow sheets being added and removed.
+TEST_F (WorkbookTest, MethodGetSheetByWidgetWorks) {
+	Sheet * a = workbook->add_new_sheet (workbook, "one", 1, 1);
+	Sheet * b = workbook->add_new_sheet (workbook, "two", 1, 1);
+	guint generation = workbook->generation;
+
+	EXPECT_EQ (a, workbook->get_sheet_by_widget (workbook, a->gtk_box));
+	EXPECT_EQ (b, workbook->get_sheet_by_widget (workbook, b->gtk_box));
+	EXPECT_TRUE (workbook->get_sheet_by_widget (workbook, NULL) == NULL);
+
+	workbook->remove_sheet (workbook, a);
+
+	EXPECT_NE (generation, workbook->generation);
+	EXPECT_TRUE (workbook->get_sheet (workbook, "one") == NULL);
+	EXPECT_TRUE (workbook->get_sheet_by_widget (workbook, a->gtk_box) == NULL);
+	EXPECT_EQ (b, workbook->get_sheet (workbook, "two"));
+
+	a->destroy (a);
+
+	// Destroying a Sheet without removing it first has to take it out as well.
+	GtkWidget * widget = b->gtk_box;
+	guint serial = b->serial;
+	generation = workbook->generation;
+	b->destroy (b);
+
+	EXPECT_NE (generation, workbook->generation);
+	EXPECT_TRUE (workbook->get_sheet (workbook, "two") == NULL);
+	EXPECT_TRUE (workbook->get_sheet_by_widget (workbook, widget) == NULL);
+
+	// A Sheet that takes over the name of a removed one is told apart by its serial.
+	Sheet * c = workbook->add_new_sheet (workbook, "two", 1, 1);
+	EXPECT_NE (serial, c->serial);
+}
+
+static GString * scheduled = NULL;
+
+static void
+schedule_append (Scheduler * scheduler, gpointer data) {
+	g_string_append (scheduled, (const gchar *)data);
+}
+
+static void
+schedule_hold (Scheduler * scheduler, gpointer data) {
+	Sheet * sheet = (Sheet *)data;
+
+	scheduler->hold (scheduler, sheet);
+	scheduler->hold (scheduler, sheet);
+	sheet->set_cell (sheet, 0, 0, "held");
+}
+
+// This test verifies that the Scheduler applies updates in the order they were
+//	pushed, and that a frame always gets at least one of them done.
+TEST_F (WorkbookTest, SchedulerRunWorks) {
+	Scheduler * scheduler = workbook->scheduler;
+	ASSERT_TRUE (scheduler != NULL);
+
+	scheduled = g_string_new ("");
+	scheduler->push (scheduler, schedule_append, (gpointer)"a", NULL);
+	scheduler->push (scheduler, schedule_append, (gpointer)"b", NULL);
+	scheduler->push (scheduler, schedule_append, (gpointer)"c", NULL);
+
+	EXPECT_FALSE (scheduler->run (scheduler));
+	EXPECT_STREQ ("abc", scheduled->str);
+
+	// With no budget at all a frame is a single update.
+	scheduler->budget = 0;
+	scheduler->push (scheduler, schedule_append, (gpointer)"d", NULL);
+	scheduler->push (scheduler, schedule_append, (gpointer)"e", NULL);
+	EXPECT_EQ (2, scheduler->pending);
+
+	EXPECT_TRUE (scheduler->run (scheduler));
+	EXPECT_STREQ ("abcd", scheduled->str);
+	EXPECT_EQ (1, scheduler->pending);
+	EXPECT_FALSE (scheduler->run (scheduler));
+	EXPECT_STREQ ("abcde", scheduled->str);
+	EXPECT_EQ (0, scheduler->pending);
+
+	// A Sheet held more than once in a frame is let go of at the end of it.
+	Sheet * sheet = workbook->add_new_sheet (workbook, "one", 1, 1);
+	scheduler->push (scheduler, schedule_hold, sheet, NULL);
+
+	EXPECT_FALSE (scheduler->run (scheduler));
+	EXPECT_TRUE (scheduler->held == NULL);
+
+	g_string_free (scheduled, TRUE);
+}
+
 TEST_F (WorkbookTest, MethodMoveSheetWorks) {
 	// TODO(jb): Need to check the order inside of the GtkNotebook widget to test that
 	//	the method actually works. This does not change the order of the linkages inside